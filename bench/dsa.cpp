@@ -0,0 +1,96 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+// Compares the bind-to-edit and the direct state access code paths of the
+// buffer, texture and framebuffer wrappers. Every operation alternates between
+// two objects, such that the binding cache cannot elide the binds of the
+// bind-to-edit path. Reports the CPU time and the number of OpenGL calls per
+// operation for either path.
+#define GLADUS_COUNT_GL_CALLS
+#include <gladus/opengl.hpp>
+#include <gladus/context.hpp>
+#include <gladus/buffer.hpp>
+#include <gladus/texture.hpp>
+#include <gladus/framebuffer.hpp>
+#include "headless.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+struct vec2 { GLint x, y; vec2(): x(0), y(0) {} vec2(GLint x, GLint y): x(x), y(y) {} };
+
+struct result
+{
+	double ns_per_op;
+	double calls_per_op;
+};
+
+template <typename F> result measure(unsigned long ops, F op)
+{
+	glFinish();
+	unsigned long long calls = gladus::gl_call_statistics::current().calls;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < ops; i++)
+		op(i);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	result r;
+	r.ns_per_op = std::chrono::duration<double, std::nano>(end - start).count() / ops;
+	r.calls_per_op = double(gladus::gl_call_statistics::current().calls - calls) / ops;
+	glFinish();
+	return r;
+}
+
+template <typename F> void compare(const char* name, unsigned long ops, F op)
+{
+	gladus::context& ctx = gladus::context::current();
+	ctx.set_direct_state_access(false);
+	result bind = measure(ops, op);
+	ctx.set_direct_state_access(true);
+	result dsa = measure(ops, op);
+	std::printf("%-24s %12.1f %10.2f %12.1f %10.2f\n", name, bind.ns_per_op, bind.calls_per_op, dsa.ns_per_op, dsa.calls_per_op);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long ops = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 20000;
+	headless_context headless(4, 5);
+	if (!gladus::context::current().supports_direct_state_access()) {
+		std::fprintf(stderr, "dsa: context supports neither OpenGL 4.5 nor ARB_direct_state_access\n");
+		return 1;
+	}
+
+	// Objects have to be created by glCreate* for the DSA path to accept
+	// them, which happens whenever DSA is supported.
+	static const GLubyte pixels[16*16*4] = {0};
+	gladus::buffer buffer0(GL_ARRAY_BUFFER), buffer1(GL_ARRAY_BUFFER);
+	gladus::texture texture0(GL_TEXTURE_2D), texture1(GL_TEXTURE_2D);
+	gladus::framebuffer framebuffer0(GL_FRAMEBUFFER), framebuffer1(GL_FRAMEBUFFER);
+	gladus::buffer* buffers[2] = { &buffer0, &buffer1 };
+	gladus::texture* textures[2] = { &texture0, &texture1 };
+	gladus::framebuffer* framebuffers[2] = { &framebuffer0, &framebuffer1 };
+	for (int i = 0; i < 2; i++) {
+		buffers[i]->data(sizeof(pixels), NULL, GL_DYNAMIC_DRAW);
+		textures[i]->image2d(gladus::texture_image<vec2>(0, GL_RGBA8, vec2(16,16)), gladus::texture_data(GL_RGBA, GL_UNSIGNED_BYTE, 4, pixels));
+		framebuffers[i]->attach(GL_COLOR_ATTACHMENT0, *textures[i], 0);
+	}
+
+	std::printf("%-24s %12s %10s %12s %10s\n", "operation", "bind ns/op", "calls/op", "dsa ns/op", "calls/op");
+	compare("buffer::subdata", ops, [&](unsigned long i) {
+		buffers[i%2]->subdata(0, 64, pixels);
+	});
+	compare("buffer::map_range", ops, [&](unsigned long i) {
+		buffers[i%2]->map_range(0, 64, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		buffers[i%2]->unmap();
+	});
+	compare("texture::set_filter", ops, [&](unsigned long i) {
+		textures[i%2]->set_filter_params(GL_LINEAR, GL_NEAREST);
+	});
+	compare("texture::image2d (sub)", ops, [&](unsigned long i) {
+		textures[i%2]->image2d(gladus::texture_subimage<vec2>(0, vec2(0,0), vec2(4,4)), gladus::texture_data(GL_RGBA, GL_UNSIGNED_BYTE, 4, pixels));
+	});
+	compare("framebuffer::attach", ops, [&](unsigned long i) {
+		framebuffers[i%2]->attach(GL_COLOR_ATTACHMENT0, *textures[i%2], 0);
+	});
+	compare("framebuffer::validate", ops, [&](unsigned long i) {
+		framebuffers[i%2]->validate();
+	});
+	return 0;
+}
@@ -0,0 +1,45 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdexcept>
+
+/// An OpenGL context without any window or surface, created through EGL on
+/// Mesa's surfaceless platform. Allows the benchmarks to run on machines
+/// without a GPU or display, e.g. with the llvmpipe software renderer.
+struct headless_context
+{
+	EGLDisplay display;
+	EGLContext context;
+
+	headless_context(EGLint major, EGLint minor)
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (!get_platform_display)
+			throw std::runtime_error("headless: failed to create context: EGL_EXT_platform_base is not supported");
+		display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+			throw std::runtime_error("headless: failed to create context: surfaceless display is not available");
+		eglBindAPI(EGL_OPENGL_API);
+		const EGLint attribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, major,
+			EGL_CONTEXT_MINOR_VERSION, minor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+		if (context == EGL_NO_CONTEXT)
+			throw std::runtime_error("headless: failed to create context: requested OpenGL version is not supported");
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+	}
+
+	~headless_context()
+	{
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+	}
+
+	headless_context(const headless_context&) = delete;
+	headless_context& operator=(const headless_context&) = delete;
+};
@@ -0,0 +1,19 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include <cstdio>
+#include <string>
+
+/// Quotes a string for a JSON document, escaping quotes, backslashes and
+/// control characters the same way gpu_profiler does. A null string, e.g.
+/// one glGetString failed to return, becomes an empty one.
+inline std::string json_string(const char* s)
+{
+	std::string out(1, '"');
+	for (const char* c = s ? s : ""; *c; c++) {
+		if (*c == '"' || *c == '\\') { out += '\\'; out += *c; }
+		else if ((unsigned char)*c < 0x20) { char esc[8]; std::snprintf(esc, sizeof(esc), "\\u%04x", *c); out += esc; }
+		else out += *c;
+	}
+	out += '"';
+	return out;
+}
@@ -0,0 +1,379 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+// Replays a trace recorded by gladus::gl_trace on a headless context and
+// reports, for every OpenGL function, the number of calls, the time spent in
+// them and how many of them were redundant, i.e. set state to the value it
+// already had. Prints a table or, with --json, a JSON document.
+//
+//     gladus_replay [--json] frame.trace
+//
+// Arguments are passed as recorded, except that pointers to data the trace
+// holds point to the recorded copy, pointers the call writes to point to a
+// scratch area, and sync objects are those created by the replay. Replaying
+// on a fresh context recreates the objects of the trace under the same names
+// if the driver hands out names deterministically, as Mesa does; names that
+// differ from the recorded ones are reported, since later calls referring to
+// them would then affect other objects.
+#include <gladus/opengl.hpp>
+#include <gladus/trace.hpp>
+#include "headless.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using gladus::gl_trace_header;
+using gladus::gl_trace_record;
+using gladus::gl_trace_payload;
+using gladus::gl_trace_slot;
+
+/// The arguments of the call being replayed.
+struct replay_context
+{
+	const uint64_t* slots;
+	/// Input payload of each argument, if any.
+	const gl_trace_payload* inputs[gl_trace_payload::no_argument];
+	std::vector<char> scratch;
+	std::vector<const GLchar*> strings;
+	std::map<uint64_t, GLsync> syncs;
+
+	const char* input_data(int i) const { return inputs[i] ? (const char*)(inputs[i] + 1) : NULL; }
+};
+
+template <typename T> struct replay_argument
+{
+	static T decode(replay_context& c, int i) { return gl_trace_slot<T>::decode(c.slots[i]); }
+};
+/// Data the call reads is the recorded copy, if there is one, or else the
+/// recorded value, e.g. an offset into a bound buffer.
+template <typename T> struct replay_argument<const T*>
+{
+	static const T* decode(replay_context& c, int i) { return c.inputs[i] ? (const T*)c.input_data(i) : gl_trace_slot<const T*>::decode(c.slots[i]); }
+};
+/// Memory the call writes to is the scratch area.
+template <typename T> struct replay_argument<T*>
+{
+	static T* decode(replay_context& c, int i) { return c.slots[i] ? (T*)&c.scratch[0] : NULL; }
+};
+template <> struct replay_argument<GLsync>
+{
+	static GLsync decode(replay_context& c, int i)
+	{
+		std::map<uint64_t, GLsync>::iterator it = c.syncs.find(c.slots[i]);
+		return it != c.syncs.end() ? it->second : NULL;
+	}
+};
+/// The strings of glShaderSource, stored one after another.
+template <> struct replay_argument<const GLchar* const*>
+{
+	static const GLchar* const* decode(replay_context& c, int i)
+	{
+		c.strings.clear();
+		if (!c.inputs[i]) return NULL;
+		const char* s = c.input_data(i);
+		const char* end = s + c.inputs[i]->size;
+		for (; s < end; s += std::strlen(s) + 1) c.strings.push_back(s);
+		return c.strings.empty() ? NULL : &c.strings[0];
+	}
+};
+/// Callbacks are not replayed.
+template <typename R, typename... A> struct replay_argument<R (*)(A...)>
+{
+	static R (*decode(replay_context&, int))(A...) { return NULL; }
+};
+
+/// Calls a function with the decoded arguments, one argument at a time.
+template <typename R, typename... A> struct replay_invoke
+{
+	typedef R (*function)(A...);
+
+	static uint64_t invoke(void (*f)(), replay_context& c) { return invoke((function)f, c, std::is_void<R>()); }
+	static uint64_t invoke(function f, replay_context& c, std::true_type) { call(f, c, std::integral_constant<bool, sizeof...(A) == 0>()); return 0; }
+	static uint64_t invoke(function f, replay_context& c, std::false_type) { return gl_trace_slot<R>::encode(call(f, c, std::integral_constant<bool, sizeof...(A) == 0>())); }
+
+	template <typename... D> static R call(function f, replay_context&, std::true_type, D... d) { return f(d...); }
+	template <typename... D> static R call(function f, replay_context& c, std::false_type, D... d)
+	{
+		typedef typename std::tuple_element<sizeof...(D), std::tuple<A...> >::type next;
+		return call(f, c, std::integral_constant<bool, sizeof...(D) + 1 == sizeof...(A)>(), d..., replay_argument<next>::decode(c, sizeof...(D)));
+	}
+};
+
+/// What the replay has to do besides calling a function.
+enum replay_role
+{
+	role_none,
+	/// Creates a sync object, which later calls refer to.
+	role_fence,
+	role_delete_sync,
+	/// Maps, flushes or unmaps a buffer range, whose recorded contents are
+	/// copied into the replay's mapping.
+	role_map,
+	role_flush,
+	role_unmap,
+	/// Returns the name of a new object, which should match the recorded one.
+	role_create,
+	/// Returns the errors of the calls replayed before, which the replay
+	/// must not clear itself.
+	role_get_error
+};
+
+struct replayer
+{
+	const char* name;
+	void (*function)();
+	uint64_t (*invoke)(void (*)(), replay_context&);
+	replay_role role;
+	/// Whether mappings are keyed by buffer name rather than target.
+	bool named;
+	/// Number of leading arguments identifying the state a call sets, e.g.
+	/// the target of glBindBuffer, or -1 if the function does not set state.
+	int state_key;
+};
+
+template <typename R, typename... A> replayer make_replayer(const char* name, R (*f)(A...))
+{
+	replayer r = { name, (void (*)())f, &replay_invoke<R, A...>::invoke, role_none, std::strstr(name, "Named") != NULL, -1 };
+	std::string n(name);
+	if (n == "glFenceSync") r.role = role_fence;
+	else if (n == "glDeleteSync") r.role = role_delete_sync;
+	else if (n.compare(0, 5, "glMap") == 0) r.role = role_map;
+	else if (n.compare(0, 13, "glFlushMapped") == 0) r.role = role_flush;
+	else if (n.compare(0, 7, "glUnmap") == 0) r.role = role_unmap;
+	else if (n == "glCreateShader" || n == "glCreateProgram") r.role = role_create;
+	else if (n == "glGetError") r.role = role_get_error;
+
+	static const struct { const char* name; int key; } setters[] = {
+		{ "glActiveTexture", 0 }, { "glBindBuffer", 1 }, { "glBindBufferBase", 2 }, { "glBindBufferRange", 2 },
+		{ "glBindFramebuffer", 1 }, { "glBindTexture", 1 }, { "glBindVertexArray", 0 }, { "glBindVertexBuffer", 1 },
+		{ "glBlendColor", 0 }, { "glBlendEquationSeparate", 0 }, { "glBlendFuncSeparate", 0 }, { "glColorMask", 0 },
+		{ "glCullFace", 0 }, { "glDepthFunc", 0 }, { "glDepthMask", 0 }, { "glDisable", 1 }, { "glEnable", 1 },
+		{ "glFrontFace", 0 }, { "glPixelStorei", 1 }, { "glPolygonOffset", 0 }, { "glScissor", 0 },
+		{ "glTextureParameteri", 2 }, { "glUniformBlockBinding", 2 }, { "glUseProgram", 0 },
+		{ "glVertexAttribDivisor", 1 }, { "glVertexBindingDivisor", 1 }, { "glViewport", 0 }
+	};
+	for (size_t i = 0; i < sizeof(setters) / sizeof(setters[0]); i++)
+		if (n == setters[i].name) r.state_key = setters[i].key;
+	return r;
+}
+
+struct function_statistics
+{
+	std::string name;
+	unsigned long calls;
+	unsigned long redundant;
+	unsigned long errors;
+	double seconds;
+	double max_seconds;
+
+	function_statistics(): calls(0), redundant(0), errors(0), seconds(0), max_seconds(0) {}
+};
+
+/// The state set by the calls replayed so far, as far as the trace tells.
+/// Bindings that belong to the bound vertex array or texture unit are keyed
+/// by it as well.
+struct state_tracker
+{
+	std::map<std::vector<uint64_t>, std::vector<uint64_t> > values;
+	uint64_t vertex_array, texture_unit;
+
+	state_tracker(): vertex_array(0), texture_unit(GL_TEXTURE0) {}
+
+	/// Notes the state the call sets and returns whether it was set to that
+	/// value already.
+	bool set(const replayer& r, const uint64_t* slots, int arguments)
+	{
+		std::string n(r.name);
+		std::vector<uint64_t> key(1, uint64_t(uintptr_t(r.function)));
+		if (n == "glEnable" || n == "glDisable") key[0] = 0;
+		if (n == "glBindTexture") key.push_back(texture_unit);
+		if (n == "glBindVertexBuffer" || n == "glVertexAttribDivisor" || n == "glVertexBindingDivisor" || (n == "glBindBuffer" && slots[0] == GL_ELEMENT_ARRAY_BUFFER))
+			key.push_back(vertex_array);
+		key.insert(key.end(), slots, slots + r.state_key);
+		std::vector<uint64_t> value(slots + r.state_key, slots + arguments);
+		if (n == "glEnable" || n == "glDisable") value.assign(1, n == "glEnable");
+		if (n == "glBindVertexArray") vertex_array = slots[0];
+		if (n == "glActiveTexture") texture_unit = slots[0];
+		std::pair<std::map<std::vector<uint64_t>, std::vector<uint64_t> >::iterator, bool> it = values.insert(std::make_pair(key, value));
+		if (it.second) return false;
+		bool redundant = it.first->second == value;
+		it.first->second = value;
+		return redundant;
+	}
+
+	/// Forgets everything, e.g. after objects were deleted, which may
+	/// change bindings.
+	void clear() { values.clear(); }
+};
+
+static void fail(const char* message)
+{
+	std::fprintf(stderr, "replay: %s\n", message);
+	std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = NULL;
+	bool json = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--json") == 0) json = true;
+		else path = argv[i];
+	}
+	if (!path) {
+		std::fprintf(stderr, "usage: %s [--json] trace\n", argv[0]);
+		return 1;
+	}
+
+	int fd = ::open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || ::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(gl_trace_header))
+		fail("failed to load trace: file cannot be read");
+	const char* data = (const char*)::mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) fail("failed to load trace: file cannot be mapped");
+	const gl_trace_header& header = *(const gl_trace_header*)data;
+	if (std::memcmp(header.magic, gl_trace_header::expected_magic(), sizeof(header.magic)) != 0 || header.version != gl_trace_header::current_version)
+		fail("failed to load trace: file is not a trace of this version");
+	if (header.size > size_t(st.st_size)) fail("failed to load trace: file is truncated");
+
+	std::map<std::string, replayer> known;
+	#define gladus_gl_call(name) known.insert(std::make_pair(std::string(#name), make_replayer(#name, &::name)));
+	#include <gladus/gl_call_list.hpp>
+	#undef gladus_gl_call
+
+	// The functions of the trace, by their index in the trace.
+	std::vector<replayer> functions;
+	const char* p = data + sizeof(gl_trace_header);
+	for (uint32_t i = 0; i < header.functions; i++) {
+		uint16_t n;
+		std::memcpy(&n, p, sizeof(n));
+		std::string name(p + sizeof(n), n);
+		p += sizeof(n) + n;
+		std::map<std::string, replayer>::iterator it = known.find(name);
+		if (it != known.end()) functions.push_back(it->second);
+		else { replayer r = { NULL, NULL, NULL, role_none, false, -1 }; functions.push_back(r); }
+	}
+	p = data + (p - data + 7) / 8 * 8;
+
+	headless_context headless(4, 5);
+	std::vector<function_statistics> stats(functions.size());
+	for (size_t i = 0; i < functions.size(); i++) stats[i].name = functions[i].name ? functions[i].name : "";
+	replay_context c;
+	c.scratch.resize(1 << 20);
+	state_tracker state;
+	std::map<uint64_t, char*> mappings;
+	unsigned long records = 0, redundant = 0, errors = 0, diverged = 0;
+	double seconds = 0;
+	// The last function replayed other than glGetError, which errors
+	// returned by glGetError are counted for.
+	function_statistics* previous = NULL;
+
+	const char* end = data + header.size;
+	while (p < end) {
+		const gl_trace_record& r = *(const gl_trace_record*)p;
+		if (r.function >= functions.size() || !functions[r.function].invoke)
+			fail("failed to replay trace: trace calls a function unknown to this build");
+		const replayer& f = functions[r.function];
+		c.slots = (const uint64_t*)(p + sizeof(r));
+		std::fill(c.inputs, c.inputs + gl_trace_payload::no_argument, (const gl_trace_payload*)NULL);
+		std::vector<const gl_trace_payload*> outputs, mapped;
+		const char* q = (const char*)(c.slots + r.arguments + 1);
+		for (int i = 0; i < r.payloads; i++) {
+			const gl_trace_payload& pl = *(const gl_trace_payload*)q;
+			if (pl.kind == gladus::payload_input) c.inputs[pl.argument] = &pl;
+			if (pl.kind == gladus::payload_output) outputs.push_back(&pl);
+			if (pl.kind == gladus::payload_mapped) mapped.push_back(&pl);
+			if ((pl.kind == gladus::payload_reserve || pl.kind == gladus::payload_output) && pl.size > c.scratch.size()) c.scratch.resize(pl.size);
+			q += sizeof(pl) + (pl.kind == gladus::payload_reserve ? 0 : (pl.size + 7) / 8 * 8);
+		}
+
+		uint64_t key = gladus::gl_trace::mapping_key(f.named, GLuint(c.slots[0]));
+		if (!mapped.empty()) {
+			std::map<uint64_t, char*>::iterator it = mappings.find(key);
+			for (size_t i = 0; i < mapped.size() && it != mappings.end(); i++)
+				std::memcpy(it->second + mapped[i]->offset, mapped[i] + 1, mapped[i]->size);
+		}
+		function_statistics& s = stats[r.function];
+		if (f.state_key >= 0 && state.set(f, c.slots, r.arguments)) { s.redundant++; redundant++; }
+		if (std::strncmp(f.name, "glDelete", 8) == 0) state.clear();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		uint64_t result = f.invoke(f.function, c);
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		s.calls++;
+		s.seconds += t;
+		s.max_seconds = std::max(s.max_seconds, t);
+		seconds += t;
+		records++;
+		// Errors are checked for after every call, unless the trace itself
+		// checks for them next; the replay must not clear them then.
+		const char* next = p + r.size;
+		uint16_t next_function = next < end ? ((const gl_trace_record*)next)->function : uint16_t(-1);
+		bool checked_next = next_function < functions.size() && functions[next_function].role == role_get_error;
+		if (f.role == role_get_error) {
+			if (result != GL_NO_ERROR) { (previous ? *previous : s).errors++; errors++; }
+		} else {
+			if (!checked_next && ::glGetError() != GL_NO_ERROR) { s.errors++; errors++; }
+			previous = &s;
+		}
+
+		const uint64_t recorded = c.slots[r.arguments];
+		if (f.role == role_fence) c.syncs[recorded] = (GLsync)uintptr_t(result);
+		if (f.role == role_delete_sync) c.syncs.erase(c.slots[0]);
+		if (f.role == role_map && result) mappings[key] = (char*)uintptr_t(result);
+		if (f.role == role_unmap) mappings.erase(key);
+		if (f.role == role_create && result != recorded) diverged++;
+		for (size_t i = 0; i < outputs.size(); i++)
+			if (std::memcmp(&c.scratch[0], outputs[i] + 1, outputs[i]->size) != 0) diverged++;
+		p += r.size;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	::glFinish();
+	double finish = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<function_statistics> called;
+	for (size_t i = 0; i < stats.size(); i++) if (stats[i].calls) called.push_back(stats[i]);
+	std::sort(called.begin(), called.end(), [](const function_statistics& a, const function_statistics& b) { return a.seconds > b.seconds; });
+
+	if (json) {
+		std::printf("{\n");
+		std::printf("  \"trace\": %s,\n", json_string(path).c_str());
+		std::printf("  \"renderer\": %s,\n", json_string((const char*)::glGetString(GL_RENDERER)).c_str());
+		std::printf("  \"calls\": %lu,\n", records);
+		std::printf("  \"dropped\": %llu,\n", (unsigned long long)header.dropped);
+		std::printf("  \"redundant\": %lu,\n", redundant);
+		std::printf("  \"errors\": %lu,\n", errors);
+		std::printf("  \"diverged_names\": %lu,\n", diverged);
+		std::printf("  \"call_seconds\": %.6f,\n", seconds);
+		std::printf("  \"finish_seconds\": %.6f,\n", finish);
+		std::printf("  \"functions\": [\n");
+		for (size_t i = 0; i < called.size(); i++) {
+			const function_statistics& s = called[i];
+			std::printf("    {\"name\": %s, \"calls\": %lu, \"redundant\": %lu, \"errors\": %lu, \"total_us\": %.1f, \"mean_ns\": %.1f, \"max_ns\": %.1f}%s\n",
+				json_string(s.name.c_str()).c_str(), s.calls, s.redundant, s.errors, s.seconds * 1e6, s.seconds * 1e9 / s.calls, s.max_seconds * 1e9, i + 1 < called.size() ? "," : "");
+		}
+		std::printf("  ]\n}\n");
+	} else {
+		std::printf("%s: %lu calls, %lu redundant, %lu errors, %.3f ms in calls, %.3f ms in glFinish\n", path, records, redundant, errors, seconds * 1e3, finish * 1e3);
+		if (header.dropped) std::printf("warning: %llu calls were dropped while recording, the trace is incomplete\n", (unsigned long long)header.dropped);
+		if (diverged) std::printf("warning: %lu calls created objects under names other than the recorded ones\n", diverged);
+		std::printf("%-40s %10s %10s %8s %12s %10s %10s\n", "function", "calls", "redundant", "errors", "total us", "mean ns", "max ns");
+		for (size_t i = 0; i < called.size(); i++) {
+			const function_statistics& s = called[i];
+			std::printf("%-40s %10lu %10lu %8lu %12.1f %10.1f %10.1f\n", s.name.c_str(), s.calls, s.redundant, s.errors, s.seconds * 1e6, s.seconds * 1e9 / s.calls, s.max_seconds * 1e9);
+		}
+	}
+	::munmap((void*)data, st.st_size);
+	::close(fd);
+	return 0;
+}
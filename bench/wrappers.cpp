@@ -0,0 +1,304 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+// Compares the main code paths of the wrappers with the OpenGL calls an
+// application would issue without gladus. Reports the CPU time, the number of
+// OpenGL calls and the number of heap allocations per operation, either as a
+// table or, with --json, as a JSON document for tracking results over time.
+//
+// The raw equivalents live in the gladus namespace, such that their calls go
+// through the same counting shadows as the ones of the wrappers. Allocations
+// are counted by replacing the global operator new, so memory the driver
+// allocates with malloc is not included. Every operation alternates between
+// two objects, such that the binding cache cannot elide all binds.
+#define GLADUS_COUNT_GL_CALLS
+#include <gladus/opengl.hpp>
+#include <gladus/context.hpp>
+#include <gladus/buffer.hpp>
+#include <gladus/texture.hpp>
+#include <gladus/shader.hpp>
+#include <gladus/program.hpp>
+#include <gladus/state.hpp>
+#include <gladus/framebuffer.hpp>
+#include "headless.hpp"
+#include "json.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+	allocations++;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#if defined(GLADUS_DONT_CHECK_GL_ERRORS)
+static const char* const error_checking = "none";
+#elif defined(GLADUS_DEFER_GL_ERRORS)
+static const char* const error_checking = "deferred";
+#else
+static const char* const error_checking = "immediate";
+#endif
+
+struct vec2 { GLint x, y; vec2(): x(0), y(0) {} vec2(GLint x, GLint y): x(x), y(y) {} };
+
+struct result
+{
+	const char* operation;
+	const char* implementation;
+	double ns_per_op;
+	double calls_per_op;
+	double allocations_per_op;
+};
+
+/// Runs the operation a few times and keeps the fastest run, which is the
+/// one least disturbed by the rest of the system.
+template <typename F> result measure(const char* operation, const char* implementation, unsigned long ops, F op)
+{
+	static const int runs = 3;
+	result best = { operation, implementation, 0, 0, 0 };
+	for (int run = 0; run < runs; run++) {
+		glFinish();
+		unsigned long long calls = gladus::gl_call_statistics::current().calls;
+		unsigned long long allocated = allocations;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned long i = 0; i < ops; i++)
+			op(i);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(end - start).count() / ops;
+		if (run == 0 || ns < best.ns_per_op) {
+			best.ns_per_op = ns;
+			best.calls_per_op = double(gladus::gl_call_statistics::current().calls - calls) / ops;
+			best.allocations_per_op = double(allocations - allocated) / ops;
+		}
+		glFinish();
+	}
+	return best;
+}
+
+static std::vector<result> results;
+
+template <typename W, typename R> void compare(const char* operation, unsigned long ops, W wrapper, R raw)
+{
+	results.push_back(measure(operation, "gladus", ops, wrapper));
+	results.push_back(measure(operation, "raw", ops, raw));
+}
+
+static const char* const vertex_source =
+	"#version 450 core\n"
+	"in vec4 position;\n"
+	"void main() { gl_Position = position; }\n";
+static const char* const fragment_source =
+	"#version 450 core\n"
+	"uniform vec4 tint;\n"
+	"out vec4 color;\n"
+	"void main() { color = tint; }\n";
+
+static void compile(gladus::program& p, GLenum type, const char* source)
+{
+	gladus::shader s(type);
+	s.source(source, std::strlen(source));
+	gladus::shader_compile_result r = s.compile();
+	if (!r.success) {
+		std::fprintf(stderr, "wrappers: failed to compile shader: %s\n", r.info.c_str());
+		std::exit(1);
+	}
+	p.attach(s);
+}
+
+namespace gladus {
+namespace raw {
+
+// The calls an application would issue for each operation without gladus.
+// Objects are bound unconditionally, since there is no binding cache.
+
+static void buffer_data(bool dsa, GLuint id, GLsizeiptr size, const GLvoid* data)
+{
+	if (dsa) { glNamedBufferData(id, size, data, GL_DYNAMIC_DRAW); return; }
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
+}
+
+static void buffer_subdata(bool dsa, GLuint id, GLsizeiptr size, const GLvoid* data)
+{
+	if (dsa) { glNamedBufferSubData(id, 0, size, data); return; }
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+}
+
+static void buffer_map(bool dsa, GLuint id)
+{
+	if (dsa) { glMapNamedBuffer(id, GL_WRITE_ONLY); glUnmapNamedBuffer(id); return; }
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+static void buffer_map_range(bool dsa, GLuint id, GLsizeiptr size)
+{
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+	if (dsa) { glMapNamedBufferRange(id, 0, size, access); glUnmapNamedBuffer(id); return; }
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	glMapBufferRange(GL_ARRAY_BUFFER, 0, size, access);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+static void texture_image2d(GLuint id, GLsizei size, const GLvoid* pixels)
+{
+	glBindTexture(GL_TEXTURE_2D, id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+static void texture_subimage2d(bool dsa, GLuint id, GLsizei size, const GLvoid* pixels)
+{
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (dsa) { glTextureSubImage2D(id, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels); return; }
+	glBindTexture(GL_TEXTURE_2D, id);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+static GLint uniform_location(GLuint program, const char* name) { return glGetUniformLocation(program, name); }
+static void uniform4f(GLint location, GLfloat v) { glUniform4f(location, v, v, v, 1); }
+static void uniform4fv(GLint location, const GLfloat* v) { glUniform4fv(location, 1, v); }
+
+/// Enables two capabilities and restores their previous values, as a scope
+/// of gladus::state does.
+static void state_enable_reset()
+{
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	GLboolean cull = glIsEnabled(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
+	if (!blend) glDisable(GL_BLEND);
+	if (!cull) glDisable(GL_CULL_FACE);
+}
+
+static GLenum framebuffer_status(bool dsa, GLuint id)
+{
+	if (dsa) return glCheckNamedFramebufferStatus(id, GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, id);
+	return glCheckFramebufferStatus(GL_FRAMEBUFFER);
+}
+
+} // namespace raw
+} // namespace gladus
+
+int main(int argc, char** argv)
+{
+	unsigned long ops = 20000;
+	bool json = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--json") == 0) json = true;
+		else ops = std::strtoul(argv[i], NULL, 10);
+	}
+	if (ops == 0) {
+		std::fprintf(stderr, "usage: %s [--json] [ops]\n", argv[0]);
+		return 1;
+	}
+	headless_context headless(4, 5);
+	gladus::context& ctx = gladus::context::current();
+	const bool dsa = ctx.direct_state_access();
+
+	static const GLubyte pixels[16*16*4] = {0};
+	gladus::buffer buffer0(GL_ARRAY_BUFFER), buffer1(GL_ARRAY_BUFFER);
+	gladus::texture texture0(GL_TEXTURE_2D), texture1(GL_TEXTURE_2D);
+	gladus::framebuffer framebuffer0(GL_FRAMEBUFFER), framebuffer1(GL_FRAMEBUFFER);
+	gladus::buffer* buffers[2] = { &buffer0, &buffer1 };
+	gladus::texture* textures[2] = { &texture0, &texture1 };
+	gladus::framebuffer* framebuffers[2] = { &framebuffer0, &framebuffer1 };
+	for (int i = 0; i < 2; i++) {
+		buffers[i]->data(sizeof(pixels), NULL, GL_DYNAMIC_DRAW);
+		textures[i]->image2d(gladus::texture_image<vec2>(0, GL_RGBA8, vec2(16,16)), gladus::texture_data(GL_RGBA, GL_UNSIGNED_BYTE, 4, pixels));
+		framebuffers[i]->attach(GL_COLOR_ATTACHMENT0, *textures[i], 0);
+	}
+
+	gladus::program program;
+	compile(program, GL_VERTEX_SHADER, vertex_source);
+	compile(program, GL_FRAGMENT_SHADER, fragment_source);
+	gladus::program_link_result linked = program.link();
+	if (!linked.success) {
+		std::fprintf(stderr, "wrappers: failed to link program: %s\n", linked.info.c_str());
+		return 1;
+	}
+	program.use();
+	const gladus::uniform_key tint_key("tint");
+	const GLint tint_location = program.uniform(tint_key).location;
+	gladus::typed_uniform<GL_FLOAT_VEC4> tint = program.uniform<GL_FLOAT_VEC4>(tint_key);
+
+	compare("buffer::data", ops,
+		[&](unsigned long i) { buffers[i%2]->data(sizeof(pixels), pixels, GL_DYNAMIC_DRAW); },
+		[&](unsigned long i) { gladus::raw::buffer_data(dsa, buffers[i%2]->id, sizeof(pixels), pixels); });
+	compare("buffer::subdata", ops,
+		[&](unsigned long i) { buffers[i%2]->subdata(0, 64, pixels); },
+		[&](unsigned long i) { gladus::raw::buffer_subdata(dsa, buffers[i%2]->id, 64, pixels); });
+	compare("buffer::map", ops,
+		[&](unsigned long i) { buffers[i%2]->map(GL_WRITE_ONLY); buffers[i%2]->unmap(); },
+		[&](unsigned long i) { gladus::raw::buffer_map(dsa, buffers[i%2]->id); });
+	compare("buffer::map_range", ops,
+		[&](unsigned long i) { buffers[i%2]->map_range(0, 64, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT); buffers[i%2]->unmap(); },
+		[&](unsigned long i) { gladus::raw::buffer_map_range(dsa, buffers[i%2]->id, 64); });
+	compare("texture::image2d", ops,
+		[&](unsigned long i) { textures[i%2]->image2d(gladus::texture_image<vec2>(0, GL_RGBA8, vec2(16,16)), gladus::texture_data(GL_RGBA, GL_UNSIGNED_BYTE, 4, pixels)); },
+		[&](unsigned long i) { gladus::raw::texture_image2d(textures[i%2]->id, 16, pixels); });
+	compare("texture::image2d (sub)", ops,
+		[&](unsigned long i) { textures[i%2]->image2d(gladus::texture_subimage<vec2>(0, vec2(0,0), vec2(4,4)), gladus::texture_data(GL_RGBA, GL_UNSIGNED_BYTE, 4, pixels)); },
+		[&](unsigned long i) { gladus::raw::texture_subimage2d(dsa, textures[i%2]->id, 4, pixels); });
+	compare("program::uniform (name)", ops,
+		[&](unsigned long) { program.uniform("tint"); },
+		[&](unsigned long) { gladus::raw::uniform_location(program.id, "tint"); });
+	compare("program::uniform (key)", ops,
+		[&](unsigned long) { program.uniform(tint_key); },
+		[&](unsigned long) { gladus::raw::uniform_location(program.id, "tint"); });
+	compare("program_uniform::f", ops,
+		[&](unsigned long i) { program.uniform(tint_key).f(GLfloat(i), GLfloat(i), GLfloat(i), 1); },
+		[&](unsigned long i) { gladus::raw::uniform4f(tint_location, GLfloat(i)); });
+	// Every value differs from the previous one, so the shadow copy of the
+	// typed uniform never skips the upload.
+	compare("typed_uniform::set", ops,
+		[&](unsigned long i) { GLfloat v[4] = { GLfloat(i), 0, 0, 1 }; tint.set(v); },
+		[&](unsigned long i) { GLfloat v[4] = { GLfloat(i), 0, 0, 1 }; gladus::raw::uniform4fv(tint_location, v); });
+	compare("state::enable/reset", ops,
+		[&](unsigned long) { gladus::state s; s.enable(GL_BLEND).enable(GL_CULL_FACE); },
+		[&](unsigned long) { gladus::raw::state_enable_reset(); });
+	compare("framebuffer::validate", ops,
+		[&](unsigned long i) { framebuffers[i%2]->validate(); },
+		[&](unsigned long i) { gladus::raw::framebuffer_status(dsa, framebuffers[i%2]->id); });
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	if (json) {
+		std::printf("{\n");
+		std::printf("  \"benchmark\": \"wrappers\",\n");
+		std::printf("  \"renderer\": %s,\n", json_string(renderer).c_str());
+		std::printf("  \"version\": %s,\n", json_string(version).c_str());
+		std::printf("  \"direct_state_access\": %s,\n", dsa ? "true" : "false");
+		std::printf("  \"error_checking\": \"%s\",\n", error_checking);
+		std::printf("  \"ops\": %lu,\n", ops);
+		std::printf("  \"results\": [\n");
+		for (size_t i = 0; i < results.size(); i++) {
+			const result& r = results[i];
+			std::printf("    {\"operation\": \"%s\", \"implementation\": \"%s\", \"ns_per_op\": %.1f, \"gl_calls_per_op\": %.2f, \"allocations_per_op\": %.2f}%s\n",
+				r.operation, r.implementation, r.ns_per_op, r.calls_per_op, r.allocations_per_op, i + 1 < results.size() ? "," : "");
+		}
+		std::printf("  ]\n}\n");
+		return 0;
+	}
+	std::printf("%s, %s, direct state access %s, %s error checking\n", renderer, version, dsa ? "on" : "off", error_checking);
+	std::printf("%-24s %-8s %12s %10s %10s\n", "operation", "impl", "ns/op", "calls/op", "allocs/op");
+	for (size_t i = 0; i < results.size(); i++) {
+		const result& r = results[i];
+		std::printf("%-24s %-8s %12.1f %10.2f %10.2f\n", r.operation, r.implementation, r.ns_per_op, r.calls_per_op, r.allocations_per_op);
+	}
+	return 0;
+}
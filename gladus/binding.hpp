@@ -1,5 +1,7 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
 #include <cassert>
 #define GLADUS_HAS_BINDING
 
@@ -7,7 +9,9 @@ namespace gladus {
 
 /** A pair of bind() and unbind() calls limited to the scope of the declared
  * variable. Provides a convenient exception-safe way of using OpenGL resources
- * that implement a bind/unbind pattern. May not be nested. */
+ * that implement a bind/unbind pattern. Upon unbind() the binding that was in
+ * place before is restored, so scopes may be nested. T has to provide
+ * current_binding() and restore_binding(GLuint) next to bind(). */
 template <typename T> struct scoped_bind
 {
 	typedef T type;
@@ -16,16 +20,18 @@ template <typename T> struct scoped_bind
 	scoped_bind(const T& object): object(object) { is_bound = false; bind(); }
 	~scoped_bind() { if (is_bound) unbind(); }
 
-	void bind() { assert(!is_bound); object.bind(); is_bound = true; }
-	void unbind() { assert(is_bound); object.unbind(); is_bound = false; }
+	void bind() { assert(!is_bound); previous = object.current_binding(); object.bind(); is_bound = true; }
+	void unbind() { assert(is_bound); object.restore_binding(previous); is_bound = false; }
 
 private:
 	bool is_bound;
+	GLuint previous;
 };
 
 /** A pair of use() and unuse() calls limited to the scope of the declared
  * variable. Provides a convenient exception-safe way of using OpenGL resources
- * that implement a use/unuse pattern. May not be nested. */
+ * that implement a use/unuse pattern. Upon unuse() the object that was in use
+ * before is restored, so scopes may be nested. */
 template <typename T> struct scoped_use
 {
 	typedef T type;
@@ -34,11 +40,32 @@ template <typename T> struct scoped_use
 	scoped_use(const T& object): object(object) { is_used = false; use(); }
 	~scoped_use() { if (is_used) unuse(); }
 
-	void use() { assert(!is_used); object.use(); is_used = true; }
-	void unuse() { assert(is_used); object.unuse(); is_used = false; }
+	void use() { assert(!is_used); previous = object.current_binding(); object.use(); is_used = true; }
+	void unuse() { assert(is_used); object.restore_binding(previous); is_used = false; }
 
 private:
 	bool is_used;
+	GLuint previous;
 };
 
+inline void throw_on_active_texture_error(const opengl_error& err)
+{
+	switch (err.ec) {
+		case GL_INVALID_ENUM: throw runtime_error("texture: failed to activate unit: 'unit' exceeds the number of texture units", err);
+		default: throw err;
+	}
+}
+
+/// Selects the texture unit subsequent texture binds apply to. The unit is
+/// given as an index, i.e. 0 selects GL_TEXTURE0.
+inline void active_texture(GLuint unit)
+{
+	binding_cache& cache = context::current().bindings;
+	if (cache.texture_unit_active(unit)) return;
+	clear_opengl_error();
+	glActiveTexture(GL_TEXTURE0 + unit);
+	on_opengl_error(throw_on_active_texture_error);
+	cache.activate_texture_unit(unit);
+}
+
 } // namespace gladus
@@ -0,0 +1,304 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/program.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#define GLADUS_HAS_BLOCK_BUFFER
+
+#ifndef GLADUS_MAX_DIRTY_RANGES
+#	define GLADUS_MAX_DIRTY_RANGES 8
+#endif
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_1
+/// Tags describing the GLSL types of the members of a uniform or shader
+/// storage block. Matrices are column-major, i.e. mat2x3 has 2 columns of 3
+/// rows each. Booleans occupy 4 bytes in a block and are written as GLuint.
+namespace glsl {
+	template <typename C, int Rows, int Columns = 1> struct basic
+	{
+		typedef C component;
+		enum { rows = Rows, columns = Columns, count = Rows * Columns };
+	};
+
+	template <typename T, int N> struct array
+	{
+		typedef T element;
+		typedef typename T::component component;
+		enum { length = N, count = N * T::count };
+	};
+
+	/// A nested struct. Its members can be placed but not set individually;
+	/// use block_buffer::write() together with the offsets of a block_layout
+	/// of the struct's members.
+	template <typename... Members> struct structure {};
+
+	typedef basic<GLfloat, 1> float_;
+	typedef basic<GLfloat, 2> vec2;
+	typedef basic<GLfloat, 3> vec3;
+	typedef basic<GLfloat, 4> vec4;
+	typedef basic<GLint, 1> int_;
+	typedef basic<GLint, 2> ivec2;
+	typedef basic<GLint, 3> ivec3;
+	typedef basic<GLint, 4> ivec4;
+	typedef basic<GLuint, 1> uint;
+	typedef basic<GLuint, 2> uvec2;
+	typedef basic<GLuint, 3> uvec3;
+	typedef basic<GLuint, 4> uvec4;
+	typedef basic<GLuint, 1> bool_;
+	typedef basic<GLfloat, 2, 2> mat2;
+	typedef basic<GLfloat, 3, 3> mat3;
+	typedef basic<GLfloat, 4, 4> mat4;
+	typedef basic<GLfloat, 3, 2> mat2x3;
+	typedef basic<GLfloat, 4, 2> mat2x4;
+	typedef basic<GLfloat, 2, 3> mat3x2;
+	typedef basic<GLfloat, 4, 3> mat3x4;
+	typedef basic<GLfloat, 2, 4> mat4x2;
+	typedef basic<GLfloat, 3, 4> mat4x3;
+}
+
+/// Layout rules of a block, given as the first argument to block_layout.
+/// std140 is available for uniform and shader storage blocks, std430 only
+/// for shader storage blocks.
+struct std140 { enum { minimum_array_alignment = 16 }; };
+struct std430 { enum { minimum_array_alignment = 1 }; };
+
+namespace detail {
+	constexpr size_t round_up(size_t x, size_t a) { return (x + a - 1) / a * a; }
+	constexpr size_t max_of(size_t a, size_t b) { return a > b ? a : b; }
+}
+
+/// Alignment and size in bytes of a GLSL type within a block of the given
+/// layout, and a function that writes a value of the type into the block.
+/// The source of write() holds the components of the value tightly packed.
+template <typename Layout, typename T> struct block_member_layout;
+
+template <typename Layout, typename C, int Rows> struct block_member_layout<Layout, glsl::basic<C, Rows, 1> >
+{
+	static const size_t alignment = sizeof(C) * (Rows == 1 ? 1 : Rows == 2 ? 2 : 4);
+	static const size_t size = sizeof(C) * Rows;
+
+	static void write(GLubyte* dst, const C* src) { std::memcpy(dst, src, size); }
+};
+
+/// Matrices are laid out like an array of their column vectors.
+template <typename Layout, typename C, int Rows, int Columns> struct block_member_layout<Layout, glsl::basic<C, Rows, Columns> >
+{
+	typedef block_member_layout<Layout, glsl::basic<C, Rows, 1> > column;
+	static const size_t alignment = detail::max_of(column::alignment, Layout::minimum_array_alignment);
+	static const size_t stride = detail::round_up(column::size, alignment);
+	static const size_t size = stride * Columns;
+
+	static void write(GLubyte* dst, const C* src)
+	{
+		for (int i = 0; i < Columns; i++)
+			column::write(dst + i * stride, src + i * Rows);
+	}
+};
+
+template <typename Layout, typename T, int N> struct block_member_layout<Layout, glsl::array<T, N> >
+{
+	typedef block_member_layout<Layout, T> element;
+	static const size_t alignment = detail::max_of(element::alignment, Layout::minimum_array_alignment);
+	static const size_t stride = detail::round_up(element::size, alignment);
+	static const size_t size = stride * N;
+
+	static void write(GLubyte* dst, const typename T::component* src) { write(dst, src, N); }
+	static void write(GLubyte* dst, const typename T::component* src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			element::write(dst + i * stride, src + i * T::count);
+	}
+};
+
+/// Offsets of a sequence of members placed one after the other, starting at
+/// the given byte.
+template <typename Layout, size_t Start, typename... Members> struct block_member_offsets
+{
+	static const size_t end = Start;
+	static const size_t alignment = 1;
+};
+
+template <typename Layout, size_t Start, typename T, typename... Rest> struct block_member_offsets<Layout, Start, T, Rest...>
+{
+	typedef T type;
+	typedef block_member_layout<Layout, T> layout;
+	typedef block_member_offsets<Layout, Start, T, Rest...> self;
+	static const size_t offset = detail::round_up(Start, layout::alignment);
+	typedef block_member_offsets<Layout, offset + layout::size, Rest...> next;
+	static const size_t end = next::end;
+	static const size_t alignment = detail::max_of(layout::alignment, next::alignment);
+
+	template <size_t I, int Dummy = 0> struct member { typedef typename next::template member<I-1>::type type; };
+	template <int Dummy> struct member<0, Dummy> { typedef self type; };
+};
+
+template <typename Layout, typename... Members> struct block_member_layout<Layout, glsl::structure<Members...> >
+{
+	typedef block_member_offsets<Layout, 0, Members...> members;
+	static const size_t alignment = detail::max_of(members::alignment, Layout::minimum_array_alignment);
+	static const size_t size = detail::round_up(members::end, alignment);
+};
+
+/// The layout of a block with the given members, computed at compile time.
+/// Mirrors a block declared in GLSL member by member, e.g.
+///
+///     layout(std140) uniform camera { mat4 view; vec3 eye; float time; };
+///
+/// is described by block_layout<std140, glsl::mat4, glsl::vec3, glsl::float_>.
+/// offset<I>::value is the byte offset of the I-th member.
+template <typename Layout, typename... Members> struct block_layout
+{
+	typedef block_member_offsets<Layout, 0, Members...> members;
+	static const size_t size = detail::round_up(members::end, detail::max_of(members::alignment, Layout::minimum_array_alignment));
+
+	template <size_t I> struct member { typedef typename members::template member<I>::type::type type; };
+	template <size_t I> struct offset { static const size_t value = members::template member<I>::type::offset; };
+};
+
+/// A uniform or shader storage buffer holding one block of the given layout.
+/// Members are set in a copy of the block kept in memory, and the byte ranges
+/// that actually changed are uploaded with subdata() by upload(), or when the
+/// block is bound. A handful of ranges is tracked; beyond
+/// GLADUS_MAX_DIRTY_RANGES they are merged into one.
+///
+///     block_buffer<std140, glsl::mat4, glsl::vec3> camera;
+///     camera.set<0>(view);
+///     camera.set<1>(eye);
+///     camera.bind(prog, "camera", 0);
+template <typename Layout, typename... Members> struct block_buffer
+{
+	typedef block_layout<Layout, Members...> layout;
+	static const size_t size = layout::size;
+
+	gladus::buffer storage;
+
+	explicit block_buffer(GLenum target = GL_UNIFORM_BUFFER, GLenum usage = GL_DYNAMIC_DRAW): storage(target)
+	{
+		std::memset(image, 0, size);
+		storage.data(size, image, usage);
+	}
+
+	block_buffer(const block_buffer&) = delete;
+	block_buffer& operator=(const block_buffer&) = delete;
+
+	/// Sets the I-th member, whose components are given tightly packed, e.g.
+	/// 16 floats for a mat4 or 3*N floats for an array of N vec3.
+	template <size_t I> void set(const typename layout::template member<I>::type::component* v)
+	{
+		typedef block_member_layout<Layout, typename layout::template member<I>::type> member;
+		GLubyte value[member::size];
+		std::memcpy(value, image + layout::template offset<I>::value, member::size);
+		member::write(value, v);
+		write(layout::template offset<I>::value, value, member::size);
+	}
+
+	/// Sets a member that holds a single component, e.g. a float.
+	template <size_t I> void set(typename layout::template member<I>::type::component v)
+	{
+		static_assert(layout::template member<I>::type::count == 1, "set(component) requires a scalar member");
+		set<I>(&v);
+	}
+
+	/// Sets one element of the I-th member, which has to be an array.
+	template <size_t I> void set(size_t index, const typename layout::template member<I>::type::component* v)
+	{
+		typedef typename layout::template member<I>::type array;
+		typedef block_member_layout<Layout, array> member;
+		typedef block_member_layout<Layout, typename array::element> element;
+		assert(index < size_t(array::length));
+		GLubyte value[element::size];
+		element::write(value, v);
+		write(layout::template offset<I>::value + index * member::stride, value, element::size);
+	}
+
+	/// Copies raw bytes into the block, marking them dirty if they differ
+	/// from what the block holds.
+	void write(size_t offset, const void* data, size_t n)
+	{
+		assert(offset + n <= size);
+		if (std::memcmp(image + offset, data, n) == 0) return;
+		std::memcpy(image + offset, data, n);
+		mark_dirty(offset, offset + n);
+	}
+
+	const GLubyte* data() const { return image; }
+	bool dirty() const { return !ranges.empty(); }
+
+	/// Uploads the ranges changed since the last upload.
+	void upload()
+	{
+		for (size_t i = 0; i < ranges.size(); i++)
+			storage.subdata(ranges[i].begin, ranges[i].end - ranges[i].begin, image + ranges[i].begin);
+		ranges.clear();
+	}
+
+	/// Uploads pending changes and binds the buffer to an indexed binding
+	/// point of its target.
+	void bind(GLuint binding)
+	{
+		upload();
+		storage.bind_base(binding);
+	}
+
+	/// Additionally makes the named block of the program use the binding
+	/// point. In debug builds the block's size is checked against the layout.
+	void bind(const program& prog, const char* block, GLuint binding)
+	{
+		#ifdef GL_VERSION_4_3
+		if (storage.target == GL_SHADER_STORAGE_BUFFER)
+			prog.bind_storage_block(block, binding);
+		else
+		#endif
+		{
+			#ifndef NDEBUG
+			if (size_t(prog.uniform_block_size(block)) > size)
+				throw runtime_error("block_buffer: failed to bind: layout is smaller than the block in the program source");
+			#endif
+			prog.bind_uniform_block(block, binding);
+		}
+		bind(binding);
+	}
+
+private:
+	struct range
+	{
+		size_t begin, end;
+		range(size_t begin, size_t end): begin(begin), end(end) {}
+	};
+
+	GLubyte image[size];
+	std::vector<range> ranges;
+
+	/// Adds a range to the dirty ones, merging it with any it overlaps or
+	/// touches.
+	void mark_dirty(size_t begin, size_t end)
+	{
+		for (size_t i = 0; i < ranges.size();) {
+			if (ranges[i].begin <= end && begin <= ranges[i].end) {
+				begin = std::min(begin, ranges[i].begin);
+				end = std::max(end, ranges[i].end);
+				ranges.erase(ranges.begin() + i);
+			} else {
+				i++;
+			}
+		}
+		if (ranges.size() >= GLADUS_MAX_DIRTY_RANGES) {
+			for (size_t i = 0; i < ranges.size(); i++) {
+				begin = std::min(begin, ranges[i].begin);
+				end = std::max(end, ranges[i].end);
+			}
+			ranges.clear();
+		}
+		ranges.push_back(range(begin, end));
+	}
+};
+#endif
+
+} // namespace gladus
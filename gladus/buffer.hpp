@@ -13,61 +13,266 @@ struct buffer
 	GLenum target;
 	void* mapped_data;
 
-	buffer(): target(0), mapped_data(NULL) { glGenBuffers(1, &id); throw_on_opengl_error(); }
-	explicit buffer(GLenum target): target(target), mapped_data(NULL) { glGenBuffers(1, &id); throw_on_opengl_error(); }
+	buffer(): target(0), mapped_data(NULL) { generate(); }
+	explicit buffer(GLenum target): target(target), mapped_data(NULL) { generate(); }
 	explicit buffer(GLenum target, GLuint id): target(target), id(id), mapped_data(NULL) {}
-	~buffer() { if (id > 0) glDeleteBuffers(1, &id); throw_on_opengl_error(); }
+	buffer(buffer&& other) noexcept: id(other.id), target(other.target), mapped_data(other.mapped_data) { other.id = 0; other.mapped_data = NULL; }
+	~buffer() { if (id > 0) { glDeleteBuffers(1, &id); context::current().bindings.forget_buffer(id); throw_on_opengl_error(); } }
+
+	/// Deletes the buffer's name and takes over the other buffer's.
+	buffer& operator=(buffer&& other) noexcept
+	{
+		if (this == &other) return *this;
+		assert(!mapped_data && "buffer still mapped");
+		if (id > 0) { glDeleteBuffers(1, &id); context::current().bindings.forget_buffer(id); }
+		id = other.id; target = other.target; mapped_data = other.mapped_data;
+		other.id = 0; other.mapped_data = NULL;
+		return *this;
+	}
+
+	buffer(const buffer&) = delete;
+	buffer& operator=(const buffer&) = delete;
 
 	operator GLuint() const { return id; }
 
 	void bind() const
 	{
-		assert(target > 0);
+		assert(id > 0 && "buffer has no name");
+		bind_name(id, throw_on_bind_error);
+	}
+	void unbind() const { bind_name(0, throw_on_unbind_error); }
+
+	GLuint current_binding() const { return context::current().bindings.buffer(target); }
+	void restore_binding(GLuint name) const { bind_name(name, throw_on_bind_error); }
+
+	#ifdef GL_VERSION_3_0
+	/// Binds the buffer to an indexed binding point of its target, e.g. the
+	/// uniform block binding a program's block refers to. Like OpenGL, this
+	/// also binds the buffer to the target itself.
+	void bind_base(GLuint index) const
+	{
 		assert(id > 0 && "buffer has no name");
 		clear_opengl_error();
-		glBindBuffer(target, id);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM:  throw runtime_error("buffer: failed to bind: 'target' is not one of the allowed values", err);
-			case GL_INVALID_VALUE: throw runtime_error("buffer: failed to bind: 'id' is not a previously allocated buffer name", err);
-			default: throw err;
-		}
+		glBindBufferBase(target, index, id);
+		on_opengl_error(throw_on_bind_indexed_error);
+		context::current().bindings.bind_buffer(target, id);
 	}
-	void unbind() const
+	void bind_range(GLuint index, GLintptr offset, GLsizeiptr size) const
 	{
-		assert(target > 0);
+		assert(id > 0 && "buffer has no name");
 		clear_opengl_error();
-		glBindBuffer(target, 0);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("buffer: failed to unbind: 'target' is not one of the allowed values", err);
-			default: throw err;
-		}
+		glBindBufferRange(target, index, id, offset, size);
+		on_opengl_error(throw_on_bind_indexed_error);
+		context::current().bindings.bind_buffer(target, id);
 	}
+	#endif
+
+	// The following functions modify the buffer through direct state access
+	// if the context supports it, and by binding the buffer otherwise.
 
-	void data(GLsizeiptr size, const GLvoid* data, GLenum usage) { scoped_bind<buffer> bound(*this); glBufferData(target, size, data, usage); }
-	void subdata(GLintptr offset, GLsizeiptr size, const GLvoid* data) { scoped_bind<buffer> bound(*this); glBufferSubData(target, offset, size, data); }
+	void data(GLsizeiptr size, const GLvoid* data, GLenum usage)
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) { glNamedBufferData(id, size, data, usage); return; }
+		#endif
+		scoped_bind<buffer> bound(*this);
+		glBufferData(target, size, data, usage);
+	}
+	void subdata(GLintptr offset, GLsizeiptr size, const GLvoid* data)
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) { glNamedBufferSubData(id, offset, size, data); return; }
+		#endif
+		scoped_bind<buffer> bound(*this);
+		glBufferSubData(target, offset, size, data);
+	}
 
 	void map(GLenum access) {
 		assert(!mapped_data && "buffer already mapped");
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			mapped_data = glMapNamedBuffer(id, access);
+			if (!mapped_data)
+				on_opengl_error(throw_on_map_error);
+			return;
+		}
+		#endif
 		scoped_bind<buffer> bound(*this);
+		clear_opengl_error();
 		mapped_data = glMapBuffer(target, access);
-		if (!mapped_data) {
-			incase_opengl_error(err) {
-				case GL_INVALID_ENUM: throw runtime_error("buffer: failed to map: 'target' or 'access' is not one of the allowed values", err);
-				case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to map: no buffers is bound", err);
-				default: throw err;
-			}
-		}
+		if (!mapped_data)
+			on_opengl_error(throw_on_map_error);
 	}
 	void unmap() {
 		assert(mapped_data && "buffer not mapped");
+		mapped_data = NULL;
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			if (!glUnmapNamedBuffer(id))
+				on_opengl_error(throw_on_unmap_error);
+			return;
+		}
+		#endif
 		scoped_bind<buffer> bound(*this);
-		if (!glUnmapBuffer(target)) {
-			incase_opengl_error(err) {
-				case GL_INVALID_ENUM: throw runtime_error("buffer: failed to unmap: 'target' is not one of the allowed values", err);
-				case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to map: no buffers is bound", err);
-				default: throw err;
-			}
+		clear_opengl_error();
+		if (!glUnmapBuffer(target))
+			on_opengl_error(throw_on_unmap_error);
+	}
+
+	#ifdef GL_VERSION_3_0
+	/// Maps a range of the buffer. Unlike map(), the access flags may ask
+	/// OpenGL not to synchronize with pending reads of the buffer or to keep
+	/// the mapping alive while the buffer is in use (GL_MAP_PERSISTENT_BIT).
+	/// The returned pointer is also stored in mapped_data.
+	void* map_range(GLintptr offset, GLsizeiptr length, GLbitfield access) {
+		assert(!mapped_data && "buffer already mapped");
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			mapped_data = glMapNamedBufferRange(id, offset, length, access);
+			if (!mapped_data)
+				on_opengl_error(throw_on_map_range_error);
+			return mapped_data;
 		}
+		#endif
+		scoped_bind<buffer> bound(*this);
+		clear_opengl_error();
+		mapped_data = glMapBufferRange(target, offset, length, access);
+		if (!mapped_data)
+			on_opengl_error(throw_on_map_range_error);
+		return mapped_data;
+	}
+	void flush_mapped_range(GLintptr offset, GLsizeiptr length) {
+		assert(mapped_data && "buffer not mapped");
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			glFlushMappedNamedBufferRange(id, offset, length);
+			on_opengl_error(throw_on_flush_mapped_range_error);
+			return;
+		}
+		#endif
+		scoped_bind<buffer> bound(*this);
+		clear_opengl_error();
+		glFlushMappedBufferRange(target, offset, length);
+		on_opengl_error(throw_on_flush_mapped_range_error);
+	}
+	#endif
+
+	#ifdef GL_VERSION_4_4
+	/// Allocates immutable storage for the buffer (ARB_buffer_storage). The
+	/// flags determine how the buffer may be mapped later on.
+	void storage(GLsizeiptr size, const GLvoid* data, GLbitfield flags) {
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			glNamedBufferStorage(id, size, data, flags);
+			on_opengl_error(throw_on_storage_error);
+			return;
+		}
+		#endif
+		scoped_bind<buffer> bound(*this);
+		clear_opengl_error();
+		glBufferStorage(target, size, data, flags);
+		on_opengl_error(throw_on_storage_error);
+	}
+	#endif
+
+	static void throw_on_bind_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM:  throw runtime_error("buffer: failed to bind: 'target' is not one of the allowed values", err);
+			case GL_INVALID_VALUE: throw runtime_error("buffer: failed to bind: 'id' is not a previously allocated buffer name", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_unbind_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("buffer: failed to unbind: 'target' is not one of the allowed values", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_bind_indexed_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("buffer: failed to bind to index: 'target' is not an indexed target", err);
+			case GL_INVALID_VALUE: throw runtime_error("buffer: failed to bind to index: 'index' exceeds the number of binding points, or 'offset' or 'size' violate the target's alignment", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_map_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("buffer: failed to map: 'target' or 'access' is not one of the allowed values", err);
+			case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to map: no buffers is bound", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_map_range_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("buffer: failed to map range: 'offset' or 'length' is negative or exceeds the buffer size", err);
+			case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to map range: buffer is already mapped, or 'access' is not compatible with the buffer's storage", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_flush_mapped_range_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("buffer: failed to flush mapped range: 'offset' or 'length' is negative or exceeds the mapped range", err);
+			case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to flush mapped range: buffer is not mapped, or was not mapped with GL_MAP_FLUSH_EXPLICIT_BIT", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_storage_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("buffer: failed to allocate storage: 'size' is not positive, or 'flags' contains invalid bits", err);
+			case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to allocate storage: buffer already has immutable storage, or no buffer is bound", err);
+			case GL_OUT_OF_MEMORY: throw runtime_error("buffer: failed to allocate storage: out of memory", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_unmap_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("buffer: failed to unmap: 'target' is not one of the allowed values", err);
+			case GL_INVALID_OPERATION: throw runtime_error("buffer: failed to map: no buffers is bound", err);
+			default: throw err;
+		}
+	}
+
+private:
+	/// Allocates the buffer's name. Contexts supporting direct state access
+	/// create the buffer object right away, since DSA calls reject names that
+	/// have never been bound.
+	void generate()
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().supports_direct_state_access()) {
+			glCreateBuffers(1, &id);
+			throw_on_opengl_error();
+			return;
+		}
+		#endif
+		glGenBuffers(1, &id);
+		throw_on_opengl_error();
+	}
+
+	/// Binds a name to the buffer's target, unless the binding cache knows it
+	/// is bound already.
+	void bind_name(GLuint name, opengl_error_handler handler) const
+	{
+		assert(target > 0);
+		binding_cache& cache = context::current().bindings;
+		if (cache.buffer_bound(target, name)) return;
+		clear_opengl_error();
+		glBindBuffer(target, name);
+		on_opengl_error(handler);
+		cache.bind_buffer(target, name);
 	}
 };
 
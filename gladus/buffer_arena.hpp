@@ -0,0 +1,356 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include <cassert>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#define GLADUS_HAS_BUFFER_ARENA
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_1
+/// A range of bytes within one of the buffers of an arena.
+struct buffer_range
+{
+	const buffer* storage;
+	GLintptr offset;
+	GLsizeiptr size;
+
+	buffer_range(): storage(NULL), offset(0), size(0) {}
+	buffer_range(const buffer* storage, GLintptr offset, GLsizeiptr size): storage(storage), offset(offset), size(size) {}
+
+	/// The base vertex of vertices of the given stride stored in the range,
+	/// which has to be aligned to the stride.
+	GLint base_vertex(GLsizei stride) const
+	{
+		assert(offset % stride == 0 && "range not aligned to the vertex stride");
+		return GLint(offset / stride);
+	}
+
+	/// The index of the first of the indices of the given type stored in the
+	/// range, which has to be aligned to the index size.
+	GLuint first_index(GLenum index_type) const
+	{
+		GLintptr size = index_type == GL_UNSIGNED_BYTE ? 1 : index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+		assert(offset % size == 0 && "range not aligned to the index size");
+		return GLuint(offset / size);
+	}
+};
+
+struct buffer_arena_statistics
+{
+	unsigned long allocations;
+	unsigned long frees;
+	/// Allocations moved by defragment(), and the bytes copied for them.
+	unsigned long moves;
+	unsigned long long bytes_moved;
+	/// Blocks allocated and released over the arena's lifetime.
+	unsigned long blocks_created;
+	unsigned long blocks_released;
+
+	buffer_arena_statistics(): allocations(0), frees(0), moves(0), bytes_moved(0), blocks_created(0), blocks_released(0) {}
+};
+
+/// The free ranges of a buffer, ordered by offset. Used by buffer_arena for
+/// each of its blocks; needs no context.
+struct buffer_free_list
+{
+	/// Free ranges by offset.
+	std::map<GLintptr, GLsizeiptr> ranges;
+
+	/// Makes the whole of a buffer of the given size free.
+	void reset(GLsizeiptr size)
+	{
+		ranges.clear();
+		if (size > 0) ranges[0] = size;
+	}
+
+	/// Takes the first free range that can hold size bytes at an offset
+	/// that is a multiple of alignment.
+	bool carve(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+	{
+		for (std::map<GLintptr, GLsizeiptr>::iterator it = ranges.begin(); it != ranges.end(); ++it) {
+			GLintptr start = it->first, end = it->first + it->second;
+			GLintptr aligned = (start + alignment - 1) / alignment * alignment;
+			if (aligned + size > end) continue;
+			ranges.erase(it);
+			if (aligned > start) ranges[start] = aligned - start;
+			if (aligned + size < end) ranges[aligned + size] = end - (aligned + size);
+			offset = aligned;
+			return true;
+		}
+		return false;
+	}
+
+	/// Returns a range to the free list, merging it with adjacent ones.
+	void release(GLintptr offset, GLsizeiptr size)
+	{
+		std::map<GLintptr, GLsizeiptr>::iterator next = ranges.lower_bound(offset);
+		if (next != ranges.end() && offset + size == next->first) {
+			size += next->second;
+			next = ranges.erase(next);
+		}
+		if (next != ranges.begin()) {
+			std::map<GLintptr, GLsizeiptr>::iterator prev = next;
+			--prev;
+			if (prev->first + prev->second == offset) {
+				prev->second += size;
+				return;
+			}
+		}
+		ranges[offset] = size;
+	}
+};
+
+/// Sub-allocates ranges of a few large buffers, such that many small meshes
+/// share their vertex and index buffers and can be drawn with a single bind,
+/// or merged into one multi-draw. Each block keeps a free list ordered by
+/// offset; allocations take the first free range that fits and freed ranges
+/// are merged with their neighbors. Requests larger than the block size get
+/// a block of their own.
+///
+/// Allocations are referred to by handles, since defragment() may move them
+/// to another block; range() resolves a handle to the buffer, offset and size
+/// it currently occupies. Handles of freed allocations may be reused by later
+/// allocations.
+///
+///     buffer_arena::handle mesh = vertices.allocate(n * sizeof(vertex), sizeof(vertex), data);
+///     buffer_range r = vertices.range(mesh);
+///     batch.draw_elements(count, 1, indices.range(mesh_indices).first_index(GL_UNSIGNED_INT), r.base_vertex(sizeof(vertex)));
+struct buffer_arena
+{
+	typedef size_t handle;
+	static const handle invalid_handle = handle(-1);
+
+	GLenum target;
+	GLsizeiptr block_size;
+	GLenum usage;
+	buffer_arena_statistics stats;
+
+	explicit buffer_arena(GLenum target = GL_ARRAY_BUFFER, GLsizeiptr block_size = 4 << 20, GLenum usage = GL_STATIC_DRAW): target(target), block_size(block_size), usage(usage) {}
+
+	buffer_arena(const buffer_arena&) = delete;
+	buffer_arena& operator=(const buffer_arena&) = delete;
+
+	/// Allocates size bytes at an offset that is a multiple of alignment,
+	/// which need not be a power of two, e.g. the stride of a vertex. If data
+	/// is given, it is uploaded to the range.
+	handle allocate(GLsizeiptr size, GLsizeiptr alignment = 4, const GLvoid* data = NULL)
+	{
+		assert(size > 0 && alignment > 0);
+		record r;
+		r.size = size;
+		r.alignment = alignment;
+		r.block = blocks.size();
+		for (size_t i = 0; i < blocks.size() && r.block == blocks.size(); i++)
+			if (blocks[i].storage && blocks[i].free.carve(size, alignment, r.offset)) r.block = i;
+		if (r.block == blocks.size()) {
+			r.block = add_block(size + alignment - 1 > block_size ? size + alignment - 1 : block_size);
+			bool fits = blocks[r.block].free.carve(size, alignment, r.offset);
+			assert(fits);
+			(void)fits;
+		}
+		blocks[r.block].used += size;
+		if (data) blocks[r.block].storage->subdata(r.offset, size, data);
+		stats.allocations++;
+		return store(r);
+	}
+
+	/// Returns the range to the free list of its block. Draws issued before
+	/// still read the old contents, since later writes to the range are
+	/// ordered after them in the command stream.
+	void free(handle h)
+	{
+		assert(h < records.size() && "handle not allocated from this arena");
+		record& r = records[h];
+		assert(r.live && "allocation already freed");
+		blocks[r.block].free.release(r.offset, r.size);
+		blocks[r.block].used -= r.size;
+		r.live = false;
+		unused.push_back(h);
+		stats.frees++;
+	}
+
+	buffer_range range(handle h) const
+	{
+		assert(h < records.size() && "handle not allocated from this arena");
+		const record& r = records[h];
+		assert(r.live && "allocation freed");
+		return buffer_range(blocks[r.block].storage.get(), r.offset, r.size);
+	}
+
+	/// Writes to part of an allocation.
+	void write(handle h, GLintptr offset, GLsizeiptr size, const GLvoid* data)
+	{
+		assert(h < records.size() && "handle not allocated from this arena");
+		const record& r = records[h];
+		assert(r.live && offset + size <= r.size);
+		blocks[r.block].storage->subdata(r.offset + offset, size, data);
+	}
+
+	/// Moves allocations out of the emptiest block into the free space of
+	/// the others with glCopyBufferSubData, copying at most max_bytes, and
+	/// releases the block once it is empty. Meant to be called once per frame
+	/// with a small budget, so the copies are spread over time. Handles stay
+	/// valid; ranges resolved before have to be resolved again. Returns the
+	/// number of bytes copied.
+	GLsizeiptr defragment(GLsizeiptr max_bytes)
+	{
+		size_t source = emptiest_block();
+		if (source == blocks.size()) return 0;
+		GLsizeiptr copied = 0;
+		for (size_t h = 0; h < records.size(); h++) {
+			record& r = records[h];
+			if (!r.live || r.block != source) continue;
+			if (copied + r.size > max_bytes) break;
+			size_t target_block = blocks.size();
+			GLintptr offset = 0;
+			for (size_t i = 0; i < blocks.size() && target_block == blocks.size(); i++)
+				if (i != source && blocks[i].storage && blocks[i].free.carve(r.size, r.alignment, offset)) target_block = i;
+			if (target_block == blocks.size()) break;
+			copy(*blocks[source].storage, r.offset, *blocks[target_block].storage, offset, r.size);
+			blocks[source].free.release(r.offset, r.size);
+			blocks[source].used -= r.size;
+			blocks[target_block].used += r.size;
+			r.block = target_block;
+			r.offset = offset;
+			copied += r.size;
+			stats.moves++;
+			stats.bytes_moved += r.size;
+		}
+		if (blocks[source].used == 0) {
+			blocks[source].storage.reset();
+			blocks[source].free.reset(0);
+			stats.blocks_released++;
+		}
+		return copied;
+	}
+
+	/// Number of blocks holding storage.
+	size_t block_count() const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < blocks.size(); i++) if (blocks[i].storage) n++;
+		return n;
+	}
+	/// Bytes allocated, and bytes of storage held by the blocks.
+	GLsizeiptr used() const
+	{
+		GLsizeiptr n = 0;
+		for (size_t i = 0; i < blocks.size(); i++) n += blocks[i].used;
+		return n;
+	}
+	GLsizeiptr capacity() const
+	{
+		GLsizeiptr n = 0;
+		for (size_t i = 0; i < blocks.size(); i++) if (blocks[i].storage) n += blocks[i].size;
+		return n;
+	}
+
+	static void throw_on_copy_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("buffer_arena: failed to copy: range exceeds a buffer", err);
+			case GL_INVALID_OPERATION: throw runtime_error("buffer_arena: failed to copy: a buffer is mapped", err);
+			default: throw err;
+		}
+	}
+
+private:
+	struct block
+	{
+		std::unique_ptr<gladus::buffer> storage;
+		GLsizeiptr size;
+		GLsizeiptr used;
+		buffer_free_list free;
+
+		block(): size(0), used(0) {}
+	};
+	struct record
+	{
+		size_t block;
+		GLintptr offset;
+		GLsizeiptr size;
+		GLsizeiptr alignment;
+		bool live;
+
+		record(): block(0), offset(0), size(0), alignment(1), live(true) {}
+	};
+
+	std::deque<block> blocks;
+	std::vector<record> records;
+	std::vector<handle> unused;
+
+	size_t add_block(GLsizeiptr size)
+	{
+		// Slots of released blocks are reused, so block indices stay valid.
+		size_t i = 0;
+		while (i < blocks.size() && blocks[i].storage) i++;
+		if (i == blocks.size()) blocks.emplace_back();
+		block& b = blocks[i];
+		b.storage.reset(new gladus::buffer(target));
+		b.storage->data(size, NULL, usage);
+		b.size = size;
+		b.used = 0;
+		b.free.reset(size);
+		stats.blocks_created++;
+		return i;
+	}
+
+	handle store(const record& r)
+	{
+		if (!unused.empty()) {
+			handle h = unused.back();
+			unused.pop_back();
+			records[h] = r;
+			return h;
+		}
+		records.push_back(r);
+		return records.size() - 1;
+	}
+
+	/// The block with the lowest share of used bytes, if there is more than
+	/// one block.
+	size_t emptiest_block() const
+	{
+		size_t best = blocks.size();
+		if (block_count() < 2) return best;
+		for (size_t i = 0; i < blocks.size(); i++) {
+			if (!blocks[i].storage) continue;
+			if (best == blocks.size() || double(blocks[i].used) / blocks[i].size < double(blocks[best].used) / blocks[best].size)
+				best = i;
+		}
+		return best;
+	}
+
+	static void copy(const buffer& from, GLintptr from_offset, const buffer& to, GLintptr to_offset, GLsizeiptr size)
+	{
+		clear_opengl_error();
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			glCopyNamedBufferSubData(from.id, to.id, from_offset, to_offset, size);
+			on_opengl_error(throw_on_copy_error);
+			return;
+		}
+		#endif
+		binding_cache& cache = context::current().bindings;
+		if (!cache.buffer_bound(GL_COPY_READ_BUFFER, from.id)) { glBindBuffer(GL_COPY_READ_BUFFER, from.id); cache.bind_buffer(GL_COPY_READ_BUFFER, from.id); }
+		if (!cache.buffer_bound(GL_COPY_WRITE_BUFFER, to.id)) { glBindBuffer(GL_COPY_WRITE_BUFFER, to.id); cache.bind_buffer(GL_COPY_WRITE_BUFFER, to.id); }
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from_offset, to_offset, size);
+		on_opengl_error(throw_on_copy_error);
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_1
+	typedef gladus::buffer_free_list BufferFreeList;
+	typedef gladus::buffer_arena BufferArena;
+	#endif
+}
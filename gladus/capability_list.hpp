@@ -0,0 +1,91 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+// The capabilities shadowed by capability_cache, as a list of
+// gladus_capability(cap, index) entries mapping each capability to its
+// position in the cache's bitsets. Included by context.hpp to build both
+// capability_cache::index() and its inverse; the includer defines
+// gladus_capability before including this file. Indices have to be unique
+// and below capability_cache::num_capabilities.
+
+gladus_capability(GL_BLEND, 0)
+gladus_capability(GL_COLOR_LOGIC_OP, 1)
+gladus_capability(GL_CULL_FACE, 2)
+gladus_capability(GL_DEPTH_TEST, 3)
+gladus_capability(GL_DITHER, 4)
+gladus_capability(GL_LINE_SMOOTH, 5)
+gladus_capability(GL_POLYGON_OFFSET_FILL, 6)
+gladus_capability(GL_POLYGON_OFFSET_LINE, 7)
+gladus_capability(GL_POLYGON_OFFSET_POINT, 8)
+gladus_capability(GL_POLYGON_SMOOTH, 9)
+gladus_capability(GL_SCISSOR_TEST, 10)
+gladus_capability(GL_STENCIL_TEST, 11)
+gladus_capability(GL_TEXTURE_1D, 12)
+gladus_capability(GL_TEXTURE_2D, 13)
+gladus_capability(GL_CLIP_PLANE0 + 0, 23)
+gladus_capability(GL_CLIP_PLANE0 + 1, 24)
+gladus_capability(GL_CLIP_PLANE0 + 2, 25)
+gladus_capability(GL_CLIP_PLANE0 + 3, 26)
+gladus_capability(GL_CLIP_PLANE0 + 4, 27)
+gladus_capability(GL_CLIP_PLANE0 + 5, 28)
+gladus_capability(GL_CLIP_PLANE0 + 6, 29)
+gladus_capability(GL_CLIP_PLANE0 + 7, 30)
+
+#ifdef GL_VERSION_1_2
+gladus_capability(GL_TEXTURE_3D, 14)
+#endif
+
+#ifdef GL_VERSION_1_3
+gladus_capability(GL_MULTISAMPLE, 15)
+gladus_capability(GL_SAMPLE_ALPHA_TO_COVERAGE, 16)
+gladus_capability(GL_SAMPLE_ALPHA_TO_ONE, 17)
+gladus_capability(GL_SAMPLE_COVERAGE, 18)
+gladus_capability(GL_TEXTURE_CUBE_MAP, 19)
+#endif
+
+#ifdef GL_VERSION_2_0
+gladus_capability(GL_VERTEX_PROGRAM_POINT_SIZE, 20)
+#endif
+
+#ifdef GL_VERSION_3_0
+gladus_capability(GL_FRAMEBUFFER_SRGB, 21)
+gladus_capability(GL_RASTERIZER_DISCARD, 22)
+#endif
+
+#ifdef GL_VERSION_3_1
+gladus_capability(GL_PRIMITIVE_RESTART, 31)
+#endif
+
+#ifdef GL_VERSION_3_2
+gladus_capability(GL_DEPTH_CLAMP, 32)
+gladus_capability(GL_SAMPLE_MASK, 33)
+gladus_capability(GL_TEXTURE_CUBE_MAP_SEAMLESS, 34)
+#endif
+
+#ifdef GL_VERSION_4_0
+gladus_capability(GL_SAMPLE_SHADING, 35)
+#endif
+
+#ifdef GL_VERSION_4_3
+gladus_capability(GL_DEBUG_OUTPUT, 36)
+gladus_capability(GL_DEBUG_OUTPUT_SYNCHRONOUS, 37)
+gladus_capability(GL_PRIMITIVE_RESTART_FIXED_INDEX, 38)
+#endif
+
+// Compatibility profile only.
+#ifdef GL_ALPHA_TEST
+gladus_capability(GL_ALPHA_TEST, 39)
+gladus_capability(GL_COLOR_MATERIAL, 40)
+gladus_capability(GL_FOG, 41)
+gladus_capability(GL_LIGHTING, 42)
+gladus_capability(GL_NORMALIZE, 43)
+#endif
+
+#ifdef GL_LIGHT0
+gladus_capability(GL_LIGHT0 + 0, 44)
+gladus_capability(GL_LIGHT0 + 1, 45)
+gladus_capability(GL_LIGHT0 + 2, 46)
+gladus_capability(GL_LIGHT0 + 3, 47)
+gladus_capability(GL_LIGHT0 + 4, 48)
+gladus_capability(GL_LIGHT0 + 5, 49)
+gladus_capability(GL_LIGHT0 + 6, 50)
+gladus_capability(GL_LIGHT0 + 7, 51)
+#endif
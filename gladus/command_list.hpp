@@ -0,0 +1,240 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/texture.hpp"
+#include "gladus/program.hpp"
+#include "gladus/render_state.hpp"
+#include "gladus/vertex_array.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#define GLADUS_HAS_COMMAND_LIST
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_1
+/// A sequence of gladus operations recorded without touching OpenGL, such
+/// that any thread can build it, and executed later on the thread the
+/// context is current on. Payloads such as buffer data and uniform values are
+/// copied into the list's own storage when recorded; the buffers, textures,
+/// programs and render states referred to have to outlive the execution.
+///
+/// Executing goes through the regular wrappers, so binds, program changes,
+/// uniform assignments and render states that are already in effect are
+/// filtered out by the context's caches. A list may be executed any number of
+/// times, but not while another thread records into it.
+///
+///     // worker thread
+///     list.use(prog);
+///     list.uniform(mvp, m);
+///     list.draw_arrays(GL_TRIANGLES, 0, 36);
+///     // GL thread
+///     list.execute();
+struct command_list
+{
+	command_list(): count(0) {}
+
+	command_list(const command_list&) = delete;
+	command_list& operator=(const command_list&) = delete;
+
+	/// Removes all commands, keeping the storage for recording again.
+	void clear() { storage.clear(); count = 0; }
+
+	bool empty() const { return storage.empty(); }
+	/// Number of commands recorded.
+	size_t size() const { return count; }
+	/// Bytes of storage used by the commands and their payloads.
+	size_t bytes() const { return storage.size(); }
+
+	void bind(const buffer& b) { object_command c = { &b, 0 }; record(op_bind_buffer, &c, sizeof(c)); }
+	void bind_base(const buffer& b, GLuint index) { object_command c = { &b, index }; record(op_bind_buffer_base, &c, sizeof(c)); }
+	void bind(const texture& t, GLuint unit) { object_command c = { &t, unit }; record(op_bind_texture, &c, sizeof(c)); }
+	void use(const program& p) { object_command c = { &p, 0 }; record(op_use_program, &c, sizeof(c)); }
+	void bind(const vertex_array& v) { object_command c = { &v, 0 }; record(op_bind_vertex_array, &c, sizeof(c)); }
+
+	/// Copies size bytes of data to be written to the buffer upon execution.
+	void subdata(buffer& b, GLintptr offset, GLsizeiptr size, const GLvoid* data)
+	{
+		subdata_command c = { &b, offset, size };
+		void* payload = record(op_subdata, &c, sizeof(c), size);
+		std::memcpy(payload, data, size);
+	}
+
+	/// Copies n values of the uniform to be assigned upon execution.
+	template <GLenum Type> void uniform(const typed_uniform<Type>& u, GLsizei n, const typename uniform_traits<Type>::component* v)
+	{
+		if (!u) return;
+		size_t size = n * uniform_traits<Type>::components * sizeof(*v);
+		uniform_command c = { &assign_uniform<Type>, u.owner, u.info, n };
+		void* payload = record(op_uniform, &c, sizeof(c), size);
+		std::memcpy(payload, v, size);
+	}
+	template <GLenum Type> void uniform(const typed_uniform<Type>& u, const typename uniform_traits<Type>::component* v) { uniform(u, 1, v); }
+	template <GLenum Type> void uniform(const typed_uniform<Type>& u, typename uniform_traits<Type>::component v)
+	{
+		static_assert(uniform_traits<Type>::components == 1, "uniform(component) requires a scalar uniform type");
+		uniform(u, 1, &v);
+	}
+
+	/// Applies an interned render state.
+	void apply(const render_state* s) { object_command c = { s, 0 }; record(op_render_state, &c, sizeof(c)); }
+	void enable(GLenum cap) { object_command c = { NULL, cap }; record(op_enable, &c, sizeof(c)); }
+	void disable(GLenum cap) { object_command c = { NULL, cap }; record(op_disable, &c, sizeof(c)); }
+
+	void draw_arrays(GLenum mode, GLint first, GLsizei count, GLsizei instances = 1)
+	{
+		draw_command c = { mode, first, count, 0, 0, instances };
+		record(op_draw_arrays, &c, sizeof(c));
+	}
+	/// Draws indices of the given type from the index buffer of the vertex
+	/// array bound at execution, starting at the given byte offset.
+	void draw_elements(GLenum mode, GLsizei count, GLenum type, GLintptr offset = 0, GLsizei instances = 1)
+	{
+		draw_command c = { mode, 0, count, type, offset, instances };
+		record(op_draw_elements, &c, sizeof(c));
+	}
+
+	/// Issues the recorded commands in order. Has to be called on the thread
+	/// the context is current on.
+	void execute() const
+	{
+		const unsigned char* p = storage.empty() ? NULL : &storage[0];
+		const unsigned char* end = p + storage.size();
+		while (p < end) {
+			const header* h = (const header*)p;
+			const void* c = p + sizeof(header);
+			switch (h->op) {
+				case op_bind_buffer: ((const buffer*)object(c))->bind(); break;
+				case op_bind_buffer_base: ((const buffer*)object(c))->bind_base(((const object_command*)c)->index); break;
+				case op_bind_texture: ((const texture*)object(c))->bind(((const object_command*)c)->index); break;
+				case op_use_program: ((const program*)object(c))->use(); break;
+				case op_bind_vertex_array: ((const vertex_array*)object(c))->bind(); break;
+				case op_subdata: {
+					const subdata_command* s = (const subdata_command*)c;
+					s->target->subdata(s->offset, s->size, payload(c, sizeof(*s)));
+					break;
+				}
+				case op_uniform: {
+					const uniform_command* u = (const uniform_command*)c;
+					u->assign(u->owner, u->info, u->n, payload(c, sizeof(*u)));
+					break;
+				}
+				case op_render_state: ((const render_state*)object(c))->apply(); break;
+				case op_enable: context::current().capabilities.set(((const object_command*)c)->index, true); break;
+				case op_disable: context::current().capabilities.set(((const object_command*)c)->index, false); break;
+				case op_draw_arrays: {
+					const draw_command* d = (const draw_command*)c;
+					clear_opengl_error();
+					if (d->instances == 1) glDrawArrays(d->mode, d->first, d->count);
+					else glDrawArraysInstanced(d->mode, d->first, d->count, d->instances);
+					on_opengl_error(throw_on_draw_error);
+					break;
+				}
+				case op_draw_elements: {
+					const draw_command* d = (const draw_command*)c;
+					clear_opengl_error();
+					if (d->instances == 1) glDrawElements(d->mode, d->count, d->type, (const GLvoid*)d->offset);
+					else glDrawElementsInstanced(d->mode, d->count, d->type, (const GLvoid*)d->offset, d->instances);
+					on_opengl_error(throw_on_draw_error);
+					break;
+				}
+			}
+			p += h->size;
+		}
+	}
+
+	static void throw_on_draw_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("command_list: failed to draw: 'mode' or 'type' is not one of the allowed values", err);
+			case GL_INVALID_VALUE: throw runtime_error("command_list: failed to draw: 'count' or 'instances' is negative", err);
+			case GL_INVALID_OPERATION: throw runtime_error("command_list: failed to draw: no vertex array is bound, a buffer is mapped, or the program cannot execute", err);
+			case GL_INVALID_FRAMEBUFFER_OPERATION: throw runtime_error("command_list: failed to draw: framebuffer is not complete", err);
+			default: throw err;
+		}
+	}
+
+private:
+	enum opcode {
+		op_bind_buffer, op_bind_buffer_base, op_bind_texture, op_use_program, op_bind_vertex_array,
+		op_subdata, op_uniform, op_render_state, op_enable, op_disable,
+		op_draw_arrays, op_draw_elements
+	};
+
+	/// Every command starts with a header and is padded to a multiple of the
+	/// header's alignment, which suffices for all command structs.
+	struct alignas(8) header
+	{
+		unsigned op;
+		unsigned size;
+	};
+	struct object_command
+	{
+		const void* object;
+		GLenum index;
+	};
+	struct subdata_command
+	{
+		buffer* target;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+	struct uniform_command
+	{
+		void (*assign)(program*, const uniform_info*, GLsizei, const void*);
+		program* owner;
+		const uniform_info* info;
+		GLsizei n;
+	};
+	struct draw_command
+	{
+		GLenum mode;
+		GLint first;
+		GLsizei count;
+		GLenum type;
+		GLintptr offset;
+		GLsizei instances;
+	};
+
+	std::vector<unsigned char> storage;
+	size_t count;
+
+	static size_t padded(size_t n) { return (n + alignof(header) - 1) / alignof(header) * alignof(header); }
+	static const void* object(const void* c) { return ((const object_command*)c)->object; }
+	static const void* payload(const void* c, size_t command_size) { return (const unsigned char*)c + padded(command_size); }
+
+	/// Appends a command and reserves extra bytes of payload behind it,
+	/// returning the payload.
+	void* record(opcode op, const void* command, size_t command_size, size_t extra = 0)
+	{
+		size_t size = sizeof(header) + padded(command_size) + padded(extra);
+		assert(size <= 0xffffffffu);
+		size_t at = storage.size();
+		storage.resize(at + size);
+		header h = { unsigned(op), unsigned(size) };
+		std::memcpy(&storage[at], &h, sizeof(h));
+		std::memcpy(&storage[at + sizeof(header)], command, command_size);
+		count++;
+		return &storage[at + sizeof(header) + padded(command_size)];
+	}
+
+	template <GLenum Type> static void assign_uniform(program* owner, const uniform_info* info, GLsizei n, const void* v)
+	{
+		typed_uniform<Type> u;
+		u.owner = owner;
+		u.info = info;
+		u.set(n, (const typename uniform_traits<Type>::component*)v);
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_1
+	typedef gladus::command_list CommandList;
+	#endif
+}
@@ -0,0 +1,114 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/shader.hpp"
+#include "gladus/program.hpp"
+#include <deque>
+#include <functional>
+#define GLADUS_HAS_COMPILE_QUEUE
+
+namespace gladus {
+
+/// Compiles shaders and links programs without waiting for each one in turn.
+/// compile() and link() hand the work to the driver right away; the outcome
+/// is delivered to a callback by poll() once it is available, or by finish().
+/// Submitting all shaders and programs before asking for any outcome allows
+/// the driver to spread the work across its compiler threads.
+///
+/// Completion can only be detected without blocking on contexts supporting
+/// KHR_parallel_shader_compile or ARB_parallel_shader_compile. Elsewhere
+/// poll() blocks on each outcome like compile() and link() do. The shaders
+/// and programs have to outlive their pending entry in the queue; outcomes
+/// still pending when the queue is destroyed are not delivered.
+struct compile_queue
+{
+	typedef std::function<void(const shader_compile_result&)> shader_callback;
+	typedef std::function<void(const program_link_result&)> program_callback;
+
+	void compile(const shader& s, shader_callback done)
+	{
+		s.start_compile();
+		shaders.push_back(pending_shader(&s, done));
+	}
+
+	/// Links a program whose shaders have been submitted for compilation. The
+	/// link does not wait for their outcome either.
+	void link(program& p, program_callback done)
+	{
+		p.start_link();
+		programs.push_back(pending_program(&p, done));
+	}
+
+	/// Delivers the outcomes that are available. Returns the number of
+	/// shaders and programs still pending.
+	size_t poll()
+	{
+		deliver(false);
+		return pending();
+	}
+
+	/// Blocks until all outcomes have been delivered.
+	void finish() { deliver(true); }
+
+	size_t pending() const { return shaders.size() + programs.size(); }
+
+	/// Suggests the number of threads the driver should use for compiling
+	/// shaders. Requires a proc address loader on the context, see
+	/// context::set_proc_address_loader(). Returns false if the driver does
+	/// not support parallel compilation.
+	static bool set_max_compiler_threads(GLuint count)
+	{
+		typedef void (GLAPIENTRY *max_threads_function)(GLuint count);
+		context& ctx = context::current();
+		if (!ctx.supports_parallel_shader_compile()) return false;
+		max_threads_function f = (max_threads_function)ctx.proc_address("glMaxShaderCompilerThreadsKHR");
+		if (!f) f = (max_threads_function)ctx.proc_address("glMaxShaderCompilerThreadsARB");
+		if (!f) return false;
+		f(count);
+		return true;
+	}
+
+private:
+	struct pending_shader
+	{
+		const shader* object;
+		shader_callback done;
+		pending_shader(const shader* object, shader_callback done): object(object), done(done) {}
+	};
+	struct pending_program
+	{
+		program* object;
+		program_callback done;
+		pending_program(program* object, program_callback done): object(object), done(done) {}
+	};
+
+	std::deque<pending_shader> shaders;
+	std::deque<pending_program> programs;
+
+	/// Delivers outcomes in submission order, removing each entry before its
+	/// callback runs such that callbacks may submit further work.
+	void deliver(bool wait)
+	{
+		for (size_t i = 0; i < shaders.size();) {
+			if (!wait && !shaders[i].object->compile_ready()) { i++; continue; }
+			pending_shader p = shaders[i];
+			shaders.erase(shaders.begin() + i);
+			shader_compile_result result = p.object->compile_result();
+			if (p.done) p.done(result);
+		}
+		for (size_t i = 0; i < programs.size();) {
+			if (!wait && !programs[i].object->link_ready()) { i++; continue; }
+			pending_program p = programs[i];
+			programs.erase(programs.begin() + i);
+			program_link_result result = p.object->link_result();
+			if (p.done) p.done(result);
+		}
+	}
+};
+
+} // namespace gladus
+
+namespace gl {
+	typedef gladus::compile_queue CompileQueue;
+}
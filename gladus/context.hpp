@@ -0,0 +1,586 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/extensions.hpp"
+#include <bitset>
+#include <cstddef>
+#define GLADUS_HAS_CONTEXT
+
+#ifndef GLADUS_MAX_TEXTURE_UNITS
+#	define GLADUS_MAX_TEXTURE_UNITS 32
+#endif
+
+namespace gladus {
+
+/// Counters maintained by the binding and capability caches. A bind or
+/// glEnable/glDisable that actually reaches OpenGL counts as issued, one that
+/// was skipped because it would not have changed anything counts as elided.
+/// Queries count the glGet calls that were necessary to learn a value the
+/// cache did not know yet.
+struct binding_statistics
+{
+	unsigned long issued;
+	unsigned long elided;
+	unsigned long queries;
+
+	binding_statistics(): issued(0), elided(0), queries(0) {}
+};
+
+/// Shadow copy of the names bound to the buffer targets, the texture targets
+/// of each texture unit, the framebuffer targets, the vertex array and the
+/// program in use. All slots start out unknown and are learned as objects are
+/// bound through gladus. A slot that is still unknown when its previous value
+/// is needed is queried from OpenGL once. Call invalidate() after changing
+/// bindings with raw OpenGL calls, since the cache cannot see those.
+struct binding_cache
+{
+	static const GLuint unknown = GLuint(-1);
+
+	enum {
+		num_buffer_targets = 14,
+		num_texture_targets = 11,
+		num_texture_units = GLADUS_MAX_TEXTURE_UNITS
+	};
+
+	binding_statistics stats;
+
+	binding_cache() { invalidate(); }
+
+	/// Forgets everything the cache knows about the current bindings.
+	void invalidate()
+	{
+		for (int i = 0; i < num_buffer_targets; i++) buffers[i] = unknown;
+		for (int u = 0; u < num_texture_units; u++)
+			for (int i = 0; i < num_texture_targets; i++)
+				textures[u][i] = unknown;
+		active_unit = unknown;
+		draw_framebuffer = unknown;
+		read_framebuffer = unknown;
+		vertex_array = unknown;
+		program = unknown;
+	}
+
+	/// Returns the name bound to the given buffer target. Targets the cache
+	/// does not track report 0.
+	GLuint buffer(GLenum target)
+	{
+		int i = buffer_index(target);
+		if (i < 0) return 0;
+		if (buffers[i] == unknown) buffers[i] = query(buffer_binding_query(target));
+		return buffers[i];
+	}
+	bool buffer_bound(GLenum target, GLuint name)
+	{
+		int i = buffer_index(target);
+		return i >= 0 && elide(buffers[i] == name);
+	}
+	void bind_buffer(GLenum target, GLuint name)
+	{
+		int i = buffer_index(target);
+		if (i >= 0) buffers[i] = name;
+		stats.issued++;
+	}
+	/// Called when a buffer is deleted, which OpenGL treats as binding 0 to
+	/// every target the buffer was bound to.
+	void forget_buffer(GLuint name)
+	{
+		for (int i = 0; i < num_buffer_targets; i++)
+			if (buffers[i] == name) buffers[i] = 0;
+	}
+
+	/// Returns the index of the active texture unit, i.e. 0 for GL_TEXTURE0.
+	GLuint texture_unit()
+	{
+		if (active_unit == unknown) active_unit = query(GL_ACTIVE_TEXTURE) - GL_TEXTURE0;
+		return active_unit;
+	}
+	bool texture_unit_active(GLuint unit) { return elide(active_unit == unit); }
+	void activate_texture_unit(GLuint unit) { active_unit = unit; stats.issued++; }
+
+	/// Returns the name bound to the given texture target of the active
+	/// texture unit.
+	GLuint texture(GLenum target)
+	{
+		GLuint* slot = texture_slot(target);
+		if (!slot) return 0;
+		if (*slot == unknown) *slot = query(texture_binding_query(target));
+		return *slot;
+	}
+	bool texture_bound(GLenum target, GLuint name)
+	{
+		GLuint* slot = texture_slot(target);
+		return slot && elide(*slot == name);
+	}
+	void bind_texture(GLenum target, GLuint name)
+	{
+		GLuint* slot = texture_slot(target);
+		if (slot) *slot = name;
+		stats.issued++;
+	}
+	void forget_texture(GLuint name)
+	{
+		for (int u = 0; u < num_texture_units; u++)
+			for (int i = 0; i < num_texture_targets; i++)
+				if (textures[u][i] == name) textures[u][i] = 0;
+	}
+
+	/// Returns the name bound to the given framebuffer target. For
+	/// GL_FRAMEBUFFER this is the draw framebuffer.
+	GLuint framebuffer(GLenum target)
+	{
+		if (target == GL_READ_FRAMEBUFFER) {
+			if (read_framebuffer == unknown) read_framebuffer = query(GL_READ_FRAMEBUFFER_BINDING);
+			return read_framebuffer;
+		}
+		if (target == GL_DRAW_FRAMEBUFFER || target == GL_FRAMEBUFFER) {
+			if (draw_framebuffer == unknown) draw_framebuffer = query(GL_DRAW_FRAMEBUFFER_BINDING);
+			return draw_framebuffer;
+		}
+		return 0;
+	}
+	bool framebuffer_bound(GLenum target, GLuint name)
+	{
+		switch (target) {
+			case GL_FRAMEBUFFER:      return elide(draw_framebuffer == name && read_framebuffer == name);
+			case GL_DRAW_FRAMEBUFFER: return elide(draw_framebuffer == name);
+			case GL_READ_FRAMEBUFFER: return elide(read_framebuffer == name);
+			default: return false;
+		}
+	}
+	void bind_framebuffer(GLenum target, GLuint name)
+	{
+		if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER) draw_framebuffer = name;
+		if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER) read_framebuffer = name;
+		stats.issued++;
+	}
+	void forget_framebuffer(GLuint name)
+	{
+		if (draw_framebuffer == name) draw_framebuffer = 0;
+		if (read_framebuffer == name) read_framebuffer = 0;
+	}
+
+	#ifdef GL_VERSION_3_0
+	/// Returns the name of the bound vertex array.
+	GLuint current_vertex_array()
+	{
+		if (vertex_array == unknown) vertex_array = query(GL_VERTEX_ARRAY_BINDING);
+		return vertex_array;
+	}
+	#endif
+	bool vertex_array_bound(GLuint name) { return elide(vertex_array == name); }
+	/// The element array buffer binding is part of the vertex array, so it
+	/// becomes unknown when another vertex array is bound.
+	void bind_vertex_array(GLuint name)
+	{
+		if (vertex_array != name) buffers[1] = unknown;
+		vertex_array = name;
+		stats.issued++;
+	}
+	/// Deleting the bound vertex array reverts the binding to 0.
+	void forget_vertex_array(GLuint name)
+	{
+		if (vertex_array == name) { vertex_array = 0; buffers[1] = unknown; }
+	}
+	/// Records the element array buffer of a vertex array, if that is the
+	/// one bound.
+	void set_element_buffer(GLuint vertex_array_name, GLuint name)
+	{
+		if (vertex_array == vertex_array_name) buffers[1] = name;
+	}
+
+	/// Returns the name of the program in use.
+	GLuint current_program()
+	{
+		if (program == unknown) program = query(GL_CURRENT_PROGRAM);
+		return program;
+	}
+	bool program_used(GLuint name) { return elide(program == name); }
+	void use_program(GLuint name) { program = name; stats.issued++; }
+
+	static int buffer_index(GLenum target)
+	{
+		switch (target) {
+			case GL_ARRAY_BUFFER:              return 0;
+			case GL_ELEMENT_ARRAY_BUFFER:      return 1;
+			#ifdef GL_VERSION_2_1
+			case GL_PIXEL_PACK_BUFFER:         return 2;
+			case GL_PIXEL_UNPACK_BUFFER:       return 3;
+			#endif
+			#ifdef GL_VERSION_3_0
+			case GL_TRANSFORM_FEEDBACK_BUFFER: return 4;
+			#endif
+			#ifdef GL_VERSION_3_1
+			case GL_COPY_READ_BUFFER:          return 5;
+			case GL_COPY_WRITE_BUFFER:         return 6;
+			case GL_TEXTURE_BUFFER:            return 7;
+			case GL_UNIFORM_BUFFER:            return 8;
+			#endif
+			#ifdef GL_VERSION_4_0
+			case GL_DRAW_INDIRECT_BUFFER:      return 9;
+			#endif
+			#ifdef GL_VERSION_4_2
+			case GL_ATOMIC_COUNTER_BUFFER:     return 10;
+			#endif
+			#ifdef GL_VERSION_4_3
+			case GL_DISPATCH_INDIRECT_BUFFER:  return 11;
+			case GL_SHADER_STORAGE_BUFFER:     return 12;
+			#endif
+			#ifdef GL_VERSION_4_4
+			case GL_QUERY_BUFFER:              return 13;
+			#endif
+			default: return -1;
+		}
+	}
+
+	static GLenum buffer_binding_query(GLenum target)
+	{
+		switch (target) {
+			case GL_ARRAY_BUFFER:              return GL_ARRAY_BUFFER_BINDING;
+			case GL_ELEMENT_ARRAY_BUFFER:      return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+			#ifdef GL_VERSION_2_1
+			case GL_PIXEL_PACK_BUFFER:         return GL_PIXEL_PACK_BUFFER_BINDING;
+			case GL_PIXEL_UNPACK_BUFFER:       return GL_PIXEL_UNPACK_BUFFER_BINDING;
+			#endif
+			#ifdef GL_VERSION_3_0
+			case GL_TRANSFORM_FEEDBACK_BUFFER: return GL_TRANSFORM_FEEDBACK_BUFFER_BINDING;
+			#endif
+			#ifdef GL_VERSION_3_1
+			case GL_COPY_READ_BUFFER:          return GL_COPY_READ_BUFFER_BINDING;
+			case GL_COPY_WRITE_BUFFER:         return GL_COPY_WRITE_BUFFER_BINDING;
+			case GL_TEXTURE_BUFFER:            return GL_TEXTURE_BUFFER;
+			case GL_UNIFORM_BUFFER:            return GL_UNIFORM_BUFFER_BINDING;
+			#endif
+			#ifdef GL_VERSION_4_0
+			case GL_DRAW_INDIRECT_BUFFER:      return GL_DRAW_INDIRECT_BUFFER_BINDING;
+			#endif
+			#ifdef GL_VERSION_4_2
+			case GL_ATOMIC_COUNTER_BUFFER:     return GL_ATOMIC_COUNTER_BUFFER_BINDING;
+			#endif
+			#ifdef GL_VERSION_4_3
+			case GL_DISPATCH_INDIRECT_BUFFER:  return GL_DISPATCH_INDIRECT_BUFFER_BINDING;
+			case GL_SHADER_STORAGE_BUFFER:     return GL_SHADER_STORAGE_BUFFER_BINDING;
+			#endif
+			#ifdef GL_VERSION_4_4
+			case GL_QUERY_BUFFER:              return GL_QUERY_BUFFER_BINDING;
+			#endif
+			default: return 0;
+		}
+	}
+
+	static int texture_index(GLenum target)
+	{
+		switch (target) {
+			case GL_TEXTURE_1D:                   return 0;
+			case GL_TEXTURE_2D:                   return 1;
+			case GL_TEXTURE_3D:                   return 2;
+			case GL_TEXTURE_CUBE_MAP:             return 3;
+			#ifdef GL_VERSION_3_0
+			case GL_TEXTURE_1D_ARRAY:             return 4;
+			case GL_TEXTURE_2D_ARRAY:             return 5;
+			#endif
+			#ifdef GL_VERSION_3_1
+			case GL_TEXTURE_RECTANGLE:            return 6;
+			case GL_TEXTURE_BUFFER:               return 7;
+			#endif
+			#ifdef GL_VERSION_3_2
+			case GL_TEXTURE_2D_MULTISAMPLE:       return 8;
+			case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return 9;
+			#endif
+			#ifdef GL_VERSION_4_0
+			case GL_TEXTURE_CUBE_MAP_ARRAY:       return 10;
+			#endif
+			default: return -1;
+		}
+	}
+
+	static GLenum texture_binding_query(GLenum target)
+	{
+		switch (target) {
+			case GL_TEXTURE_1D:                   return GL_TEXTURE_BINDING_1D;
+			case GL_TEXTURE_2D:                   return GL_TEXTURE_BINDING_2D;
+			case GL_TEXTURE_3D:                   return GL_TEXTURE_BINDING_3D;
+			case GL_TEXTURE_CUBE_MAP:             return GL_TEXTURE_BINDING_CUBE_MAP;
+			#ifdef GL_VERSION_3_0
+			case GL_TEXTURE_1D_ARRAY:             return GL_TEXTURE_BINDING_1D_ARRAY;
+			case GL_TEXTURE_2D_ARRAY:             return GL_TEXTURE_BINDING_2D_ARRAY;
+			#endif
+			#ifdef GL_VERSION_3_1
+			case GL_TEXTURE_RECTANGLE:            return GL_TEXTURE_BINDING_RECTANGLE;
+			case GL_TEXTURE_BUFFER:               return GL_TEXTURE_BINDING_BUFFER;
+			#endif
+			#ifdef GL_VERSION_3_2
+			case GL_TEXTURE_2D_MULTISAMPLE:       return GL_TEXTURE_BINDING_2D_MULTISAMPLE;
+			case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return GL_TEXTURE_BINDING_2D_MULTISAMPLE_ARRAY;
+			#endif
+			#ifdef GL_VERSION_4_0
+			case GL_TEXTURE_CUBE_MAP_ARRAY:       return GL_TEXTURE_BINDING_CUBE_MAP_ARRAY;
+			#endif
+			default: return 0;
+		}
+	}
+
+private:
+	GLuint buffers[num_buffer_targets];
+	GLuint textures[num_texture_units][num_texture_targets];
+	GLuint active_unit;
+	GLuint draw_framebuffer;
+	GLuint read_framebuffer;
+	GLuint vertex_array;
+	GLuint program;
+
+	bool elide(bool bound) { if (bound) stats.elided++; return bound; }
+
+	GLuint query(GLenum pname)
+	{
+		GLint value = 0;
+		glGetIntegerv(pname, &value);
+		stats.queries++;
+		return value;
+	}
+
+	GLuint* texture_slot(GLenum target)
+	{
+		int i = texture_index(target);
+		if (i < 0) return NULL;
+		GLuint unit = texture_unit();
+		if (unit >= GLuint(num_texture_units)) return NULL;
+		return &textures[unit][i];
+	}
+};
+
+/// Shadow copy of the capabilities toggled with glEnable() and glDisable(),
+/// held in a bitset indexed by a fixed mapping of the known capabilities.
+/// Like the binding cache, every capability starts out unknown and is queried
+/// with glIsEnabled() once when its value is first needed. Capabilities
+/// outside the mapping are passed through to OpenGL unshadowed.
+struct capability_cache
+{
+	enum { num_capabilities = 52 };
+
+	binding_statistics stats;
+
+	capability_cache() { invalidate(); }
+
+	void invalidate() { known.reset(); }
+
+	bool enabled(GLenum cap)
+	{
+		int i = index(cap);
+		if (i < 0) {
+			stats.queries++;
+			return glIsEnabled(cap);
+		}
+		if (!known[i]) {
+			on[i] = glIsEnabled(cap);
+			known[i] = true;
+			stats.queries++;
+		}
+		return on[i];
+	}
+
+	/// Enables or disables the capability unless it is known to be set that
+	/// way already.
+	void set(GLenum cap, bool onoff)
+	{
+		int i = index(cap);
+		if (i >= 0) {
+			if (known[i] && on[i] == onoff) { stats.elided++; return; }
+			known[i] = true;
+			on[i] = onoff;
+		}
+		if (onoff) glEnable(cap); else glDisable(cap);
+		stats.issued++;
+	}
+
+	/// Position of the capability in the bitset, or -1 if the capability is
+	/// not shadowed.
+	static int index(GLenum cap)
+	{
+		switch (cap) {
+			#define gladus_capability(cap, index) case cap: return index;
+			#include "gladus/capability_list.hpp"
+			#undef gladus_capability
+			default: return -1;
+		}
+	}
+
+	/// Inverse of index(): the capability at the given position, or 0 for
+	/// positions not used on this platform.
+	static GLenum capability(int index)
+	{
+		switch (index) {
+			#define gladus_capability(cap, index) case index: return cap;
+			#include "gladus/capability_list.hpp"
+			#undef gladus_capability
+			default: return 0;
+		}
+	}
+
+private:
+	std::bitset<num_capabilities> known;
+	std::bitset<num_capabilities> on;
+};
+
+struct render_state;
+
+/// Shadow state of one OpenGL context. gladus consults the context that is
+/// current on the calling thread to skip redundant state changes. Each thread
+/// implicitly gets its own context object, which suffices as long as every
+/// thread uses a single OpenGL context. Applications that switch one thread
+/// between several OpenGL contexts keep one gladus::context per OpenGL context
+/// and call make_current() alongside the platform's make-current call.
+struct context
+{
+	binding_cache bindings;
+	capability_cache capabilities;
+	/// The interned render_state applied last, or NULL if unknown.
+	const render_state* applied_render_state;
+
+	/// Function of the platform that looks up OpenGL entry points by name,
+	/// e.g. eglGetProcAddress or wglGetProcAddress.
+	typedef void* (*proc_address_loader)(const char* name);
+
+	context(): applied_render_state(NULL), features_detected(false), dsa_supported(-1), dsa(-1), program_uniform_supported(-1), parallel_compile_supported(-1), vertex_attrib_binding_supported(-1), base_instance_supported(-1), multi_draw_indirect_supported(-1), loader(NULL) {}
+	~context() { if (current_pointer() == this) release_current(); }
+
+	/// Returns the context current on the calling thread.
+	static context& current()
+	{
+		context* c = current_pointer();
+		return c ? *c : thread_default();
+	}
+
+	void make_current() { current_pointer() = this; }
+	static void release_current() { current_pointer() = NULL; }
+
+	/// Forgets all shadowed state, e.g. after raw OpenGL calls or after
+	/// handing the OpenGL context to third-party code.
+	void invalidate()
+	{
+		bindings.invalidate();
+		capabilities.invalidate();
+		applied_render_state = NULL;
+	}
+
+	/// Returns the version and extensions of the OpenGL context, which are
+	/// detected upon the first call.
+	const extensions& features()
+	{
+		if (!features_detected) {
+			supported.detect();
+			features_detected = true;
+		}
+		return supported;
+	}
+
+	/// Whether the context supports direct state access, i.e. OpenGL 4.5 or
+	/// ARB_direct_state_access. Wrappers then create their objects with
+	/// glCreate* rather than glGen*.
+	bool supports_direct_state_access()
+	{
+		if (dsa_supported < 0) {
+			const extensions& e = features();
+			dsa_supported = e.version(4,5) || e.has("GL_ARB_direct_state_access");
+		}
+		return dsa_supported;
+	}
+
+	/// Whether wrappers modify objects through direct state access instead of
+	/// binding them first.
+	bool direct_state_access()
+	{
+		if (dsa < 0) dsa = supports_direct_state_access();
+		return dsa;
+	}
+
+	/// Allows to force the bind-to-edit path even if direct state access is
+	/// supported. Enabling has no effect on contexts that lack support.
+	void set_direct_state_access(bool enable) { dsa = enable && supports_direct_state_access(); }
+
+	/// Whether uniforms can be assigned to programs that are not in use
+	/// through glProgramUniform*, i.e. OpenGL 4.1 or
+	/// ARB_separate_shader_objects.
+	bool supports_program_uniform()
+	{
+		if (program_uniform_supported < 0) {
+			const extensions& e = features();
+			program_uniform_supported = e.version(4,1) || e.has("GL_ARB_separate_shader_objects");
+		}
+		return program_uniform_supported;
+	}
+
+	/// Whether the context can report shader compilation and program linking
+	/// as complete without blocking, i.e. supports KHR_parallel_shader_compile
+	/// or ARB_parallel_shader_compile.
+	bool supports_parallel_shader_compile()
+	{
+		if (parallel_compile_supported < 0) {
+			const extensions& e = features();
+			parallel_compile_supported = e.has("GL_KHR_parallel_shader_compile") || e.has("GL_ARB_parallel_shader_compile");
+		}
+		return parallel_compile_supported;
+	}
+
+	/// Whether vertex formats can be specified separately from the buffers
+	/// holding the vertices through glVertexAttribFormat and
+	/// glBindVertexBuffer, i.e. OpenGL 4.3 or ARB_vertex_attrib_binding.
+	bool supports_vertex_attrib_binding()
+	{
+		if (vertex_attrib_binding_supported < 0) {
+			const extensions& e = features();
+			vertex_attrib_binding_supported = e.version(4,3) || e.has("GL_ARB_vertex_attrib_binding");
+		}
+		return vertex_attrib_binding_supported;
+	}
+
+	/// Whether instanced draws can start at an instance other than 0, i.e.
+	/// OpenGL 4.2 or ARB_base_instance.
+	bool supports_base_instance()
+	{
+		if (base_instance_supported < 0) {
+			const extensions& e = features();
+			base_instance_supported = e.version(4,2) || e.has("GL_ARB_base_instance");
+		}
+		return base_instance_supported;
+	}
+
+	/// Whether several indirect draws can be issued with one call, i.e.
+	/// OpenGL 4.3 or ARB_multi_draw_indirect.
+	bool supports_multi_draw_indirect()
+	{
+		if (multi_draw_indirect_supported < 0) {
+			const extensions& e = features();
+			multi_draw_indirect_supported = e.version(4,3) || e.has("GL_ARB_multi_draw_indirect");
+		}
+		return multi_draw_indirect_supported;
+	}
+
+	/// Installs the function used to look up entry points that gladus does not
+	/// link against directly, such as those of some extensions. Without one,
+	/// features that need such entry points are unavailable.
+	void set_proc_address_loader(proc_address_loader l) { loader = l; }
+
+	/// Looks up an OpenGL entry point, or returns NULL if no loader has been
+	/// installed or the entry point is unknown.
+	void* proc_address(const char* name) const { return loader ? loader(name) : NULL; }
+
+private:
+	extensions supported;
+	bool features_detected;
+	int dsa_supported;
+	int dsa;
+	int program_uniform_supported;
+	int parallel_compile_supported;
+	int vertex_attrib_binding_supported;
+	int base_instance_supported;
+	int multi_draw_indirect_supported;
+	proc_address_loader loader;
+
+	static context*& current_pointer() { static thread_local context* c = NULL; return c; }
+	static context& thread_default() { static thread_local context c; return c; }
+};
+
+} // namespace gladus
+
+namespace gl {
+	typedef gladus::context Context;
+}
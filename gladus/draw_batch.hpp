@@ -0,0 +1,264 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/vertex_array.hpp"
+#include <cassert>
+#include <vector>
+#define GLADUS_HAS_DRAW_BATCH
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+/// Layout of the commands glMultiDrawArraysIndirect reads.
+struct draw_arrays_command
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first;
+	GLuint base_instance;
+};
+
+/// Layout of the commands glMultiDrawElementsIndirect reads.
+struct draw_elements_command
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+struct draw_batch_statistics
+{
+	unsigned long submits;
+	unsigned long draws;
+	/// Draw calls issued to OpenGL, which is one per submit if the context
+	/// supports multi-draw indirect and one per draw otherwise.
+	unsigned long calls;
+
+	draw_batch_statistics(): submits(0), draws(0), calls(0) {}
+};
+
+/// Vertex holding the draw ID of an instance, see draw_batch::draw_ids().
+struct draw_id_vertex
+{
+	GLuint id;
+};
+
+/// Vertex format of the draw IDs, read by the shader as an unsigned integer
+/// attribute at the given location.
+template <GLuint Location> struct draw_id_format: instanced_format<vertex_format<draw_id_vertex, vertex_attribute<Location, GLuint, 0> > > {};
+
+/// Collects many draws of the same primitive mode and index type, which
+/// submit() issues with a single glMultiDrawElementsIndirect or
+/// glMultiDrawArraysIndirect from a GL_DRAW_INDIRECT_BUFFER. Contexts without
+/// ARB_multi_draw_indirect issue the draws one by one, with
+/// glDraw*InstancedBaseVertexBaseInstance if ARB_base_instance is supported
+/// and glDrawElementsInstancedBaseVertex or glDrawArraysInstanced
+/// otherwise. Draws use the vertex array bound at submit().
+///
+/// Each draw gets an ID, its index in the batch, which shaders can use to
+/// look up per-draw data. The batch assigns the base instance of the draws
+/// such that the instances of each draw are consecutive, and fills a buffer
+/// with the draw ID of every instance. Bound as a per-instance vertex
+/// attribute with bind_draw_ids(), it delivers the draw ID on every context,
+/// whereas gl_DrawID requires ARB_shader_draw_parameters:
+///
+///     batch.bind_draw_ids<3>(vao, 1);  // layout(location = 3) in uint draw_id;
+///     for (...) batch.draw_elements(mesh.count, 1, mesh.first_index, mesh.base_vertex);
+///     vao.bind();
+///     batch.submit();
+///
+/// Other per-instance attributes are offset by the base instance only if the
+/// context supports ARB_base_instance.
+struct draw_batch
+{
+	GLenum mode;
+	/// GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for batches of
+	/// indexed draws, GL_NONE for batches of non-indexed draws.
+	GLenum index_type;
+	draw_batch_statistics stats;
+
+	explicit draw_batch(GLenum mode, GLenum index_type = GL_NONE):
+		mode(mode), index_type(index_type), commands(GL_DRAW_INDIRECT_BUFFER), ids(GL_ARRAY_BUFFER), instances(0), uploaded(false), id_array(NULL), id_binding(0) {}
+
+	draw_batch(const draw_batch&) = delete;
+	draw_batch& operator=(const draw_batch&) = delete;
+
+	/// Adds a non-indexed draw and returns its ID.
+	GLuint draw_arrays(GLuint count, GLuint instance_count = 1, GLuint first = 0)
+	{
+		assert(index_type == GL_NONE && "batch of indexed draws");
+		draw_arrays_command c = { count, instance_count, first, instances };
+		arrays.push_back(c);
+		return added(instance_count);
+	}
+
+	/// Adds an indexed draw and returns its ID. first_index counts indices,
+	/// not bytes.
+	GLuint draw_elements(GLuint count, GLuint instance_count = 1, GLuint first_index = 0, GLint base_vertex = 0)
+	{
+		assert(index_type != GL_NONE && "batch of non-indexed draws");
+		draw_elements_command c = { count, instance_count, first_index, base_vertex, instances };
+		elements.push_back(c);
+		return added(instance_count);
+	}
+
+	/// Removes all draws, keeping the storage for building the next batch.
+	void clear()
+	{
+		arrays.clear();
+		elements.clear();
+		draw_id_values.clear();
+		instances = 0;
+		uploaded = false;
+	}
+
+	size_t size() const { return index_type == GL_NONE ? arrays.size() : elements.size(); }
+	bool empty() const { return size() == 0; }
+
+	/// The buffer holding the draw ID of every instance of the batch.
+	const buffer& draw_ids() const { return ids; }
+
+	/// Sets up the given binding index of the vertex array to read the draw
+	/// IDs as the unsigned integer attribute at Location. The vertex array
+	/// has to be bound whenever the batch is submitted.
+	template <GLuint Location> void bind_draw_ids(vertex_array& vao, GLuint binding)
+	{
+		vao.format<draw_id_format<Location> >(binding);
+		upload_draw_ids();
+		vao.vertex_buffer<draw_id_format<Location> >(binding, ids);
+		id_array = &vao;
+		id_binding = binding;
+	}
+
+	/// Issues all draws of the batch. The batch may be submitted any number
+	/// of times.
+	void submit()
+	{
+		if (empty()) return;
+		if (!uploaded) upload();
+		context& ctx = context::current();
+		stats.submits++;
+		stats.draws += size();
+		clear_opengl_error();
+		#ifdef GL_VERSION_4_3
+		if (ctx.supports_multi_draw_indirect()) {
+			commands.bind();
+			if (index_type == GL_NONE) glMultiDrawArraysIndirect(mode, NULL, arrays.size(), 0);
+			else glMultiDrawElementsIndirect(mode, index_type, NULL, elements.size(), 0);
+			stats.calls++;
+			on_opengl_error(throw_on_submit_error);
+			return;
+		}
+		#endif
+		#ifdef GL_VERSION_4_2
+		if (ctx.supports_base_instance()) {
+			for (size_t i = 0; i < arrays.size(); i++) {
+				const draw_arrays_command& c = arrays[i];
+				glDrawArraysInstancedBaseInstance(mode, c.first, c.count, c.instance_count, c.base_instance);
+			}
+			for (size_t i = 0; i < elements.size(); i++) {
+				const draw_elements_command& c = elements[i];
+				glDrawElementsInstancedBaseVertexBaseInstance(mode, c.count, index_type, index_offset(c.first_index), c.instance_count, c.base_vertex, c.base_instance);
+			}
+			stats.calls += size();
+			on_opengl_error(throw_on_submit_error);
+			return;
+		}
+		#endif
+		(void)ctx;
+		// Without base instances, the draw ID attribute is offset by moving
+		// its vertex buffer binding instead. Since that checks for errors
+		// itself, each draw has to be checked before.
+		for (size_t i = 0; i < arrays.size(); i++) {
+			const draw_arrays_command& c = arrays[i];
+			offset_draw_ids(c.base_instance);
+			glDrawArraysInstanced(mode, c.first, c.count, c.instance_count);
+			if (id_array) on_opengl_error(throw_on_submit_error);
+		}
+		for (size_t i = 0; i < elements.size(); i++) {
+			const draw_elements_command& c = elements[i];
+			offset_draw_ids(c.base_instance);
+			glDrawElementsInstancedBaseVertex(mode, c.count, index_type, index_offset(c.first_index), c.instance_count, c.base_vertex);
+			if (id_array) on_opengl_error(throw_on_submit_error);
+		}
+		stats.calls += size();
+		on_opengl_error(throw_on_submit_error);
+		offset_draw_ids(0);
+	}
+
+	static void throw_on_submit_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("draw_batch: failed to submit: 'mode' or 'index_type' is not one of the allowed values", err);
+			case GL_INVALID_VALUE: throw runtime_error("draw_batch: failed to submit: a draw has a negative count", err);
+			case GL_INVALID_OPERATION: throw runtime_error("draw_batch: failed to submit: no vertex array or index buffer is bound, a buffer is mapped, or the program cannot execute", err);
+			case GL_INVALID_FRAMEBUFFER_OPERATION: throw runtime_error("draw_batch: failed to submit: framebuffer is not complete", err);
+			default: throw err;
+		}
+	}
+
+private:
+	std::vector<draw_arrays_command> arrays;
+	std::vector<draw_elements_command> elements;
+	std::vector<GLuint> draw_id_values;
+	buffer commands;
+	buffer ids;
+	GLuint instances;
+	bool uploaded;
+	vertex_array* id_array;
+	GLuint id_binding;
+
+	GLuint added(GLuint instance_count)
+	{
+		GLuint id = GLuint(size() - 1);
+		draw_id_values.insert(draw_id_values.end(), instance_count, id);
+		instances += instance_count;
+		uploaded = false;
+		return id;
+	}
+
+	const GLvoid* index_offset(GLuint first_index) const
+	{
+		size_t size = index_type == GL_UNSIGNED_BYTE ? 1 : index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+		return (const GLvoid*)(first_index * size);
+	}
+
+	/// Uploads the commands and draw IDs, orphaning the previous storage such
+	/// that draws still reading it do not stall.
+	void upload()
+	{
+		#ifdef GL_VERSION_4_3
+		if (context::current().supports_multi_draw_indirect()) {
+			if (index_type == GL_NONE) commands.data(arrays.size() * sizeof(draw_arrays_command), &arrays[0], GL_STREAM_DRAW);
+			else commands.data(elements.size() * sizeof(draw_elements_command), &elements[0], GL_STREAM_DRAW);
+		}
+		#endif
+		if (id_array) upload_draw_ids();
+		uploaded = true;
+	}
+
+	void upload_draw_ids()
+	{
+		// An empty batch still gets a draw ID, so the buffer is never empty.
+		if (draw_id_values.empty()) { GLuint zero = 0; ids.data(sizeof(zero), &zero, GL_STREAM_DRAW); return; }
+		ids.data(draw_id_values.size() * sizeof(GLuint), &draw_id_values[0], GL_STREAM_DRAW);
+	}
+
+	void offset_draw_ids(GLuint base_instance)
+	{
+		if (id_array) id_array->vertex_buffer(id_binding, ids, base_instance * sizeof(GLuint), sizeof(GLuint));
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_2
+	typedef gladus::draw_batch DrawBatch;
+	#endif
+}
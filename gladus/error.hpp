@@ -1,9 +1,16 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
+#include "gladus/context.hpp"
+#include <exception>
 #include <stdexcept>
 #include <string>
+#include <cstring>
 #define GLADUS_HAS_ERROR
 
+#ifndef GLADUS_DEFERRED_ERROR_SITES
+#	define GLADUS_DEFERRED_ERROR_SITES 64
+#endif
+
 namespace gladus {
 
 struct error : public std::exception {};
@@ -32,16 +39,20 @@ struct runtime_error : public error
 {
 	std::string message;
 	opengl_error underlying_gl_error;
+	/// Source location, inside the wrapper, of the call the error was
+	/// attributed to. Only set for errors detected at a deferred checkpoint.
+	const char* file;
+	int line;
 
-	runtime_error(): message("") {}
-	runtime_error(const char* msg): message(msg) {}
-	runtime_error(const char* msg, const opengl_error& err): message(msg), underlying_gl_error(err) {}
-	runtime_error(const char* msg, const runtime_error& err): message(msg), underlying_gl_error(err.underlying_gl_error) { message += "; after " + err.message; }
+	runtime_error(): message(""), file(NULL), line(0) {}
+	runtime_error(const char* msg): message(msg), file(NULL), line(0) {}
+	runtime_error(const char* msg, const opengl_error& err): message(msg), underlying_gl_error(err), file(NULL), line(0) {}
+	runtime_error(const char* msg, const runtime_error& err): message(msg), underlying_gl_error(err.underlying_gl_error), file(err.file), line(err.line) { message += "; after " + err.message; }
 	virtual ~runtime_error() throw() {}
 
 	virtual const char* what() const throw()
 	{
-		std::string composed = "gladus: ";
+		composed = "gladus: ";
 		composed += (message.empty() ? "unknown error" : message);
 		if (underlying_gl_error.ec != GL_NO_ERROR) {
 			composed += " (";
@@ -50,15 +61,223 @@ struct runtime_error : public error
 		}
 		return composed.c_str();
 	}
+
+private:
+	mutable std::string composed;
+};
+
+/// Translates an OpenGL error raised by one particular call into an exception.
+/// Wrappers hand one of these to on_opengl_error() after every call that may
+/// fail, which allows the translation to happen right away or, in the
+/// deferred mode, at a later checkpoint.
+typedef void (*opengl_error_handler)(const opengl_error& err);
+
+inline void throw_opengl_error(const opengl_error& err) { throw err; }
+
+/// Per-thread bookkeeping of the deferred and debug output error checking
+/// modes. The deferred mode records the call sites passed to
+/// on_opengl_error() since the last checkpoint, up to
+/// GLADUS_DEFERRED_ERROR_SITES of them; further sites are only counted. The
+/// debug output mode notes errors reported through the debug message
+/// callback.
+struct opengl_error_log
+{
+	struct site
+	{
+		opengl_error_handler handler;
+		const char* file;
+		int line;
+	};
+
+	site sites[GLADUS_DEFERRED_ERROR_SITES];
+	unsigned long num_sites;
+	unsigned long num_dropped;
+	bool debug_output;
+	bool pending;
+	char message[256];
+
+	opengl_error_log(): num_sites(0), num_dropped(0), debug_output(false), pending(false) { message[0] = 0; }
+
+	static opengl_error_log& current() { static thread_local opengl_error_log log; return log; }
+
+	void record(opengl_error_handler handler, const char* file, int line)
+	{
+		if (num_sites == GLADUS_DEFERRED_ERROR_SITES) {
+			num_dropped++;
+			return;
+		}
+		site& s = sites[num_sites++];
+		s.handler = handler;
+		s.file = file;
+		s.line = line;
+	}
+
+	/// Forgets the sites recorded since the last checkpoint.
+	void clear()
+	{
+		num_sites = 0;
+		num_dropped = 0;
+	}
+
+	/// Attributes an error to the earliest recorded site whose handler
+	/// knows the error code and throws the exception that site would have
+	/// thrown had it checked for errors immediately. OpenGL keeps the first
+	/// error raised, but a handler knowing the code does not mean its call
+	/// raised it, so any later site whose handler knows the code is listed
+	/// in the exception's message as well, as is the number of sites that
+	/// were not recorded. Place checkpoints closer together to narrow the
+	/// candidates down.
+	void attribute(const opengl_error& err)
+	{
+		unsigned long count = num_sites, dropped = num_dropped;
+		clear();
+		runtime_error blamed;
+		bool found = false;
+		std::string others;
+		for (unsigned long i = 0; i < count; i++) {
+			const site& s = sites[i];
+			try {
+				s.handler(err);
+			} catch (runtime_error& e) {
+				if (!found) {
+					blamed = e;
+					blamed.file = s.file;
+					blamed.line = s.line;
+					found = true;
+				} else if (!seen(s, i)) {
+					others += others.empty() ? "; may also have been raised at " : ", ";
+					others += std::string(s.file) + ':' + std::to_string(s.line);
+				}
+			} catch (opengl_error&) {
+			}
+		}
+		if (!found && dropped > 0)
+			throw runtime_error(("deferred error check: raised by one of " + std::to_string(dropped) + " call sites that were not recorded").c_str(), err);
+		if (!found) throw err;
+		blamed.message += others;
+		if (dropped > 0)
+			blamed.message += "; " + std::to_string(dropped) + " later call sites were not recorded";
+		throw blamed;
+	}
+
+private:
+	/// Whether a site recorded before the given one has the same location.
+	bool seen(const site& s, unsigned long end) const
+	{
+		for (unsigned long i = 0; i < end; i++) {
+			const site& o = sites[i];
+			if (o.line == s.line && std::strcmp(o.file, s.file) == 0) return true;
+		}
+		return false;
+	}
 };
 
-#ifdef GLADUS_DONT_CHECK_GL_ERRORS
+#ifdef GL_VERSION_4_3
+inline void GLAPIENTRY opengl_debug_message(GLenum, GLenum type, GLuint, GLenum, GLsizei, const GLchar* msg, const void* user)
+{
+	if (type != GL_DEBUG_TYPE_ERROR) return;
+	opengl_error_log* log = (opengl_error_log*)user;
+	log->pending = true;
+	std::strncpy(log->message, msg, sizeof(log->message)-1);
+	log->message[sizeof(log->message)-1] = 0;
+}
+
+/// Installs a debug message callback on the current context that notes
+/// errors as they are raised, such that the debug output mode can attribute
+/// errors to wrapper calls without polling glGetError. Requires OpenGL 4.3
+/// or KHR_debug; returns false if neither is supported, in which case errors
+/// keep being polled.
+inline bool enable_debug_output()
+{
+	const extensions& e = context::current().features();
+	if (!e.version(4,3) && !e.has("GL_KHR_debug"))
+		return false;
+	opengl_error_log& log = opengl_error_log::current();
+	capability_cache& caps = context::current().capabilities;
+	caps.set(GL_DEBUG_OUTPUT, true);
+	caps.set(GL_DEBUG_OUTPUT_SYNCHRONOUS, true);
+	glDebugMessageCallback(opengl_debug_message, &log);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, NULL, GL_TRUE);
+	log.debug_output = true;
+	log.pending = false;
+	return true;
+}
+
+inline void disable_debug_output()
+{
+	glDebugMessageCallback(NULL, NULL);
+	opengl_error_log::current().debug_output = false;
+}
+#endif
+
+// Error checking comes in four flavours, selected by defining one of the
+// following before including gladus:
+//
+// - nothing: glGetError() is called after every wrapped call.
+// - GLADUS_DONT_CHECK_GL_ERRORS: errors are not checked at all.
+// - GLADUS_DEFER_GL_ERRORS: wrapped calls only record their call site;
+//   glGetError() is called at explicit checkpoints, see check_opengl_errors().
+//   The recorded site is where the wrapper checks for errors, i.e. a line in
+//   a gladus header rather than in the calling code.
+// - GLADUS_DEBUG_OUTPUT_GL_ERRORS: once enable_debug_output() succeeded,
+//   errors are reported by the driver through a debug message callback and
+//   glGetError() is only called if the callback fired.
+//
+// In every mode other than the first one, the if_opengl_error() and
+// incase_opengl_error() macros for user code can only see errors already
+// known to gladus.
+#if defined(GLADUS_DONT_CHECK_GL_ERRORS)
 #	define clear_opengl_error()
 #	define check_opengl_error(err) false
 #	define throw_on_opengl_error()
+#	define on_opengl_error(handler)
+#	define if_opengl_error(err) opengl_error err; if (false)
+#	define incase_opengl_error(err) opengl_error err; if (false) switch(GL_NO_ERROR)
+inline void check_opengl_errors() {}
+#elif defined(GLADUS_DEFER_GL_ERRORS)
+#	define clear_opengl_error()
+#	define check_opengl_error(err) false
+#	define throw_on_opengl_error() gladus::opengl_error_log::current().record(gladus::throw_opengl_error, __FILE__, __LINE__)
+#	define on_opengl_error(handler) gladus::opengl_error_log::current().record(handler, __FILE__, __LINE__)
 #	define if_opengl_error(err) opengl_error err; if (false)
 #	define incase_opengl_error(err) opengl_error err; if (false) switch(GL_NO_ERROR)
+
+/// Checkpoint of the deferred mode. Polls OpenGL for errors raised since the
+/// last checkpoint and throws the exception of the call site the error is
+/// attributed to, with the site's location stored in the exception.
+inline void check_opengl_errors()
+{
+	opengl_error_log& log = opengl_error_log::current();
+	GLenum e = glGetError();
+	if (e == GL_NO_ERROR) {
+		log.clear();
+		return;
+	}
+	while (glGetError() != GL_NO_ERROR);
+	log.attribute(opengl_error(e));
+}
 #else
+#	if defined(GLADUS_DEBUG_OUTPUT_GL_ERRORS)
+inline void clear_opengl_error()
+{
+	opengl_error_log& log = opengl_error_log::current();
+	if (!log.debug_output || log.pending) glGetError();
+	log.pending = false;
+}
+
+inline bool check_opengl_error(opengl_error& err)
+{
+	opengl_error_log& log = opengl_error_log::current();
+	if (log.debug_output && !log.pending) return false;
+	log.pending = false;
+	GLenum e = glGetError();
+	if (e != GL_NO_ERROR) {
+		err = opengl_error(e);
+		return true;
+	}
+	return false;
+}
+#	else
 inline void clear_opengl_error() { glGetError(); }
 
 inline bool check_opengl_error(opengl_error& err)
@@ -70,6 +289,7 @@ inline bool check_opengl_error(opengl_error& err)
 	}
 	return false;
 }
+#	endif
 
 inline void throw_on_opengl_error()
 {
@@ -78,8 +298,43 @@ inline void throw_on_opengl_error()
 		throw err;
 }
 
+inline void handle_opengl_error(opengl_error_handler handler)
+{
+	opengl_error err;
+	if (check_opengl_error(err))
+		handler(err);
+}
+
+/// Checkpoint that throws if an error is pending. Wrapped calls check for
+/// errors themselves in this mode, so this only catches errors raised by raw
+/// OpenGL calls.
+inline void check_opengl_errors() { throw_on_opengl_error(); }
+
+#define on_opengl_error(handler) handle_opengl_error(handler)
 #define if_opengl_error(err) opengl_error err; if (check_opengl_error(err))
 #define incase_opengl_error(err) opengl_error err; if (check_opengl_error(err)) switch (err.ec)
 #endif
 
+/// Calls check_opengl_errors() when going out of scope, e.g. at the end of a
+/// frame or of a batch of uploads. Does not check if the scope is left due to
+/// another exception.
+struct scoped_error_check
+{
+	scoped_error_check(): exceptions(uncaught()) {}
+	~scoped_error_check() noexcept(false)
+	{
+		if (uncaught() == exceptions)
+			check_opengl_errors();
+	}
+
+private:
+	int exceptions;
+
+	#if __cplusplus >= 201703L
+	static int uncaught() { return std::uncaught_exceptions(); }
+	#else
+	static int uncaught() { return std::uncaught_exception() ? 1 : 0; }
+	#endif
+};
+
 } // namespace gladus
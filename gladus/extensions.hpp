@@ -0,0 +1,70 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#define GLADUS_HAS_EXTENSIONS
+
+namespace gladus {
+
+/// The OpenGL version and the extensions supported by a context. detect()
+/// has to be called while the context is current; it queries everything once
+/// so that later checks do not talk to OpenGL anymore.
+struct extensions
+{
+	GLint major;
+	GLint minor;
+	std::vector<std::string> names;
+
+	extensions(): major(0), minor(0) {}
+
+	void detect()
+	{
+		const char* version = (const char*)glGetString(GL_VERSION);
+		if (!version) return;
+		major = std::atoi(version);
+		const char* dot = std::strchr(version, '.');
+		minor = dot ? std::atoi(dot+1) : 0;
+
+		names.clear();
+		#ifdef GL_VERSION_3_0
+		if (major >= 3) {
+			GLint n = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+			for (GLint i = 0; i < n; i++)
+				names.push_back((const char*)glGetStringi(GL_EXTENSIONS, i));
+		} else
+		#endif
+		{
+			const char* all = (const char*)glGetString(GL_EXTENSIONS);
+			while (all && *all) {
+				const char* end = std::strchr(all, ' ');
+				if (!end) end = all + std::strlen(all);
+				if (end > all) names.push_back(std::string(all, end));
+				all = *end ? end+1 : end;
+			}
+		}
+		std::sort(names.begin(), names.end());
+	}
+
+	/// Whether the context implements at least the given OpenGL version.
+	bool version(GLint req_major, GLint req_minor) const
+	{
+		return major > req_major || (major == req_major && minor >= req_minor);
+	}
+
+	/// Whether the context advertises the given extension, e.g.
+	/// "GL_ARB_buffer_storage".
+	bool has(const char* name) const
+	{
+		return std::binary_search(names.begin(), names.end(), std::string(name));
+	}
+};
+
+} // namespace gladus
+
+namespace gl {
+	typedef gladus::extensions Extensions;
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#define GLADUS_HAS_FENCE
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+/// A sync object in the OpenGL command stream. The fence becomes signaled
+/// once the GPU has completed all commands issued before it was inserted. An
+/// empty fence, i.e. one that was never inserted, counts as signaled.
+struct fence
+{
+	GLsync sync;
+
+	fence(): sync(NULL) {}
+	fence(fence&& other): sync(other.sync) { other.sync = NULL; }
+	~fence() { reset(); }
+
+	fence& operator=(fence&& other)
+	{
+		GLsync s = other.sync;
+		other.sync = NULL;
+		reset();
+		sync = s;
+		return *this;
+	}
+
+	fence(const fence&) = delete;
+	fence& operator=(const fence&) = delete;
+
+	/// Inserts the fence after all commands issued so far. A fence inserted
+	/// earlier is released.
+	void insert()
+	{
+		reset();
+		clear_opengl_error();
+		sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		if (!sync)
+			on_opengl_error(throw_on_insert_error);
+	}
+
+	void reset()
+	{
+		if (sync) glDeleteSync(sync);
+		sync = NULL;
+	}
+
+	/// Whether the GPU has passed the fence. Never blocks.
+	bool signaled() const
+	{
+		if (!sync) return true;
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv(sync, GL_SYNC_STATUS, 1, NULL, &status);
+		return status == GL_SIGNALED;
+	}
+
+	/// Blocks until the GPU has passed the fence, flushing the command stream
+	/// if necessary. Returns whether the call actually had to wait.
+	bool wait() const
+	{
+		if (!sync) return false;
+		GLenum result = glClientWaitSync(sync, 0, 0);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			return false;
+		while (result != GL_WAIT_FAILED) {
+			result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+				return true;
+		}
+		throw runtime_error("fence: failed to wait: 'sync' is not a sync object");
+	}
+
+	/// Blocks for at most timeout nanoseconds, flushing the command stream
+	/// if necessary. Returns whether the GPU has passed the fence.
+	bool wait_for(GLuint64 timeout) const
+	{
+		if (!sync) return true;
+		switch (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout)) {
+			case GL_ALREADY_SIGNALED:
+			case GL_CONDITION_SATISFIED: return true;
+			case GL_TIMEOUT_EXPIRED: return false;
+			default: throw runtime_error("fence: failed to wait: 'sync' is not a sync object");
+		}
+	}
+
+	/// Makes the GPU wait for the fence before executing commands issued
+	/// afterwards, without blocking the calling thread. Useful when the fence
+	/// was inserted on another context sharing objects with this one.
+	void server_wait() const
+	{
+		if (!sync) return;
+		clear_opengl_error();
+		glWaitSync(sync, 0, GL_TIMEOUT_IGNORED);
+		on_opengl_error(throw_on_server_wait_error);
+	}
+
+	static void throw_on_insert_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_OUT_OF_MEMORY: throw runtime_error("fence: failed to insert: out of memory", err);
+			default: throw runtime_error("fence: failed to insert: glFenceSync returned no sync object", err);
+		}
+	}
+	static void throw_on_server_wait_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("fence: failed to wait on the server: 'sync' is not a sync object", err);
+			default: throw err;
+		}
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_2
+	typedef gladus::fence Fence;
+	#endif
+}
@@ -0,0 +1,111 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/fence.hpp"
+#include <cassert>
+#include <chrono>
+#include <vector>
+#define GLADUS_HAS_FRAME_PACER
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+struct frame_pacer_statistics
+{
+	unsigned long frames;
+	/// Number of frames whose begin_frame() had to wait for the GPU, and the
+	/// time spent waiting.
+	unsigned long stalls;
+	double stall_seconds;
+
+	frame_pacer_statistics(): frames(0), stalls(0), stall_seconds(0) {}
+};
+
+/// Limits how many frames the CPU may queue ahead of the GPU. Each frame
+/// occupies one of N slots in turn, and a fence placed at the end of the
+/// frame tells when the GPU is done with it. begin_frame() waits until the
+/// GPU has finished the frame that last used the slot, after which resources
+/// kept once per slot, such as a region of a buffer or staging memory, can be
+/// written without synchronizing any further:
+///
+///     frame_pacer pacer(3);
+///     buffer uniforms[3];
+///     for (;;) {
+///         size_t slot = pacer.begin_frame();
+///         uniforms[slot].subdata(...);
+///         draw();
+///         pacer.end_frame();
+///     }
+struct frame_pacer
+{
+	frame_pacer_statistics stats;
+
+	explicit frame_pacer(size_t frames_in_flight = 2): fences(frames_in_flight), current(0), in_frame(false)
+	{
+		assert(frames_in_flight > 0);
+	}
+
+	frame_pacer(const frame_pacer&) = delete;
+	frame_pacer& operator=(const frame_pacer&) = delete;
+
+	/// Waits until the slot of the next frame is no longer in use by the GPU
+	/// and returns it.
+	size_t begin_frame()
+	{
+		assert(!in_frame && "frame already begun");
+		fence& f = fences[slot()];
+		if (!f.signaled()) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			f.wait();
+			stats.stalls++;
+			stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		f.reset();
+		in_frame = true;
+		return slot();
+	}
+
+	/// Fences the commands issued for the current frame and advances to the
+	/// next slot.
+	void end_frame()
+	{
+		assert(in_frame && "frame not begun");
+		fences[slot()].insert();
+		in_frame = false;
+		current++;
+		stats.frames++;
+	}
+
+	/// Whether the GPU is done with the frame that last used the given slot.
+	/// Never blocks.
+	bool available(size_t s) const { return fences[s].signaled(); }
+
+	/// Blocks until the GPU has finished all frames.
+	void drain()
+	{
+		for (size_t i = 0; i < fences.size(); i++) {
+			fences[i].wait();
+			fences[i].reset();
+		}
+	}
+
+	/// The slot of the current frame, or of the next one outside a frame.
+	size_t slot() const { return current % fences.size(); }
+	size_t frames_in_flight() const { return fences.size(); }
+	/// Number of frames ended so far.
+	unsigned long long frame() const { return current; }
+
+private:
+	std::vector<fence> fences;
+	unsigned long long current;
+	bool in_frame;
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_2
+	typedef gladus::frame_pacer FramePacer;
+	#endif
+}
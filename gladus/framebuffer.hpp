@@ -2,6 +2,10 @@
 #pragma once
 #include "gladus/error.hpp"
 #include "gladus/binding.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/fence.hpp"
+#include "gladus/pixel_format.hpp"
+#include <deque>
 #define GLADUS_HAS_FRAMEBUFFER
 
 namespace gladus {
@@ -17,61 +21,178 @@ struct framebuffer_validation_result
 	operator bool() const { return status == GL_FRAMEBUFFER_COMPLETE; }
 };
 
+#ifdef GL_VERSION_3_2
+/// Pixels read from a framebuffer into a pixel pack buffer, as handed out by
+/// framebuffer::read_pixels_async(). The read completes on the GPU in the
+/// background; ready() tells whether it has, and pixels() maps the buffer and
+/// returns the rows, bottom one first and tightly packed, without copying.
+struct pixel_readback
+{
+	gladus::buffer storage;
+	fence done;
+	GLsizei width, height;
+	GLenum format, type;
+	/// Bytes of pixel data, and bytes the buffer can hold.
+	GLsizeiptr size, capacity;
+
+	pixel_readback(): storage(GL_PIXEL_PACK_BUFFER), width(0), height(0), format(0), type(0), size(0), capacity(0) {}
+
+	/// Whether the pixels have arrived. Never blocks.
+	bool ready() const { return done.signaled(); }
+
+	/// Maps the pixels, waiting for them to arrive if necessary. The pointer
+	/// stays valid until release() or until the ring reuses the readback.
+	const void* pixels()
+	{
+		if (!storage.mapped_data) {
+			done.wait();
+			storage.map_range(0, size, GL_MAP_READ_BIT);
+		}
+		return storage.mapped_data;
+	}
+
+	void release()
+	{
+		if (storage.mapped_data) storage.unmap();
+	}
+};
+
+/// A fixed number of pixel_readback slots used in turn. With n slots, a
+/// readback stays valid until n-1 further reads have been issued, such that
+/// with the default of three the pixels of frame N-2 can be consumed while
+/// frame N is being rendered and read.
+struct readback_ring
+{
+	explicit readback_ring(size_t count = 3): head(0)
+	{
+		assert(count > 0);
+		for (size_t i = 0; i < count; i++) slots.emplace_back();
+	}
+
+	readback_ring(const readback_ring&) = delete;
+	readback_ring& operator=(const readback_ring&) = delete;
+
+	/// Releases the next slot and grows its buffer to hold at least size
+	/// bytes.
+	pixel_readback& next(GLsizeiptr size)
+	{
+		pixel_readback& r = slots[head];
+		head = (head + 1) % slots.size();
+		r.release();
+		if (r.capacity < size) {
+			r.storage.data(size, NULL, GL_STREAM_READ);
+			r.capacity = size;
+		}
+		r.size = size;
+		return r;
+	}
+
+	size_t size() const { return slots.size(); }
+
+private:
+	std::deque<pixel_readback> slots;
+	size_t head;
+};
+#endif
+
 struct framebuffer
 {
 	GLuint id;
 	GLenum target;
 
-	framebuffer(): target(0) { glGenFramebuffers(1, &id); throw_on_opengl_error(); }
-	framebuffer(GLenum target): target(target) { glGenFramebuffers(1, &id); throw_on_opengl_error(); }
+	framebuffer(): target(0) { generate(); throw_on_opengl_error(); }
+	framebuffer(GLenum target): target(target) { generate(); throw_on_opengl_error(); }
 	framebuffer(GLenum target, GLuint id): target(target), id(id) { assert(glIsFramebuffer(id)); }
-	~framebuffer() { if (id > 0) glDeleteFramebuffers(1, &id); throw_on_opengl_error(); }
+	framebuffer(framebuffer&& other) noexcept: id(other.id), target(other.target) { other.id = 0; }
+	~framebuffer() { if (id > 0) { glDeleteFramebuffers(1, &id); context::current().bindings.forget_framebuffer(id); throw_on_opengl_error(); } }
+
+	/// Deletes the framebuffer's name and takes over the other framebuffer's.
+	framebuffer& operator=(framebuffer&& other) noexcept
+	{
+		if (this == &other) return *this;
+		if (id > 0) { glDeleteFramebuffers(1, &id); context::current().bindings.forget_framebuffer(id); }
+		id = other.id; target = other.target;
+		other.id = 0;
+		return *this;
+	}
+
+	framebuffer(const framebuffer&) = delete;
+	framebuffer& operator=(const framebuffer&) = delete;
 
 	operator GLuint() const { return id; }
 
 	void bind() const
 	{
 		assert(id > 0);
-		clear_opengl_error();
-		glBindFramebuffer(target, id);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("framebuffer: failed to bind: 'target' is not one of the allowed values", err);
-			case GL_INVALID_OPERATION: throw runtime_error("framebuffer: failed to bind: 'id' is neither 0 nor a previously allocated framebuffer name", err);
-			default: throw err;
-		}
+		bind_name(id);
 	}
 
-	void unbind() const
-	{
-		clear_opengl_error();
-		glBindFramebuffer(target, 0);
-		throw_on_opengl_error();
-	}
+	void unbind() const { bind_name(0); }
+
+	GLuint current_binding() const { return context::current().bindings.framebuffer(target); }
+	void restore_binding(GLuint name) const { bind_name(name); }
 
+	// With direct state access the texture target is implied by the texture
+	// object, except for cube map faces which are attached as layers.
+	#ifdef GL_VERSION_4_5
+	#define direct_attach(call) if (context::current().direct_state_access()) { clear_opengl_error(); call; on_opengl_error(throw_on_attach_error); return; }
+	#define direct_layer(texture_target) (texture_target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && texture_target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z ? GLint(texture_target - GL_TEXTURE_CUBE_MAP_POSITIVE_X) : -1)
+	#else
+	#define direct_attach(call)
+	#endif
 	#ifdef GL_VERSION_3_2
-	void attach(GLenum attachment, GLuint texture_id, GLint level) { scoped_bind<framebuffer> bound(*this); glFramebufferTexture(target, attachment, texture_id, level); throw_on_texture_opengl_error(); }
+	void attach(GLenum attachment, GLuint texture_id, GLint level) { direct_attach(glNamedFramebufferTexture(id, attachment, texture_id, level)); scoped_bind<framebuffer> bound(*this); clear_opengl_error(); glFramebufferTexture(target, attachment, texture_id, level); on_opengl_error(throw_on_attach_error); }
 	#endif
-	void attach1d(GLenum attachment, GLenum texture_target, GLuint texture_id, GLint level) { scoped_bind<framebuffer> bound(*this); glFramebufferTexture1D(target, attachment, texture_target, texture_id, level); throw_on_texture_opengl_error(); }
-	void attach2d(GLenum attachment, GLenum texture_target, GLuint texture_id, GLint level) { scoped_bind<framebuffer> bound(*this); glFramebufferTexture2D(target, attachment, texture_target, texture_id, level); throw_on_texture_opengl_error(); }
-	void attach3d(GLenum attachment, GLenum texture_target, GLuint texture_id, GLint level, GLint layer) { scoped_bind<framebuffer> bound(*this); glFramebufferTexture3D(target, attachment, texture_target, texture_id, level, layer); throw_on_texture_opengl_error(); }
+	void attach1d(GLenum attachment, GLenum texture_target, GLuint texture_id, GLint level) { direct_attach(glNamedFramebufferTexture(id, attachment, texture_id, level)); scoped_bind<framebuffer> bound(*this); clear_opengl_error(); glFramebufferTexture1D(target, attachment, texture_target, texture_id, level); on_opengl_error(throw_on_attach_error); }
+	void attach2d(GLenum attachment, GLenum texture_target, GLuint texture_id, GLint level) { direct_attach(if (direct_layer(texture_target) >= 0) glNamedFramebufferTextureLayer(id, attachment, texture_id, level, direct_layer(texture_target)); else glNamedFramebufferTexture(id, attachment, texture_id, level)); scoped_bind<framebuffer> bound(*this); clear_opengl_error(); glFramebufferTexture2D(target, attachment, texture_target, texture_id, level); on_opengl_error(throw_on_attach_error); }
+	void attach3d(GLenum attachment, GLenum texture_target, GLuint texture_id, GLint level, GLint layer) { direct_attach(glNamedFramebufferTextureLayer(id, attachment, texture_id, level, layer)); scoped_bind<framebuffer> bound(*this); clear_opengl_error(); glFramebufferTexture3D(target, attachment, texture_target, texture_id, level, layer); on_opengl_error(throw_on_attach_error); }
+	#undef direct_attach
+	#undef direct_layer
 
 	#ifdef GLADUS_HAS_TEXTURE
 	#ifdef GL_VERSION_3_2
-	void attach(GLenum attachment, const texture& tex, GLint level) { attach(attachment, tex, level); }
+	void attach(GLenum attachment, const texture& tex, GLint level) { attach(attachment, tex.id, level); }
 	#endif
 	void attach1d(GLenum attachment, const texture& tex, GLint level) { attach1d(attachment, tex.target, tex, level); }
 	void attach2d(GLenum attachment, const texture& tex, GLint level) { attach2d(attachment, tex.target, tex, level); }
 	void attach3d(GLenum attachment, const texture& tex, GLint level, GLint layer) { attach3d(attachment, tex.target, tex, level, layer); }
 	#endif
 
+	#ifdef GL_VERSION_3_2
+	/// Starts reading a rectangle of the framebuffer's read buffer into the
+	/// next slot of the ring, without waiting for the GPU. The framebuffer
+	/// has to be readable, i.e. its target may not be GL_DRAW_FRAMEBUFFER.
+	/// Sets GL_PACK_ALIGNMENT to 1.
+	pixel_readback& read_pixels_async(readback_ring& ring, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		if (target == GL_DRAW_FRAMEBUFFER)
+			throw runtime_error("framebuffer: failed to read pixels: 'target' is GL_DRAW_FRAMEBUFFER");
+		GLsizeiptr size = GLsizeiptr(width) * height * pixel_size(format, type);
+		if (size <= 0)
+			throw runtime_error("framebuffer: failed to read pixels: empty rectangle, or 'format' and 'type' are not supported");
+		pixel_readback& r = ring.next(size);
+		r.width = width;
+		r.height = height;
+		r.format = format;
+		r.type = type;
+		scoped_bind<framebuffer> bound_framebuffer(*this);
+		scoped_bind<buffer> bound_buffer(r.storage);
+		clear_opengl_error();
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(x, y, width, height, format, type, NULL);
+		on_opengl_error(throw_on_read_error);
+		r.done.insert();
+		return r;
+	}
+
+	/// Size in bytes of one pixel of the given format and type, or 0 if the
+	/// combination is not known.
+	static GLsizei pixel_size(GLenum format, GLenum type) { return gladus::pixel_size(format, type); }
+	#endif
+
 	framebuffer_validation_result validate()
 	{
-		scoped_bind<framebuffer> bound(*this);
-		GLint status = glCheckFramebufferStatus(target);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("framebuffer: failed to validate: 'target' is not one of the allowed values", err);
-			default: throw err;
-		}
+		GLint status = check_status();
 
 		if (status != GL_FRAMEBUFFER_COMPLETE) {
 			const char* message;
@@ -93,19 +214,94 @@ struct framebuffer
 		return framebuffer_validation_result(status);
 	}
 
-	inline void throw_on_texture_opengl_error()
+	inline void throw_on_texture_opengl_error() { on_opengl_error(throw_on_attach_error); }
+
+	static void throw_on_bind_error(const opengl_error& err)
 	{
-		incase_opengl_error(err) {
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("framebuffer: failed to bind: 'target' is not one of the allowed values", err);
+			case GL_INVALID_OPERATION: throw runtime_error("framebuffer: failed to bind: 'id' is neither 0 nor a previously allocated framebuffer name", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_attach_error(const opengl_error& err)
+	{
+		switch (err.ec) {
 			case GL_INVALID_ENUM: throw runtime_error("framebuffer: failed to attach texture: 'id' is not a previously allocated framebuffer name, or 'attachment' is not one of the allowed attachment points, or 'texture_target' is not one of the allowed values", err);
 			case GL_INVALID_VALUE: throw runtime_error("framebuffer: failed to attach texture: 'level' is not 0 and 'texture_id' is not 0", err);
 			case GL_INVALID_OPERATION: throw runtime_error("framebuffer: failed to attach texture: default framebuffer is bound, or texture 'texture_id' and 'texture_target' are not compatible", err);
 			default: throw err;
 		}
 	}
+	static void throw_on_read_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("framebuffer: failed to read pixels: 'format' or 'type' is not one of the allowed values", err);
+			case GL_INVALID_VALUE: throw runtime_error("framebuffer: failed to read pixels: 'width' or 'height' is negative", err);
+			case GL_INVALID_OPERATION: throw runtime_error("framebuffer: failed to read pixels: 'format' and 'type' do not match the read buffer, or the read buffer is GL_NONE", err);
+			case GL_INVALID_FRAMEBUFFER_OPERATION: throw runtime_error("framebuffer: failed to read pixels: framebuffer is not complete", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_validate_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("framebuffer: failed to validate: 'target' is not one of the allowed values", err);
+			default: throw err;
+		}
+	}
+
+private:
+	/// Allocates the framebuffer's name. Contexts supporting direct state
+	/// access create the framebuffer object right away, since DSA calls reject
+	/// names that have never been bound.
+	void generate()
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().supports_direct_state_access()) {
+			glCreateFramebuffers(1, &id);
+			return;
+		}
+		#endif
+		glGenFramebuffers(1, &id);
+	}
+
+	GLint check_status()
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			GLint status = glCheckNamedFramebufferStatus(id, target);
+			on_opengl_error(throw_on_validate_error);
+			return status;
+		}
+		#endif
+		scoped_bind<framebuffer> bound(*this);
+		clear_opengl_error();
+		GLint status = glCheckFramebufferStatus(target);
+		on_opengl_error(throw_on_validate_error);
+		return status;
+	}
+
+	/// Binds a name to the framebuffer's target, unless the binding cache
+	/// knows it is bound already.
+	void bind_name(GLuint name) const
+	{
+		binding_cache& cache = context::current().bindings;
+		if (cache.framebuffer_bound(target, name)) return;
+		clear_opengl_error();
+		glBindFramebuffer(target, name);
+		on_opengl_error(throw_on_bind_error);
+		cache.bind_framebuffer(target, name);
+	}
 };
 
 } // namespace gladus
 
 namespace gl {
 	typedef gladus::framebuffer Framebuffer;
+	#ifdef GL_VERSION_3_2
+	typedef gladus::pixel_readback PixelReadback;
+	typedef gladus::readback_ring ReadbackRing;
+	#endif
 }
@@ -0,0 +1,265 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+// The OpenGL functions gladus calls, as a list of gladus_gl_call(name)
+// entries grouped by the OpenGL version that introduced them. Included by
+// instrument.hpp to shadow the functions and by tools that need to refer to
+// every one of them, e.g. to replay traces; the includer defines
+// gladus_gl_call before including this file. Functions only used by new code
+// have to be added here.
+
+gladus_gl_call(glBindTexture)
+gladus_gl_call(glColorMask)
+gladus_gl_call(glCullFace)
+gladus_gl_call(glDeleteTextures)
+gladus_gl_call(glDepthFunc)
+gladus_gl_call(glDepthMask)
+gladus_gl_call(glDisable)
+gladus_gl_call(glDrawArrays)
+gladus_gl_call(glDrawElements)
+gladus_gl_call(glEnable)
+gladus_gl_call(glFrontFace)
+gladus_gl_call(glGenTextures)
+gladus_gl_call(glGetError)
+gladus_gl_call(glGetIntegerv)
+gladus_gl_call(glGetString)
+gladus_gl_call(glIsEnabled)
+gladus_gl_call(glPixelStorei)
+gladus_gl_call(glPolygonOffset)
+gladus_gl_call(glReadPixels)
+gladus_gl_call(glScissor)
+gladus_gl_call(glTexImage1D)
+gladus_gl_call(glTexImage2D)
+gladus_gl_call(glTexParameteri)
+gladus_gl_call(glTexSubImage1D)
+gladus_gl_call(glTexSubImage2D)
+gladus_gl_call(glViewport)
+
+#ifdef GL_VERSION_1_2
+gladus_gl_call(glTexImage3D)
+gladus_gl_call(glTexSubImage3D)
+#endif
+
+#ifdef GL_VERSION_1_3
+gladus_gl_call(glActiveTexture)
+gladus_gl_call(glCompressedTexSubImage1D)
+gladus_gl_call(glCompressedTexSubImage2D)
+gladus_gl_call(glCompressedTexSubImage3D)
+#endif
+
+#ifdef GL_VERSION_1_4
+gladus_gl_call(glBlendColor)
+gladus_gl_call(glBlendFuncSeparate)
+#endif
+
+#ifdef GL_VERSION_1_5
+gladus_gl_call(glBindBuffer)
+gladus_gl_call(glBufferData)
+gladus_gl_call(glBufferSubData)
+gladus_gl_call(glDeleteBuffers)
+gladus_gl_call(glDeleteQueries)
+gladus_gl_call(glGenBuffers)
+gladus_gl_call(glGenQueries)
+gladus_gl_call(glGetQueryObjectiv)
+gladus_gl_call(glMapBuffer)
+gladus_gl_call(glUnmapBuffer)
+#endif
+
+#ifdef GL_VERSION_2_0
+gladus_gl_call(glAttachShader)
+gladus_gl_call(glBlendEquationSeparate)
+gladus_gl_call(glCompileShader)
+gladus_gl_call(glCreateProgram)
+gladus_gl_call(glCreateShader)
+gladus_gl_call(glDeleteProgram)
+gladus_gl_call(glDeleteShader)
+gladus_gl_call(glDetachShader)
+gladus_gl_call(glEnableVertexAttribArray)
+gladus_gl_call(glGetActiveUniform)
+gladus_gl_call(glGetAttachedShaders)
+gladus_gl_call(glGetProgramInfoLog)
+gladus_gl_call(glGetProgramiv)
+gladus_gl_call(glGetShaderInfoLog)
+gladus_gl_call(glGetShaderiv)
+gladus_gl_call(glGetUniformLocation)
+gladus_gl_call(glIsProgram)
+gladus_gl_call(glLinkProgram)
+gladus_gl_call(glShaderSource)
+gladus_gl_call(glUniform1f)
+gladus_gl_call(glUniform2f)
+gladus_gl_call(glUniform3f)
+gladus_gl_call(glUniform4f)
+gladus_gl_call(glUniform1i)
+gladus_gl_call(glUniform2i)
+gladus_gl_call(glUniform3i)
+gladus_gl_call(glUniform4i)
+gladus_gl_call(glUniform1fv)
+gladus_gl_call(glUniform2fv)
+gladus_gl_call(glUniform3fv)
+gladus_gl_call(glUniform4fv)
+gladus_gl_call(glUniform1iv)
+gladus_gl_call(glUniform2iv)
+gladus_gl_call(glUniform3iv)
+gladus_gl_call(glUniform4iv)
+gladus_gl_call(glUniformMatrix2fv)
+gladus_gl_call(glUniformMatrix3fv)
+gladus_gl_call(glUniformMatrix4fv)
+gladus_gl_call(glUseProgram)
+gladus_gl_call(glValidateProgram)
+gladus_gl_call(glVertexAttribPointer)
+#endif
+
+#ifdef GL_VERSION_2_1
+gladus_gl_call(glUniformMatrix2x3fv)
+gladus_gl_call(glUniformMatrix3x2fv)
+gladus_gl_call(glUniformMatrix2x4fv)
+gladus_gl_call(glUniformMatrix4x2fv)
+gladus_gl_call(glUniformMatrix3x4fv)
+gladus_gl_call(glUniformMatrix4x3fv)
+#endif
+
+#ifdef GL_VERSION_3_0
+gladus_gl_call(glBindBufferBase)
+gladus_gl_call(glBindBufferRange)
+gladus_gl_call(glBindVertexArray)
+gladus_gl_call(glBindFramebuffer)
+gladus_gl_call(glCheckFramebufferStatus)
+gladus_gl_call(glDeleteFramebuffers)
+gladus_gl_call(glDeleteVertexArrays)
+gladus_gl_call(glFlushMappedBufferRange)
+gladus_gl_call(glFramebufferTexture1D)
+gladus_gl_call(glFramebufferTexture2D)
+gladus_gl_call(glFramebufferTexture3D)
+gladus_gl_call(glGenFramebuffers)
+gladus_gl_call(glGenVertexArrays)
+gladus_gl_call(glGenerateMipmap)
+gladus_gl_call(glGetStringi)
+gladus_gl_call(glIsFramebuffer)
+gladus_gl_call(glMapBufferRange)
+gladus_gl_call(glUniform1ui)
+gladus_gl_call(glUniform2ui)
+gladus_gl_call(glUniform3ui)
+gladus_gl_call(glUniform4ui)
+gladus_gl_call(glUniform1uiv)
+gladus_gl_call(glUniform2uiv)
+gladus_gl_call(glUniform3uiv)
+gladus_gl_call(glUniform4uiv)
+gladus_gl_call(glVertexAttribIPointer)
+#endif
+
+#ifdef GL_VERSION_3_1
+gladus_gl_call(glCopyBufferSubData)
+gladus_gl_call(glDrawArraysInstanced)
+gladus_gl_call(glDrawElementsInstanced)
+gladus_gl_call(glGetActiveUniformBlockiv)
+gladus_gl_call(glGetUniformBlockIndex)
+gladus_gl_call(glUniformBlockBinding)
+#endif
+
+#ifdef GL_VERSION_3_2
+gladus_gl_call(glClientWaitSync)
+gladus_gl_call(glDeleteSync)
+gladus_gl_call(glDrawElementsInstancedBaseVertex)
+gladus_gl_call(glFenceSync)
+gladus_gl_call(glFramebufferTexture)
+gladus_gl_call(glGetSynciv)
+gladus_gl_call(glWaitSync)
+#endif
+
+#ifdef GL_VERSION_3_3
+gladus_gl_call(glGetQueryObjectui64v)
+gladus_gl_call(glQueryCounter)
+gladus_gl_call(glVertexAttribDivisor)
+#endif
+
+#ifdef GL_VERSION_4_1
+gladus_gl_call(glGetProgramBinary)
+gladus_gl_call(glProgramBinary)
+gladus_gl_call(glProgramParameteri)
+gladus_gl_call(glProgramUniform1fv)
+gladus_gl_call(glProgramUniform2fv)
+gladus_gl_call(glProgramUniform3fv)
+gladus_gl_call(glProgramUniform4fv)
+gladus_gl_call(glProgramUniform1iv)
+gladus_gl_call(glProgramUniform2iv)
+gladus_gl_call(glProgramUniform3iv)
+gladus_gl_call(glProgramUniform4iv)
+gladus_gl_call(glProgramUniform1uiv)
+gladus_gl_call(glProgramUniform2uiv)
+gladus_gl_call(glProgramUniform3uiv)
+gladus_gl_call(glProgramUniform4uiv)
+gladus_gl_call(glProgramUniformMatrix2fv)
+gladus_gl_call(glProgramUniformMatrix3fv)
+gladus_gl_call(glProgramUniformMatrix4fv)
+gladus_gl_call(glProgramUniformMatrix2x3fv)
+gladus_gl_call(glProgramUniformMatrix2x4fv)
+gladus_gl_call(glProgramUniformMatrix3x2fv)
+gladus_gl_call(glProgramUniformMatrix3x4fv)
+gladus_gl_call(glProgramUniformMatrix4x2fv)
+gladus_gl_call(glProgramUniformMatrix4x3fv)
+gladus_gl_call(glVertexAttribLPointer)
+#endif
+
+#ifdef GL_VERSION_4_2
+gladus_gl_call(glDrawArraysInstancedBaseInstance)
+gladus_gl_call(glDrawElementsInstancedBaseVertexBaseInstance)
+gladus_gl_call(glTexStorage1D)
+gladus_gl_call(glTexStorage2D)
+gladus_gl_call(glTexStorage3D)
+#endif
+
+#ifdef GL_VERSION_4_3
+gladus_gl_call(glGetProgramResourceIndex)
+gladus_gl_call(glMultiDrawArraysIndirect)
+gladus_gl_call(glMultiDrawElementsIndirect)
+gladus_gl_call(glShaderStorageBlockBinding)
+gladus_gl_call(glVertexAttribBinding)
+gladus_gl_call(glVertexAttribFormat)
+gladus_gl_call(glVertexAttribIFormat)
+gladus_gl_call(glVertexAttribLFormat)
+gladus_gl_call(glVertexBindingDivisor)
+gladus_gl_call(glBindVertexBuffer)
+gladus_gl_call(glDebugMessageCallback)
+gladus_gl_call(glDebugMessageControl)
+gladus_gl_call(glPopDebugGroup)
+gladus_gl_call(glPushDebugGroup)
+#endif
+
+#ifdef GL_VERSION_4_4
+gladus_gl_call(glBufferStorage)
+#endif
+
+#ifdef GL_VERSION_4_5
+gladus_gl_call(glCheckNamedFramebufferStatus)
+gladus_gl_call(glCompressedTextureSubImage1D)
+gladus_gl_call(glCompressedTextureSubImage2D)
+gladus_gl_call(glCompressedTextureSubImage3D)
+gladus_gl_call(glCopyNamedBufferSubData)
+gladus_gl_call(glCreateBuffers)
+gladus_gl_call(glCreateFramebuffers)
+gladus_gl_call(glCreateTextures)
+gladus_gl_call(glCreateVertexArrays)
+gladus_gl_call(glEnableVertexArrayAttrib)
+gladus_gl_call(glFlushMappedNamedBufferRange)
+gladus_gl_call(glGenerateTextureMipmap)
+gladus_gl_call(glMapNamedBuffer)
+gladus_gl_call(glMapNamedBufferRange)
+gladus_gl_call(glNamedBufferData)
+gladus_gl_call(glNamedBufferStorage)
+gladus_gl_call(glNamedBufferSubData)
+gladus_gl_call(glNamedFramebufferTexture)
+gladus_gl_call(glNamedFramebufferTextureLayer)
+gladus_gl_call(glTextureParameteri)
+gladus_gl_call(glTextureStorage1D)
+gladus_gl_call(glTextureStorage2D)
+gladus_gl_call(glTextureStorage3D)
+gladus_gl_call(glTextureSubImage1D)
+gladus_gl_call(glTextureSubImage2D)
+gladus_gl_call(glTextureSubImage3D)
+gladus_gl_call(glUnmapNamedBuffer)
+gladus_gl_call(glVertexArrayAttribBinding)
+gladus_gl_call(glVertexArrayAttribFormat)
+gladus_gl_call(glVertexArrayAttribIFormat)
+gladus_gl_call(glVertexArrayAttribLFormat)
+gladus_gl_call(glVertexArrayBindingDivisor)
+gladus_gl_call(glVertexArrayElementBuffer)
+gladus_gl_call(glVertexArrayVertexBuffer)
+#endif
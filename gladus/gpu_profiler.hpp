@@ -0,0 +1,284 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <vector>
+#define GLADUS_HAS_GPU_PROFILER
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_3
+/// The measurements of one scope of one frame. Times are in nanoseconds;
+/// GPU times are relative to the GPU clock, CPU times relative to the
+/// creation of the profiler. calls is the number of OpenGL calls issued by
+/// the wrappers within the scope if GLADUS_COUNT_GL_CALLS is defined, and 0
+/// otherwise.
+struct gpu_timer_result
+{
+	const char* name;
+	unsigned depth;
+	unsigned long long frame;
+	GLuint64 gpu_begin, gpu_end;
+	long long cpu_begin, cpu_end;
+	unsigned long long calls;
+};
+
+struct gpu_profiler_statistics
+{
+	unsigned long scopes;
+	/// Frames whose queries were not available yet when their slot was
+	/// reused; their results are dropped rather than waited for.
+	unsigned long dropped_frames;
+
+	gpu_profiler_statistics(): scopes(0), dropped_frames(0) {}
+};
+
+/// Measures the GPU time spent in nested scopes with GL_TIMESTAMP queries,
+/// which unlike GL_TIME_ELAPSED queries may nest. Scopes are opened with
+/// scoped_gpu_timer between begin_frame() and end_frame(). The queries of a
+/// frame are read back when its slot comes around again, i.e. frames_in_flight
+/// frames later, such that reading never waits for the GPU. Each scope is
+/// also pushed as a debug group if the context supports KHR_debug, so it
+/// shows up in graphics debuggers.
+///
+/// Results accumulate until cleared. Scope names are not copied and have to
+/// outlive the profiler's results, e.g. be string literals.
+struct gpu_profiler
+{
+	std::vector<gpu_timer_result> results;
+	gpu_profiler_statistics stats;
+
+	explicit gpu_profiler(size_t frames_in_flight = 3): frames(frames_in_flight), current(0), depth(0), origin(std::chrono::steady_clock::now())
+	{
+		assert(frames_in_flight > 0);
+		const extensions& e = context::current().features();
+		timestamps = e.version(3,3) || e.has("GL_ARB_timer_query");
+		debug_groups = e.version(4,3) || e.has("GL_KHR_debug");
+	}
+	~gpu_profiler()
+	{
+		for (size_t i = 0; i < frames.size(); i++)
+			if (!frames[i].queries.empty()) glDeleteQueries(frames[i].queries.size(), &frames[i].queries[0]);
+	}
+
+	gpu_profiler(const gpu_profiler&) = delete;
+	gpu_profiler& operator=(const gpu_profiler&) = delete;
+
+	/// Collects the results of the frame that last used the next slot, if
+	/// the GPU has finished it, and starts recording a new frame.
+	void begin_frame()
+	{
+		frame_slot& f = frames[current % frames.size()];
+		collect(f);
+		f.records.clear();
+		f.used = 0;
+		f.last_query = 0;
+		f.frame = current;
+	}
+
+	void end_frame()
+	{
+		assert(depth == 0 && "scopes still open");
+		current++;
+	}
+
+	/// Opens a scope. Use scoped_gpu_timer rather than calling this
+	/// directly. Returns the index of the scope's record.
+	size_t push(const char* name)
+	{
+		frame_slot& f = frames[current % frames.size()];
+		record r;
+		r.name = name;
+		r.depth = depth++;
+		r.begin_query = r.end_query = 0;
+		r.closed = false;
+		if (timestamps) {
+			r.begin_query = f.next_query();
+			r.end_query = f.next_query();
+		}
+		#ifdef GL_VERSION_4_3
+		if (debug_groups) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+		#endif
+		if (timestamps) {
+			glQueryCounter(r.begin_query, GL_TIMESTAMP);
+			f.last_query = r.begin_query;
+		}
+		r.calls = calls();
+		r.cpu_begin = now();
+		f.records.push_back(r);
+		stats.scopes++;
+		return f.records.size() - 1;
+	}
+
+	void pop(size_t index)
+	{
+		frame_slot& f = frames[current % frames.size()];
+		record& r = f.records[index];
+		r.cpu_end = now();
+		r.calls = calls() - r.calls;
+		r.closed = true;
+		if (timestamps) {
+			glQueryCounter(r.end_query, GL_TIMESTAMP);
+			f.last_query = r.end_query;
+		}
+		#ifdef GL_VERSION_4_3
+		if (debug_groups) glPopDebugGroup();
+		#endif
+		depth--;
+	}
+
+	/// Writes the results collected so far in the Trace Event format read
+	/// by chrome://tracing and Perfetto. GPU scopes appear on thread 1, the
+	/// CPU time of the same scopes on thread 2. Timestamps are shifted such
+	/// that the first GPU scope starts at 0.
+	void write_chrome_trace(std::ostream& out) const
+	{
+		GLuint64 gpu_origin = 0;
+		for (size_t i = 0; i < results.size(); i++)
+			if (results[i].gpu_begin && (!gpu_origin || results[i].gpu_begin < gpu_origin)) gpu_origin = results[i].gpu_begin;
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		for (size_t i = 0; i < results.size(); i++) {
+			const gpu_timer_result& r = results[i];
+			if (r.gpu_begin) {
+				write_event(out, first, r, 1, (r.gpu_begin - gpu_origin) / 1000.0, (r.gpu_end - r.gpu_begin) / 1000.0);
+				first = false;
+			}
+			write_event(out, first, r, 2, r.cpu_begin / 1000.0, (r.cpu_end - r.cpu_begin) / 1000.0);
+			first = false;
+		}
+		out << "],\"displayTimeUnit\":\"ns\"}\n";
+	}
+
+private:
+	struct record
+	{
+		const char* name;
+		unsigned depth;
+		GLuint begin_query, end_query;
+		long long cpu_begin, cpu_end;
+		unsigned long long calls;
+		/// Whether pop() issued the end query.
+		bool closed;
+	};
+	struct frame_slot
+	{
+		std::vector<GLuint> queries;
+		size_t used;
+		/// The query issued last, which is not necessarily the one
+		/// allocated last, since outer scopes end after inner ones.
+		GLuint last_query;
+		std::vector<record> records;
+		unsigned long long frame;
+
+		frame_slot(): used(0), last_query(0), frame(0) {}
+
+		GLuint next_query()
+		{
+			if (used == queries.size()) {
+				GLuint q = 0;
+				glGenQueries(1, &q);
+				queries.push_back(q);
+			}
+			return queries[used++];
+		}
+	};
+
+	std::vector<frame_slot> frames;
+	unsigned long long current;
+	unsigned depth;
+	bool timestamps;
+	bool debug_groups;
+	std::chrono::steady_clock::time_point origin;
+
+	/// Queries complete in the order they were issued, so the results of a
+	/// frame are available once its last issued query is. Scopes that were
+	/// never popped are skipped, since their end query was never issued.
+	void collect(frame_slot& f)
+	{
+		if (f.records.empty()) return;
+		if (timestamps && f.last_query) {
+			GLint available = 0;
+			glGetQueryObjectiv(f.last_query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				// Reissuing the queries discards their pending results.
+				stats.dropped_frames++;
+				return;
+			}
+		}
+		for (size_t i = 0; i < f.records.size(); i++) {
+			const record& r = f.records[i];
+			if (!r.closed) continue;
+			gpu_timer_result out;
+			out.name = r.name;
+			out.depth = r.depth;
+			out.frame = f.frame;
+			out.gpu_begin = out.gpu_end = 0;
+			if (timestamps) {
+				glGetQueryObjectui64v(r.begin_query, GL_QUERY_RESULT, &out.gpu_begin);
+				glGetQueryObjectui64v(r.end_query, GL_QUERY_RESULT, &out.gpu_end);
+			}
+			out.cpu_begin = r.cpu_begin;
+			out.cpu_end = r.cpu_end;
+			out.calls = r.calls;
+			results.push_back(out);
+		}
+	}
+
+	long long now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count(); }
+
+	static unsigned long long calls()
+	{
+		#ifdef GLADUS_HAS_INSTRUMENT
+		return gl_call_statistics::current().calls;
+		#else
+		return 0;
+		#endif
+	}
+
+	static void write_event(std::ostream& out, bool first, const gpu_timer_result& r, int tid, double ts, double dur)
+	{
+		if (!first) out << ',';
+		out << "{\"name\":\"";
+		for (const char* c = r.name; *c; c++) {
+			if (*c == '"' || *c == '\\') out << '\\' << *c;
+			else if ((unsigned char)*c < 0x20) { char esc[8]; std::snprintf(esc, sizeof(esc), "\\u%04x", *c); out << esc; }
+			else out << *c;
+		}
+		char numbers[128];
+		std::snprintf(numbers, sizeof(numbers), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", tid, ts, dur);
+		out << numbers << ",\"args\":{\"frame\":" << r.frame << ",\"depth\":" << r.depth << ",\"calls\":" << r.calls << "}}";
+	}
+};
+
+/// A GPU timer scope of a profiler limited to the scope of the declared
+/// variable. Scopes may be nested.
+///
+///     scoped_gpu_timer timer(profiler, "shadow pass");
+struct scoped_gpu_timer
+{
+	gpu_profiler& profiler;
+
+	scoped_gpu_timer(gpu_profiler& profiler, const char* name): profiler(profiler), index(profiler.push(name)) {}
+	~scoped_gpu_timer() { profiler.pop(index); }
+
+	scoped_gpu_timer(const scoped_gpu_timer&) = delete;
+	scoped_gpu_timer& operator=(const scoped_gpu_timer&) = delete;
+
+private:
+	size_t index;
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_3
+	typedef gladus::gpu_profiler GpuProfiler;
+	typedef gladus::scoped_gpu_timer ScopedGpuTimer;
+	#endif
+}
@@ -0,0 +1,85 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include <cstddef>
+#define GLADUS_HAS_INSTRUMENT
+
+// Counting and tracing of the OpenGL calls issued by the wrappers. Counting,
+// for benchmarks and tests that want to compare code paths, is enabled by
+// defining GLADUS_COUNT_GL_CALLS before including gladus/opengl.hpp, which
+// includes this file. Defining GLADUS_TRACE_GL_CALLS enables counting as well
+// and additionally lets a gl_trace record the calls, see gladus/trace.hpp.
+//
+// Every OpenGL function gladus calls is shadowed by an object of the same name
+// in the gladus namespace. Unqualified calls from within the wrappers find the
+// shadow first, which increments a per-thread counter and forwards to the
+// real function. Calls made outside the gladus namespace are not counted;
+// code with a using directive for the gladus namespace has to qualify its own
+// OpenGL calls, e.g. ::glEnable, to avoid ambiguities.
+// The functions are listed in gladus/gl_call_list.hpp.
+
+namespace gladus {
+
+struct gl_call_statistics
+{
+	unsigned long long calls;
+
+	gl_call_statistics(): calls(0) {}
+
+	static gl_call_statistics& current() { static thread_local gl_call_statistics stats; return stats; }
+};
+
+/// Identifies each of the shadowed OpenGL functions.
+enum gl_call_id
+{
+	#define gladus_gl_call(name) gl_call_##name,
+	#include "gladus/gl_call_list.hpp"
+	#undef gladus_gl_call
+	num_gl_calls
+};
+
+inline const char* gl_call_name(int id)
+{
+	static const char* const names[] = {
+		#define gladus_gl_call(name) #name,
+		#include "gladus/gl_call_list.hpp"
+		#undef gladus_gl_call
+	};
+	return id >= 0 && id < num_gl_calls ? names[id] : NULL;
+}
+
+#if defined(GL_VERSION_3_2) && !defined(_WIN32)
+struct gl_trace;
+
+/// The trace recording the calls of this thread, if any.
+inline gl_trace*& active_gl_trace() { static thread_local gl_trace* trace = NULL; return trace; }
+#endif
+
+#if defined(GLADUS_TRACE_GL_CALLS) && defined(GL_VERSION_3_2) && !defined(_WIN32)
+template <int Id, typename R, typename... A> R traced_gl_call(gl_trace& trace, R (*function)(A...), A... args);
+#endif
+
+template <typename F, int Id> struct counted_gl_call;
+template <typename R, typename... A, int Id> struct counted_gl_call<R(A...), Id>
+{
+	R (*function)(A...);
+
+	R operator()(A... args) const
+	{
+		gl_call_statistics::current().calls++;
+		#if defined(GLADUS_TRACE_GL_CALLS) && defined(GL_VERSION_3_2) && !defined(_WIN32)
+		if (gl_trace* trace = active_gl_trace())
+			return traced_gl_call<Id>(*trace, function, args...);
+		#endif
+		return function(args...);
+	}
+};
+
+#define gladus_gl_call(name) static const counted_gl_call<decltype(::name), gl_call_##name> name = { &::name };
+#include "gladus/gl_call_list.hpp"
+#undef gladus_gl_call
+
+} // namespace gladus
+
+#ifdef GLADUS_TRACE_GL_CALLS
+#	include "gladus/trace.hpp"
+#endif
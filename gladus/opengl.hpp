@@ -10,3 +10,7 @@ extern "C" {
 #	include <GL/glext.h>
 #endif
 }
+
+#if defined(GLADUS_COUNT_GL_CALLS) || defined(GLADUS_TRACE_GL_CALLS)
+#	include "gladus/instrument.hpp"
+#endif
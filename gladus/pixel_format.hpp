@@ -0,0 +1,50 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/opengl.hpp"
+#define GLADUS_HAS_PIXEL_FORMAT
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+/// Size in bytes of one pixel of the given format and type, or 0 if the
+/// combination is not known.
+inline GLsizei pixel_size(GLenum format, GLenum type)
+{
+	switch (type) {
+		case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+			return 1;
+		case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV:
+		case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+		case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+			return 2;
+		case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+		case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+		case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+			return 4;
+		case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+			return 8;
+	}
+	GLsizei component;
+	switch (type) {
+		case GL_UNSIGNED_BYTE: case GL_BYTE: component = 1; break;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: component = 2; break;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: component = 4; break;
+		default: return 0;
+	}
+	switch (format) {
+		case GL_RED: case GL_GREEN: case GL_BLUE: case GL_ALPHA:
+		case GL_RED_INTEGER: case GL_GREEN_INTEGER: case GL_BLUE_INTEGER:
+		case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+			return component;
+		case GL_RG: case GL_RG_INTEGER:
+			return 2 * component;
+		case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+			return 3 * component;
+		case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER:
+			return 4 * component;
+		default: return 0;
+	}
+}
+#endif
+
+} // namespace gladus
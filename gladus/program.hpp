@@ -1,7 +1,12 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
 #include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/binding.hpp"
+#include "gladus/uniform_table.hpp"
+#include <cassert>
 #include <map>
+#include <utility>
 #define GLADUS_HAS_PROGRAM
 
 namespace gladus {
@@ -21,88 +26,139 @@ struct program_link_result
 	operator bool() const { return success; }
 };
 
+/// A uniform of a program, identified by its location. Uniforms obtained from
+/// a linked program also know their declared type and whether they are
+/// arrays. In debug builds, i.e. unless NDEBUG is defined, the setters verify
+/// that they match the declaration before calling OpenGL.
 struct program_uniform
 {
 	GLint location;
-	program_uniform() {}
-	program_uniform(GLint location): location(location) {}
+	GLenum type;
+	bool array;
+
+	program_uniform(): location(-1), type(0), array(false) {}
+	program_uniform(GLint location): location(location), type(0), array(false) {}
+	program_uniform(const uniform_info& u): location(u.location), type(u.type), array(u.array) {}
 	operator GLint() const { return location; }
 
-	void sampler(GLuint v) const { glUniform1i(location, v); throw_on_program_opengl_error(); }
-	void sampler(GLsizei n, const GLuint* v) const { glUniform1iv(location, n, (const GLint*)v); throw_on_program_opengl_error(); }
+	void sampler(GLuint v) const { check_sampler(1); glUniform1i(location, v); on_opengl_error(throw_on_uniform_error); }
+	void sampler(GLsizei n, const GLuint* v) const { check_sampler(n); glUniform1iv(location, n, (const GLint*)v); on_opengl_error(throw_on_uniform_error); }
 
-	void f(GLfloat v0) const { glUniform1f(location, v0); throw_on_program_opengl_error(); }
-	void f(GLfloat v0, GLfloat v1) const { glUniform2f(location, v0, v1); throw_on_program_opengl_error(); }
-	void f(GLfloat v0, GLfloat v1, GLfloat v2) const { glUniform3f(location, v0, v1, v2); throw_on_program_opengl_error(); }
-	void f(GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) const { glUniform4f(location, v0, v1, v2, v3); throw_on_program_opengl_error(); }
+	void f(GLfloat v0) const { check(GL_FLOAT, 1); glUniform1f(location, v0); on_opengl_error(throw_on_uniform_error); }
+	void f(GLfloat v0, GLfloat v1) const { check(GL_FLOAT_VEC2, 1); glUniform2f(location, v0, v1); on_opengl_error(throw_on_uniform_error); }
+	void f(GLfloat v0, GLfloat v1, GLfloat v2) const { check(GL_FLOAT_VEC3, 1); glUniform3f(location, v0, v1, v2); on_opengl_error(throw_on_uniform_error); }
+	void f(GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) const { check(GL_FLOAT_VEC4, 1); glUniform4f(location, v0, v1, v2, v3); on_opengl_error(throw_on_uniform_error); }
 
-	void fv1(const GLfloat* v) const { glUniform1fv(location, 1, v); throw_on_program_opengl_error(); }
-	void fv2(const GLfloat* v) const { glUniform2fv(location, 1, v); throw_on_program_opengl_error(); }
-	void fv3(const GLfloat* v) const { glUniform3fv(location, 1, v); throw_on_program_opengl_error(); }
-	void fv4(const GLfloat* v) const { glUniform4fv(location, 1, v); throw_on_program_opengl_error(); }
+	void fv1(const GLfloat* v) const { check(GL_FLOAT, 1); glUniform1fv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void fv2(const GLfloat* v) const { check(GL_FLOAT_VEC2, 1); glUniform2fv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void fv3(const GLfloat* v) const { check(GL_FLOAT_VEC3, 1); glUniform3fv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void fv4(const GLfloat* v) const { check(GL_FLOAT_VEC4, 1); glUniform4fv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
 
-	void fv1(GLsizei n, const GLfloat* v) const { glUniform1fv(location, n, v); throw_on_program_opengl_error(); }
-	void fv2(GLsizei n, const GLfloat* v) const { glUniform2fv(location, n, v); throw_on_program_opengl_error(); }
-	void fv3(GLsizei n, const GLfloat* v) const { glUniform3fv(location, n, v); throw_on_program_opengl_error(); }
-	void fv4(GLsizei n, const GLfloat* v) const { glUniform4fv(location, n, v); throw_on_program_opengl_error(); }
+	void fv1(GLsizei n, const GLfloat* v) const { check(GL_FLOAT, n); glUniform1fv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void fv2(GLsizei n, const GLfloat* v) const { check(GL_FLOAT_VEC2, n); glUniform2fv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void fv3(GLsizei n, const GLfloat* v) const { check(GL_FLOAT_VEC3, n); glUniform3fv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void fv4(GLsizei n, const GLfloat* v) const { check(GL_FLOAT_VEC4, n); glUniform4fv(location, n, v); on_opengl_error(throw_on_uniform_error); }
 
-	void i(GLint v0) const { glUniform1i(location, v0); throw_on_program_opengl_error(); }
-	void i(GLint v0, GLint v1) const { glUniform2i(location, v0, v1); throw_on_program_opengl_error(); }
-	void i(GLint v0, GLint v1, GLint v2) const { glUniform3i(location, v0, v1, v2); throw_on_program_opengl_error(); }
-	void i(GLint v0, GLint v1, GLint v2, GLint v3) const { glUniform4i(location, v0, v1, v2, v3); throw_on_program_opengl_error(); }
+	void i(GLint v0) const { check(GL_INT, 1); glUniform1i(location, v0); on_opengl_error(throw_on_uniform_error); }
+	void i(GLint v0, GLint v1) const { check(GL_INT_VEC2, 1); glUniform2i(location, v0, v1); on_opengl_error(throw_on_uniform_error); }
+	void i(GLint v0, GLint v1, GLint v2) const { check(GL_INT_VEC3, 1); glUniform3i(location, v0, v1, v2); on_opengl_error(throw_on_uniform_error); }
+	void i(GLint v0, GLint v1, GLint v2, GLint v3) const { check(GL_INT_VEC4, 1); glUniform4i(location, v0, v1, v2, v3); on_opengl_error(throw_on_uniform_error); }
 
-	void iv1(const GLint* v) const { glUniform1iv(location, 1, v); throw_on_program_opengl_error(); }
-	void iv2(const GLint* v) const { glUniform2iv(location, 1, v); throw_on_program_opengl_error(); }
-	void iv3(const GLint* v) const { glUniform3iv(location, 1, v); throw_on_program_opengl_error(); }
-	void iv4(const GLint* v) const { glUniform4iv(location, 1, v); throw_on_program_opengl_error(); }
+	void iv1(const GLint* v) const { check(GL_INT, 1); glUniform1iv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void iv2(const GLint* v) const { check(GL_INT_VEC2, 1); glUniform2iv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void iv3(const GLint* v) const { check(GL_INT_VEC3, 1); glUniform3iv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void iv4(const GLint* v) const { check(GL_INT_VEC4, 1); glUniform4iv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
 
-	void iv1(GLsizei n, const GLint* v) const { glUniform1iv(location, n, v); throw_on_program_opengl_error(); }
-	void iv2(GLsizei n, const GLint* v) const { glUniform2iv(location, n, v); throw_on_program_opengl_error(); }
-	void iv3(GLsizei n, const GLint* v) const { glUniform3iv(location, n, v); throw_on_program_opengl_error(); }
-	void iv4(GLsizei n, const GLint* v) const { glUniform4iv(location, n, v); throw_on_program_opengl_error(); }
+	void iv1(GLsizei n, const GLint* v) const { check(GL_INT, n); glUniform1iv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void iv2(GLsizei n, const GLint* v) const { check(GL_INT_VEC2, n); glUniform2iv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void iv3(GLsizei n, const GLint* v) const { check(GL_INT_VEC3, n); glUniform3iv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void iv4(GLsizei n, const GLint* v) const { check(GL_INT_VEC4, n); glUniform4iv(location, n, v); on_opengl_error(throw_on_uniform_error); }
 
 	#ifdef GL_VERSION_3_0
-	void ui(GLuint v0) const { glUniform1ui(location, v0); throw_on_program_opengl_error(); }
-	void ui(GLuint v0, GLuint v1) const { glUniform2ui(location, v0, v1); throw_on_program_opengl_error(); }
-	void ui(GLuint v0, GLuint v1, GLuint v2) const { glUniform3ui(location, v0, v1, v2); throw_on_program_opengl_error(); }
-	void ui(GLuint v0, GLuint v1, GLuint v2, GLuint v3) const { glUniform4ui(location, v0, v1, v2, v3); throw_on_program_opengl_error(); }
-
-	void uiv1(const GLuint* v) const { glUniform1uiv(location, 1, v); throw_on_program_opengl_error(); }
-	void uiv2(const GLuint* v) const { glUniform2uiv(location, 1, v); throw_on_program_opengl_error(); }
-	void uiv3(const GLuint* v) const { glUniform3uiv(location, 1, v); throw_on_program_opengl_error(); }
-	void uiv4(const GLuint* v) const { glUniform4uiv(location, 1, v); throw_on_program_opengl_error(); }
-
-	void uiv1(GLsizei n, const GLuint* v) const { glUniform1uiv(location, n, v); throw_on_program_opengl_error(); }
-	void uiv2(GLsizei n, const GLuint* v) const { glUniform2uiv(location, n, v); throw_on_program_opengl_error(); }
-	void uiv3(GLsizei n, const GLuint* v) const { glUniform3uiv(location, n, v); throw_on_program_opengl_error(); }
-	void uiv4(GLsizei n, const GLuint* v) const { glUniform4uiv(location, n, v); throw_on_program_opengl_error(); }
+	void ui(GLuint v0) const { check(GL_UNSIGNED_INT, 1); glUniform1ui(location, v0); on_opengl_error(throw_on_uniform_error); }
+	void ui(GLuint v0, GLuint v1) const { check(GL_UNSIGNED_INT_VEC2, 1); glUniform2ui(location, v0, v1); on_opengl_error(throw_on_uniform_error); }
+	void ui(GLuint v0, GLuint v1, GLuint v2) const { check(GL_UNSIGNED_INT_VEC3, 1); glUniform3ui(location, v0, v1, v2); on_opengl_error(throw_on_uniform_error); }
+	void ui(GLuint v0, GLuint v1, GLuint v2, GLuint v3) const { check(GL_UNSIGNED_INT_VEC4, 1); glUniform4ui(location, v0, v1, v2, v3); on_opengl_error(throw_on_uniform_error); }
+
+	void uiv1(const GLuint* v) const { check(GL_UNSIGNED_INT, 1); glUniform1uiv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void uiv2(const GLuint* v) const { check(GL_UNSIGNED_INT_VEC2, 1); glUniform2uiv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void uiv3(const GLuint* v) const { check(GL_UNSIGNED_INT_VEC3, 1); glUniform3uiv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+	void uiv4(const GLuint* v) const { check(GL_UNSIGNED_INT_VEC4, 1); glUniform4uiv(location, 1, v); on_opengl_error(throw_on_uniform_error); }
+
+	void uiv1(GLsizei n, const GLuint* v) const { check(GL_UNSIGNED_INT, n); glUniform1uiv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void uiv2(GLsizei n, const GLuint* v) const { check(GL_UNSIGNED_INT_VEC2, n); glUniform2uiv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void uiv3(GLsizei n, const GLuint* v) const { check(GL_UNSIGNED_INT_VEC3, n); glUniform3uiv(location, n, v); on_opengl_error(throw_on_uniform_error); }
+	void uiv4(GLsizei n, const GLuint* v) const { check(GL_UNSIGNED_INT_VEC4, n); glUniform4uiv(location, n, v); on_opengl_error(throw_on_uniform_error); }
 	#endif
 
-	void matrix2(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix2fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix3(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix3fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix4(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix4fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-
-	void matrix2(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix2fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix3(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix3fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix4(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix4fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-
-	void matrix2x3(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix2x3fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix2x4(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix2x4fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix3x2(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix3x2fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix3x4(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix3x4fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix4x2(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix4x2fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
-	void matrix4x3(const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix4x3fv(location, 1, transpose, v); throw_on_program_opengl_error(); }
+	void matrix2(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT2, 1); glUniformMatrix2fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix3(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT3, 1); glUniformMatrix3fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix4(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT4, 1); glUniformMatrix4fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+
+	void matrix2(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT2, n); glUniformMatrix2fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix3(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT3, n); glUniformMatrix3fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix4(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT4, n); glUniformMatrix4fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+
+	void matrix2x3(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT2x3, 1); glUniformMatrix2x3fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix2x4(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT2x4, 1); glUniformMatrix2x4fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix3x2(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT3x2, 1); glUniformMatrix3x2fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix3x4(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT3x4, 1); glUniformMatrix3x4fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix4x2(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT4x2, 1); glUniformMatrix4x2fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix4x3(const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT4x3, 1); glUniformMatrix4x3fv(location, 1, transpose, v); on_opengl_error(throw_on_uniform_error); }
+
+	void matrix2x3(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT2x3, n); glUniformMatrix2x3fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix2x4(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT2x4, n); glUniformMatrix2x4fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix3x2(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT3x2, n); glUniformMatrix3x2fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix3x4(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT3x4, n); glUniformMatrix3x4fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix4x2(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT4x2, n); glUniformMatrix4x2fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+	void matrix4x3(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { check(GL_FLOAT_MAT4x3, n); glUniformMatrix4x3fv(location, n, transpose, v); on_opengl_error(throw_on_uniform_error); }
+
+	inline void throw_on_program_opengl_error() const { on_opengl_error(throw_on_uniform_error); }
+
+	/// Whether a value of the given type may be assigned to a uniform of the
+	/// declared type. Booleans may be assigned by the float, int and unsigned
+	/// int setters of matching size.
+	static bool assignable(GLenum declared, GLenum given)
+	{
+		if (declared == given) return true;
+		switch (declared) {
+			case GL_BOOL:      return given == GL_FLOAT      || given == GL_INT      || given == GL_UNSIGNED_INT;
+			case GL_BOOL_VEC2: return given == GL_FLOAT_VEC2 || given == GL_INT_VEC2 || given == GL_UNSIGNED_INT_VEC2;
+			case GL_BOOL_VEC3: return given == GL_FLOAT_VEC3 || given == GL_INT_VEC3 || given == GL_UNSIGNED_INT_VEC3;
+			case GL_BOOL_VEC4: return given == GL_FLOAT_VEC4 || given == GL_INT_VEC4 || given == GL_UNSIGNED_INT_VEC4;
+			default: return given == GL_INT && opaque(declared);
+		}
+	}
 
-	void matrix2x3(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix2x3fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix2x4(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix2x4fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix3x2(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix3x2fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix3x4(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix3x4fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix4x2(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix4x2fv(location, n, transpose, v); throw_on_program_opengl_error(); }
-	void matrix4x3(GLsizei n, const GLfloat* v, GLboolean transpose = false) const { glUniformMatrix4x3fv(location, n, transpose, v); throw_on_program_opengl_error(); }
+	/// Whether uniforms of the given type are samplers or images, which are
+	/// assigned a texture unit through glUniform1i.
+	static bool opaque(GLenum type)
+	{
+		switch (type) {
+			case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+			case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+			case GL_BOOL: case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+			case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+			#ifdef GL_VERSION_2_1
+			case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+			#endif
+			#ifdef GL_VERSION_3_0
+			case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+			#endif
+			#ifdef GL_VERSION_4_0
+			case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+			case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+			case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2: case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+			#endif
+				return false;
+			default:
+				return true;
+		}
+	}
 
-	inline void throw_on_program_opengl_error() const
+	static void throw_on_uniform_error(const opengl_error& err)
 	{
-		incase_opengl_error(err) {
+		switch (err.ec) {
 			case GL_INVALID_OPERATION: throw runtime_error("program: failed to assign uniform: size of variable in the program source doesn't match, or data type doesn't match, or the location is invalid", err);
 			case GL_INVALID_VALUE: throw runtime_error("program: failed to assign uniform: 'n' is negative", err);
 			default: throw err;
@@ -132,8 +188,92 @@ struct program_uniform
 	void matrix(const gma::matrix3<GLfloat>& v) const { matrix3(v, false); }
 	void matrix(const gma::matrix4<GLfloat>& v) const { matrix4(v, false); }
 	#endif
+
+private:
+	/// Verifies that n values of the given type may be assigned to the
+	/// uniform. A no-op if NDEBUG is defined or the declaration is unknown.
+	void check(GLenum given, GLsizei n) const
+	{
+		#ifndef NDEBUG
+		if (type == 0 || location < 0) return;
+		if (!assignable(type, given))
+			throw runtime_error("program: failed to assign uniform: data type doesn't match the declaration in the program source");
+		if (n > 1 && !array)
+			throw runtime_error("program: failed to assign uniform: 'n' is greater than 1 but the variable in the program source is not an array");
+		#endif
+	}
+	void check_sampler(GLsizei n) const
+	{
+		#ifndef NDEBUG
+		if (type != 0 && location >= 0 && !opaque(type))
+			throw runtime_error("program: failed to assign uniform: variable in the program source is not a sampler");
+		check(GL_INT, n);
+		#endif
+	}
 };
 
+/// Counters of the uniform values assigned through typed_uniform handles. An
+/// assignment that reaches OpenGL counts as issued, one that was skipped
+/// because the uniform already held the value counts as skipped.
+struct uniform_statistics
+{
+	unsigned long issued;
+	unsigned long skipped;
+
+	uniform_statistics(): issued(0), skipped(0) {}
+};
+
+/// Maps a GLSL uniform type to the C++ component type and the glUniform* and
+/// glProgramUniform* calls that assign it. Booleans, samplers and images are
+/// assigned through GL_INT.
+template <GLenum Type> struct uniform_traits;
+
+#ifdef GL_VERSION_4_1
+#	define gladus_program_uniform(call) static void program_upload(GLuint p, GLint l, GLsizei n, const component* v) { call; }
+#else
+#	define gladus_program_uniform(call)
+#endif
+#define gladus_uniform_vector(type, T, N, suffix) template <> struct uniform_traits<type> {\
+	typedef T component; enum { components = N };\
+	static void upload(GLint l, GLsizei n, const component* v) { glUniform##suffix(l, n, v); }\
+	gladus_program_uniform(glProgramUniform##suffix(p, l, n, v)) };
+#define gladus_uniform_matrix(type, N, suffix) template <> struct uniform_traits<type> {\
+	typedef GLfloat component; enum { components = N };\
+	static void upload(GLint l, GLsizei n, const component* v) { glUniformMatrix##suffix(l, n, GL_FALSE, v); }\
+	gladus_program_uniform(glProgramUniformMatrix##suffix(p, l, n, GL_FALSE, v)) };
+
+gladus_uniform_vector(GL_FLOAT,      GLfloat, 1, 1fv)
+gladus_uniform_vector(GL_FLOAT_VEC2, GLfloat, 2, 2fv)
+gladus_uniform_vector(GL_FLOAT_VEC3, GLfloat, 3, 3fv)
+gladus_uniform_vector(GL_FLOAT_VEC4, GLfloat, 4, 4fv)
+gladus_uniform_vector(GL_INT,        GLint,   1, 1iv)
+gladus_uniform_vector(GL_INT_VEC2,   GLint,   2, 2iv)
+gladus_uniform_vector(GL_INT_VEC3,   GLint,   3, 3iv)
+gladus_uniform_vector(GL_INT_VEC4,   GLint,   4, 4iv)
+#ifdef GL_VERSION_3_0
+gladus_uniform_vector(GL_UNSIGNED_INT,      GLuint, 1, 1uiv)
+gladus_uniform_vector(GL_UNSIGNED_INT_VEC2, GLuint, 2, 2uiv)
+gladus_uniform_vector(GL_UNSIGNED_INT_VEC3, GLuint, 3, 3uiv)
+gladus_uniform_vector(GL_UNSIGNED_INT_VEC4, GLuint, 4, 4uiv)
+#endif
+gladus_uniform_matrix(GL_FLOAT_MAT2, 4,  2fv)
+gladus_uniform_matrix(GL_FLOAT_MAT3, 9,  3fv)
+gladus_uniform_matrix(GL_FLOAT_MAT4, 16, 4fv)
+#ifdef GL_VERSION_2_1
+gladus_uniform_matrix(GL_FLOAT_MAT2x3, 6,  2x3fv)
+gladus_uniform_matrix(GL_FLOAT_MAT2x4, 8,  2x4fv)
+gladus_uniform_matrix(GL_FLOAT_MAT3x2, 6,  3x2fv)
+gladus_uniform_matrix(GL_FLOAT_MAT3x4, 12, 3x4fv)
+gladus_uniform_matrix(GL_FLOAT_MAT4x2, 8,  4x2fv)
+gladus_uniform_matrix(GL_FLOAT_MAT4x3, 12, 4x3fv)
+#endif
+
+#undef gladus_uniform_vector
+#undef gladus_uniform_matrix
+#undef gladus_program_uniform
+
+template <GLenum Type> struct typed_uniform;
+
 /// A program, i.e. a linked set of shaders.
 struct program
 {
@@ -141,7 +281,27 @@ struct program
 
 	program() { id = glCreateProgram(); throw_on_opengl_error(); }
 	program(GLuint id): id(id) { assert(glIsProgram(id)); }
-	~program() { if (id > 0) glDeleteProgram(id); throw_on_opengl_error(); }
+	/// Uniform handles refer to the program object, so handles obtained
+	/// from the other program have to be fetched again from this one.
+	program(program&& other) noexcept: id(other.id), uniforms(std::move(other.uniforms)), uniform_counters(other.uniform_counters), uniform_location_cache(std::move(other.uniform_location_cache)) { other.id = 0; }
+	~program() { if (id > 0) { glDeleteProgram(id); throw_on_opengl_error(); } }
+
+	/// Deletes the program and takes over the other program's name and
+	/// uniform tables.
+	program& operator=(program&& other) noexcept
+	{
+		if (this == &other) return *this;
+		if (id > 0) glDeleteProgram(id);
+		id = other.id;
+		uniforms = std::move(other.uniforms);
+		uniform_counters = other.uniform_counters;
+		uniform_location_cache = std::move(other.uniform_location_cache);
+		other.id = 0;
+		return *this;
+	}
+
+	program(const program&) = delete;
+	program& operator=(const program&) = delete;
 
 	operator GLuint() const { return id; }
 
@@ -150,11 +310,7 @@ struct program
 		assert(id > 0);
 		clear_opengl_error();
 		glAttachShader(id, shader_id);
-		incase_opengl_error(err) {
-			case GL_INVALID_VALUE: throw runtime_error("program: failed to attach: 'id' or 'shader_id' is not a previously created program/shader", err);
-			case GL_INVALID_OPERATION: throw runtime_error("program: failed to attach: 'id' or 'shader_id' is not a program/shader, or the shader is already attached to the program", err);
-			default: throw err;
-		}
+		on_opengl_error(throw_on_attach_error);
 	}
 
 	void detach(GLuint shader_id) const
@@ -162,31 +318,48 @@ struct program
 		assert(id > 0);
 		clear_opengl_error();
 		glDetachShader(id, shader_id);
-		incase_opengl_error(err) {
-			case GL_INVALID_VALUE: throw runtime_error("program: failed to detach: 'id' or 'shader_id' is not a previously created program/shader", err);
-			case GL_INVALID_OPERATION: throw runtime_error("program: failed to detach: 'id' or 'shader_id' is not a program/shader, or the shader is was not attached to the program", err);
-			default: throw err;
-		}
+		on_opengl_error(throw_on_detach_error);
 	}
 
 	program_link_result link()
+	{
+		start_link();
+		return link_result();
+	}
+
+	/// Hands the program to the linker without waiting for the outcome. See
+	/// link_ready() and link_result().
+	void start_link()
 	{
 		assert(id > 0);
 		clear_opengl_error();
 		glLinkProgram(id);
-		incase_opengl_error(err1) {
-			case GL_INVALID_VALUE: throw runtime_error("program: failed to link: 'id' is not a previously created program", err1);
-			case GL_INVALID_OPERATION: throw runtime_error("program: failed to link: 'id' is not a program", err1);
-			default: throw err1;
-		}
+		on_opengl_error(throw_on_link_error);
+	}
 
+	/// Whether link_result() can be called without blocking. Always true
+	/// unless the context supports parallel shader compilation.
+	bool link_ready() const
+	{
+		if (!context::current().supports_parallel_shader_compile()) return true;
+		GLint done = GL_TRUE;
+		glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &done);
+		return done;
+	}
+
+	/// Waits for the linker and evaluates its outcome. Validates the program
+	/// unless GLADUS_DONT_VALIDATE_PROGRAMS is defined and builds the uniform
+	/// table.
+	program_link_result link_result()
+	{
 		#define extract_info_log(info)\
 			std::vector<GLchar> info; {\
 				GLint length;\
-				glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length); info.resize(length);\
+				glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length); info.resize(length > 0 ? length : 1);\
 				glGetProgramInfoLog(id, info.size(), NULL, &info[0]);\
 			}
 
+		uniforms.clear();
 		GLint success;
 		glGetProgramiv(id, GL_LINK_STATUS, &success);
 		if (!success) {
@@ -196,11 +369,7 @@ struct program
 
 		#ifndef GLADUS_DONT_VALIDATE_PROGRAMS
 		glValidateProgram(id);
-		incase_opengl_error(err2) {
-			case GL_INVALID_VALUE: throw runtime_error("program: failed to validate: 'id' is not a previously created program", err2);
-			case GL_INVALID_OPERATION: throw runtime_error("program: failed to validate: 'id' is not a program", err2);
-			default: throw err2;
-		}
+		on_opengl_error(throw_on_validate_error);
 
 		glGetProgramiv(id, GL_VALIDATE_STATUS, &success);
 		if (!success) {
@@ -211,31 +380,65 @@ struct program
 		#undef extract_info_log
 
 		uniform_location_cache.clear();
+		uniforms.introspect(id);
 		return program_link_result(true);
 	}
 
-	void use() const
+	#ifdef GL_VERSION_4_1
+	/// Hints the driver to keep the binary of the program retrievable through
+	/// binary(). Takes effect at the next link().
+	void set_binary_retrievable(bool retrievable) const
+	{
+		assert(id > 0);
+		glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, retrievable ? GL_TRUE : GL_FALSE);
+		throw_on_opengl_error();
+	}
+
+	/// Retrieves the driver-specific binary of the linked program.
+	void binary(GLenum& format, std::vector<GLubyte>& data) const
 	{
 		assert(id > 0);
+		GLint length = 0;
+		glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+		data.resize(length);
+		if (length == 0) return;
 		clear_opengl_error();
-		glUseProgram(id);
-		incase_opengl_error(err) {
-			case GL_INVALID_VALUE: throw runtime_error("program: failed to use: 'id' is neither 0 nor a previously created program", err);
-			case GL_INVALID_OPERATION: throw runtime_error("program: failed to use: 'id' is not a program or failed to be made part of the current state", err);
-			default: throw err;
-		}
+		glGetProgramBinary(id, length, NULL, &format, &data[0]);
+		on_opengl_error(throw_on_binary_error);
 	}
 
-	void unuse() const
+	/// Loads a binary previously obtained through binary() in place of
+	/// linking. The result is unsuccessful if the driver rejects the binary,
+	/// e.g. after a driver update; link the program from source in that case.
+	program_link_result load_binary(GLenum format, const void* data, GLsizei length)
 	{
+		assert(id > 0);
 		clear_opengl_error();
-		glUseProgram(0);
-		throw_on_opengl_error();
+		glProgramBinary(id, format, data, length);
+		on_opengl_error(throw_on_binary_error);
+		return link_result();
+	}
+	#endif
+
+	void use() const
+	{
+		assert(id > 0);
+		use_name(id);
 	}
 
+	void unuse() const { use_name(0); }
+
+	GLuint current_binding() const { return context::current().bindings.current_program(); }
+	void restore_binding(GLuint name) const { use_name(name); }
+
+	/// Returns the location of a uniform. Names of active uniforms are found in
+	/// the table built at link time; other names, e.g. individual elements of
+	/// an array, are queried from OpenGL once and cached.
 	const GLint& uniform_location(const std::string& name)
 	{
 		assert(id > 0);
+		if (const uniform_info* u = uniforms.find(uniform_key(name)))
+			return u->location;
 		std::map<std::string, GLint>::iterator it = uniform_location_cache.find(name);
 		if (it == uniform_location_cache.end()) {
 			GLint& loc = uniform_location_cache[name];
@@ -245,12 +448,241 @@ struct program
 		return it->second;
 	}
 
-	program_uniform uniform(const std::string& name) { return program_uniform(uniform_location(name)); }
+	program_uniform uniform(const std::string& name)
+	{
+		if (const uniform_info* u = uniforms.find(uniform_key(name)))
+			return program_uniform(*u);
+		return program_uniform(uniform_location(name));
+	}
+
+	program_uniform uniform(const char* name)
+	{
+		if (const uniform_info* u = uniforms.find(uniform_key(name)))
+			return program_uniform(*u);
+		return program_uniform(uniform_location(name));
+	}
+
+	/// Looks up an active uniform by a precomputed key. Neither allocates
+	/// memory nor calls OpenGL. Returns a uniform at location -1, which OpenGL
+	/// silently ignores, if the program has no such active uniform.
+	program_uniform uniform(uniform_key key) const
+	{
+		if (const uniform_info* u = uniforms.find(key))
+			return program_uniform(*u);
+		return program_uniform();
+	}
+
+	#ifdef GL_VERSION_3_1
+	/// Returns the index of the named uniform block, or GL_INVALID_INDEX if
+	/// the program has no such active block.
+	GLuint uniform_block_index(const char* name) const
+	{
+		assert(id > 0);
+		return glGetUniformBlockIndex(id, name);
+	}
+
+	/// The number of bytes a buffer bound to the named uniform block has to
+	/// provide at least.
+	GLint uniform_block_size(const char* name) const
+	{
+		GLuint index = uniform_block_index(name);
+		if (index == GL_INVALID_INDEX)
+			throw runtime_error("program: failed to query uniform block: 'name' is not an active uniform block");
+		GLint size = 0;
+		glGetActiveUniformBlockiv(id, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		return size;
+	}
+
+	/// Makes the named uniform block read from the given uniform buffer
+	/// binding point.
+	void bind_uniform_block(const char* name, GLuint binding) const
+	{
+		GLuint index = uniform_block_index(name);
+		if (index == GL_INVALID_INDEX)
+			throw runtime_error("program: failed to bind uniform block: 'name' is not an active uniform block");
+		clear_opengl_error();
+		glUniformBlockBinding(id, index, binding);
+		on_opengl_error(throw_on_block_binding_error);
+	}
+	#endif
+
+	#ifdef GL_VERSION_4_3
+	/// Makes the named shader storage block access the given shader storage
+	/// buffer binding point.
+	void bind_storage_block(const char* name, GLuint binding) const
+	{
+		assert(id > 0);
+		GLuint index = glGetProgramResourceIndex(id, GL_SHADER_STORAGE_BLOCK, name);
+		if (index == GL_INVALID_INDEX)
+			throw runtime_error("program: failed to bind storage block: 'name' is not an active shader storage block");
+		clear_opengl_error();
+		glShaderStorageBlockBinding(id, index, binding);
+		on_opengl_error(throw_on_block_binding_error);
+	}
+	#endif
+
+	/// Returns a handle through which an active uniform of the given GLSL type
+	/// is assigned with shadowing, see typed_uniform. The handle is empty if
+	/// the program has no such active uniform.
+	template <GLenum Type> typed_uniform<Type> uniform(uniform_key key);
+
+	/// The active uniforms of the program, as of the last successful link.
+	const uniform_table& active_uniforms() const { return uniforms; }
+
+	/// Statistics of the values assigned through typed_uniform handles.
+	const uniform_statistics& uniform_stats() const { return uniform_counters; }
+
+	/// Forgets the shadowed uniform values. Required after assigning uniforms
+	/// that typed_uniform handles refer to by any other means.
+	void forget_uniform_values() { uniforms.forget_values(); }
+
+	/// Assigns n values to a uniform, unless it is known to hold them already.
+	/// Uses glProgramUniform* if the program is not in use and the context
+	/// supports it, and makes the program current temporarily otherwise.
+	template <GLenum Type> void upload_uniform(const uniform_info& u, GLsizei n, const typename uniform_traits<Type>::component* v)
+	{
+		typedef uniform_traits<Type> traits;
+		const GLsizei stride = sizeof(typename traits::component) * traits::components;
+		if (uniforms.holds(u, n, v, stride)) {
+			uniform_counters.skipped++;
+			return;
+		}
+		context& ctx = context::current();
+		if (ctx.bindings.current_program() == id) {
+			clear_opengl_error();
+			traits::upload(u.location, n, v);
+		#ifdef GL_VERSION_4_1
+		} else if (ctx.supports_program_uniform()) {
+			clear_opengl_error();
+			traits::program_upload(id, u.location, n, v);
+		#endif
+		} else {
+			scoped_use<program> used(*this);
+			clear_opengl_error();
+			traits::upload(u.location, n, v);
+		}
+		on_opengl_error(program_uniform::throw_on_uniform_error);
+		uniforms.store(u, n, v, stride);
+		uniform_counters.issued++;
+	}
+
+	static void throw_on_attach_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("program: failed to attach: 'id' or 'shader_id' is not a previously created program/shader", err);
+			case GL_INVALID_OPERATION: throw runtime_error("program: failed to attach: 'id' or 'shader_id' is not a program/shader, or the shader is already attached to the program", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_detach_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("program: failed to detach: 'id' or 'shader_id' is not a previously created program/shader", err);
+			case GL_INVALID_OPERATION: throw runtime_error("program: failed to detach: 'id' or 'shader_id' is not a program/shader, or the shader is was not attached to the program", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_link_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("program: failed to link: 'id' is not a previously created program", err);
+			case GL_INVALID_OPERATION: throw runtime_error("program: failed to link: 'id' is not a program", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_validate_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("program: failed to validate: 'id' is not a previously created program", err);
+			case GL_INVALID_OPERATION: throw runtime_error("program: failed to validate: 'id' is not a program", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_block_binding_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("program: failed to bind block: 'binding' exceeds the number of binding points", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_binary_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("program: failed to load binary: 'format' is not a supported binary format", err);
+			case GL_INVALID_OPERATION: throw runtime_error("program: failed to transfer binary: 'id' is not a program, or it has not been linked successfully", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_use_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("program: failed to use: 'id' is neither 0 nor a previously created program", err);
+			case GL_INVALID_OPERATION: throw runtime_error("program: failed to use: 'id' is not a program or failed to be made part of the current state", err);
+			default: throw err;
+		}
+	}
 
 private:
+	uniform_table uniforms;
+	uniform_statistics uniform_counters;
 	std::map<std::string, GLint> uniform_location_cache;
+
+	/// Makes a program current, unless the binding cache knows it is current
+	/// already.
+	void use_name(GLuint name) const
+	{
+		binding_cache& cache = context::current().bindings;
+		if (cache.program_used(name)) return;
+		clear_opengl_error();
+		glUseProgram(name);
+		on_opengl_error(throw_on_use_error);
+		cache.use_program(name);
+	}
 };
 
+/// A handle to an active uniform of a program with the given GLSL type, see
+/// uniform_traits. Assigning a value that the uniform holds already, as far as
+/// the program's shadow copy knows, does not call OpenGL. The handle refers to
+/// the program's uniform table and becomes invalid when the program is linked
+/// again. Empty handles, i.e. of uniforms the program does not have, ignore
+/// assignments.
+template <GLenum Type> struct typed_uniform
+{
+	typedef uniform_traits<Type> traits;
+	typedef typename traits::component component;
+
+	program* owner;
+	const uniform_info* info;
+
+	typed_uniform(): owner(NULL), info(NULL) {}
+	typed_uniform(program& owner, const uniform_info* info): owner(&owner), info(info)
+	{
+		#ifndef NDEBUG
+		if (info && !program_uniform::assignable(info->type, Type))
+			throw runtime_error("program: failed to get uniform: data type doesn't match the declaration in the program source");
+		#endif
+	}
+
+	operator bool() const { return info != NULL; }
+
+	void set(component v) { static_assert(traits::components == 1, "set(component) requires a scalar uniform type"); set(1, &v); }
+	void set(const component* v) { set(1, v); }
+	void set(GLsizei n, const component* v)
+	{
+		if (!info) return;
+		#ifndef NDEBUG
+		if (n > 1 && !info->array)
+			throw runtime_error("program: failed to assign uniform: 'n' is greater than 1 but the variable in the program source is not an array");
+		#endif
+		owner->upload_uniform<Type>(*info, n, v);
+	}
+};
+
+template <GLenum Type> typed_uniform<Type> program::uniform(uniform_key key)
+{
+	return typed_uniform<Type>(*this, uniforms.find(key));
+}
+
 } // namespace gladus
 
 namespace gl {
@@ -0,0 +1,267 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/shader.hpp"
+#include "gladus/program.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#	include <process.h>
+#else
+#	include <unistd.h>
+#endif
+#define GLADUS_HAS_PROGRAM_CACHE
+
+namespace gladus {
+
+#ifdef GL_VERSION_4_1
+/// Source code of one stage of a program.
+struct program_source
+{
+	GLenum type;
+	std::string text;
+
+	program_source(): type(0) {}
+	program_source(GLenum type, const std::string& text): type(type), text(text) {}
+};
+
+struct program_cache_statistics
+{
+	/// Programs loaded from a cached binary.
+	unsigned long hits;
+	/// Programs built from source, including rejected binaries.
+	unsigned long misses;
+	/// Cached binaries the driver refused to load.
+	unsigned long rejected;
+	/// Binaries written to the cache directory.
+	unsigned long stores;
+	/// Time spent loading binaries and building programs from source.
+	double load_seconds;
+	double build_seconds;
+
+	program_cache_statistics(): hits(0), misses(0), rejected(0), stores(0), load_seconds(0), build_seconds(0) {}
+};
+
+/// A directory of program binaries, keyed by a hash of the source and type
+/// of every stage and of the vendor, renderer and version strings of the
+/// driver. build() loads a program from its cached binary if there is one
+/// and the driver accepts it, and compiles and links it from source
+/// otherwise, storing the resulting binary for the next time.
+///
+/// Binaries are written to a temporary file that is renamed into place, such
+/// that several processes may share a directory without ever reading a
+/// partially written binary. The directory has to exist; if it is not
+/// writable, programs are still built but not cached.
+struct program_cache
+{
+	std::string directory;
+	program_cache_statistics stats;
+
+	explicit program_cache(const std::string& directory): directory(directory), support(-1) {}
+
+	/// Whether the context can retrieve and load program binaries, i.e.
+	/// supports OpenGL 4.1 or ARB_get_program_binary with at least one
+	/// binary format.
+	bool supported()
+	{
+		if (support < 0) {
+			const extensions& e = context::current().features();
+			GLint n = 0;
+			if (e.version(4,1) || e.has("GL_ARB_get_program_binary"))
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n);
+			formats.resize(n);
+			if (n > 0)
+				glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats[0]);
+			support = n > 0;
+		}
+		return support;
+	}
+
+	/// Builds the program from the given stages. The shader objects are
+	/// detached and deleted afterwards.
+	program_link_result build(program& prog, const std::vector<program_source>& sources)
+	{
+		if (!supported()) {
+			stats.misses++;
+			return compile_and_link(prog, sources, false);
+		}
+		std::string path = file_name(key(sources));
+
+		GLenum format = 0;
+		std::vector<GLubyte> blob;
+		if (read(path, format, blob) && format_supported(format)) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			program_link_result result = prog.load_binary(format, &blob[0], blob.size());
+			stats.load_seconds += seconds_since(start);
+			if (result) {
+				stats.hits++;
+				return result;
+			}
+			stats.rejected++;
+		}
+
+		stats.misses++;
+		program_link_result result = compile_and_link(prog, sources, true);
+		if (result) {
+			prog.binary(format, blob);
+			if (!blob.empty() && write(path, format, blob))
+				stats.stores++;
+		}
+		return result;
+	}
+
+	/// The key under which a program built from the given stages is cached.
+	unsigned long long key(const std::vector<program_source>& sources)
+	{
+		unsigned long long h = 14695981039346656037ull;
+		for (size_t i = 0; i < sources.size(); i++) {
+			unsigned long long length = sources[i].text.size();
+			h = hash(h, &sources[i].type, sizeof(sources[i].type));
+			h = hash(h, &length, sizeof(length));
+			h = hash(h, sources[i].text.data(), sources[i].text.size());
+		}
+		const std::string& d = driver();
+		return hash(h, d.data(), d.size());
+	}
+
+	std::string file_name(unsigned long long key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", key);
+		return directory + "/" + name;
+	}
+
+private:
+	int support;
+	std::vector<GLint> formats;
+	std::string driver_string;
+
+	static unsigned long long hash(unsigned long long h, const void* data, size_t n)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < n; i++)
+			h = (h ^ p[i]) * 1099511628211ull;
+		return h;
+	}
+
+	static double seconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const std::string& driver()
+	{
+		if (driver_string.empty()) {
+			const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+			for (size_t i = 0; i < sizeof(names)/sizeof(*names); i++) {
+				const char* s = (const char*)glGetString(names[i]);
+				driver_string += s ? s : "";
+				driver_string += '\n';
+			}
+		}
+		return driver_string;
+	}
+
+	bool format_supported(GLenum format) const
+	{
+		for (size_t i = 0; i < formats.size(); i++)
+			if (GLenum(formats[i]) == format) return true;
+		return false;
+	}
+
+	program_link_result compile_and_link(program& prog, const std::vector<program_source>& sources, bool retrievable)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		program_link_result result(true);
+		for (size_t i = 0; i < sources.size() && result; i++) {
+			// The shader object is only flagged for deletion when going out
+			// of scope, since it stays attached until detach_all().
+			shader s(sources[i].type);
+			s.source(sources[i].text.c_str(), sources[i].text.size());
+			shader_compile_result compiled = s.compile();
+			if (compiled)
+				prog.attach(s);
+			else
+				result = program_link_result(false, compiled.info);
+		}
+		if (result) {
+			if (retrievable) prog.set_binary_retrievable(true);
+			result = prog.link();
+		}
+		detach_all(prog);
+		stats.build_seconds += seconds_since(start);
+		return result;
+	}
+
+	static void detach_all(const program& prog)
+	{
+		GLint n = 0;
+		glGetProgramiv(prog.id, GL_ATTACHED_SHADERS, &n);
+		if (n == 0) return;
+		std::vector<GLuint> shaders(n);
+		glGetAttachedShaders(prog.id, n, NULL, &shaders[0]);
+		for (GLint i = 0; i < n; i++)
+			prog.detach(shaders[i]);
+	}
+
+	struct file_header
+	{
+		char magic[4];
+		GLuint version;
+		GLenum format;
+		GLuint length;
+	};
+
+	static bool read(const std::string& path, GLenum& format, std::vector<GLubyte>& blob)
+	{
+		std::ifstream f(path.c_str(), std::ios::binary);
+		file_header h;
+		if (!f.read((char*)&h, sizeof(h))) return false;
+		if (std::string(h.magic, 4) != "GLDS" || h.version != 1 || h.length == 0) return false;
+		blob.resize(h.length);
+		if (!f.read((char*)&blob[0], h.length)) return false;
+		format = h.format;
+		return true;
+	}
+
+	static bool write(const std::string& path, GLenum format, const std::vector<GLubyte>& blob)
+	{
+		static std::atomic<unsigned long> counter(0);
+		std::ostringstream tmp;
+		#ifdef _WIN32
+		tmp << path << '.' << _getpid() << '.' << counter++ << ".tmp";
+		#else
+		tmp << path << '.' << getpid() << '.' << counter++ << ".tmp";
+		#endif
+		file_header h = { {'G','L','D','S'}, 1, format, GLuint(blob.size()) };
+		{
+			std::ofstream f(tmp.str().c_str(), std::ios::binary);
+			if (!f.write((const char*)&h, sizeof(h)) || !f.write((const char*)&blob[0], blob.size())) {
+				f.close();
+				std::remove(tmp.str().c_str());
+				return false;
+			}
+		}
+		if (std::rename(tmp.str().c_str(), path.c_str()) != 0) {
+			std::remove(tmp.str().c_str());
+			return false;
+		}
+		return true;
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_4_1
+	typedef gladus::program_source ProgramSource;
+	typedef gladus::program_cache ProgramCache;
+	#endif
+}
@@ -0,0 +1,193 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#define GLADUS_HAS_REGISTRY
+
+namespace gladus {
+
+/// A 32-bit reference to an entry of a registry, made of the index of the
+/// entry's slot in the low 20 bits and the slot's generation in the high 12
+/// bits. The generation changes whenever the slot's entry is erased, which
+/// tells stale handles apart from the slot's current entry. A default
+/// constructed handle refers to nothing.
+struct registry_handle
+{
+	enum { index_bits = 20, generation_bits = 12 };
+	static const uint32_t index_mask = (1u << index_bits) - 1;
+	static const uint32_t generation_mask = (1u << generation_bits) - 1;
+
+	uint32_t value;
+
+	registry_handle(): value(0) {}
+	registry_handle(uint32_t index, uint32_t generation): value(index | generation << index_bits) {}
+
+	uint32_t index() const { return value & index_mask; }
+	uint32_t generation() const { return value >> index_bits; }
+
+	explicit operator bool() const { return value != 0; }
+	bool operator==(const registry_handle& o) const { return value == o.value; }
+	bool operator!=(const registry_handle& o) const { return value != o.value; }
+};
+
+/// The metadata columns of a registry, each held in a vector of its own.
+template <typename... Columns> struct registry_columns
+{
+	/// A registry without metadata has no columns to access.
+	template <size_t I, int Dummy = 0> struct column;
+
+	void push() {}
+	void move_back(size_t) {}
+	void pop_back() {}
+	void reserve(size_t) {}
+};
+
+template <typename C, typename... Rest> struct registry_columns<C, Rest...>
+{
+	std::vector<C> values;
+	registry_columns<Rest...> rest;
+
+	void push(const C& value, const Rest&... others) { values.push_back(value); rest.push(others...); }
+	/// Moves the last row to the given one.
+	void move_back(size_t row) { values[row] = std::move(values.back()); rest.move_back(row); }
+	void pop_back() { values.pop_back(); rest.pop_back(); }
+	void reserve(size_t n) { values.reserve(n); rest.reserve(n); }
+
+	template <size_t I, int Dummy = 0> struct column
+	{
+		typedef typename registry_columns<Rest...>::template column<I-1>::type type;
+		static std::vector<type>& get(registry_columns& c) { return registry_columns<Rest...>::template column<I-1>::get(c.rest); }
+	};
+	template <int Dummy> struct column<0, Dummy>
+	{
+		typedef C type;
+		static std::vector<C>& get(registry_columns& c) { return c.values; }
+	};
+};
+
+/// Owns objects such as buffers or textures by value, together with any
+/// number of metadata columns, e.g. sizes or formats, and hands out 32-bit
+/// handles to them. Objects and each metadata column are stored densely in
+/// vectors of their own, i.e. as a structure of arrays, such that iterating
+/// over all objects or all values of one column touches contiguous memory.
+/// Erasing moves the last entry into the gap, so the order of entries
+/// changes; handles stay valid until their entry is erased, after which
+/// lookups report them as stale rather than finding another entry.
+///
+///     registry<texture, GLsizei, GLsizei> textures;
+///     registry_handle h = textures.insert(texture(GL_TEXTURE_2D), 256, 256);
+///     if (texture* t = textures.find(h)) t->bind();
+///     std::vector<GLsizei>& widths = textures.column<0>();
+template <typename T, typename... Metadata> struct registry
+{
+	typedef registry_handle handle;
+	static const size_t max_size = size_t(1) << registry_handle::index_bits;
+
+	registry() {}
+
+	registry(const registry&) = delete;
+	registry& operator=(const registry&) = delete;
+
+	handle insert(T&& object, const Metadata&... metadata)
+	{
+		uint32_t slot;
+		if (!unused.empty()) {
+			slot = unused.back();
+			unused.pop_back();
+		} else {
+			if (slots.size() == max_size)
+				throw runtime_error("registry: failed to insert: all handle indices are in use");
+			slot = slots.size();
+			slots.push_back(slot_entry());
+		}
+		slots[slot].row = objects_.size();
+		objects_.push_back(std::move(object));
+		columns.push(metadata...);
+		rows.push_back(slot);
+		return handle(slot, slots[slot].generation);
+	}
+
+	/// Destroys the entry of the handle. Returns false if the handle is
+	/// stale.
+	bool erase(handle h)
+	{
+		if (!contains(h)) return false;
+		slot_entry& s = slots[h.index()];
+		size_t row = s.row;
+		size_t last = objects_.size() - 1;
+		if (row != last) {
+			objects_[row] = std::move(objects_[last]);
+			columns.move_back(row);
+			rows[row] = rows[last];
+			slots[rows[row]].row = row;
+		}
+		objects_.pop_back();
+		columns.pop_back();
+		rows.pop_back();
+		s.row = npos;
+		// Generation 0 is skipped, so that no handle has the value 0.
+		s.generation = (s.generation + 1) & registry_handle::generation_mask;
+		if (s.generation == 0) s.generation = 1;
+		unused.push_back(h.index());
+		return true;
+	}
+
+	bool contains(handle h) const
+	{
+		return h.index() < slots.size() && slots[h.index()].generation == h.generation() && slots[h.index()].row != npos;
+	}
+
+	/// Returns the object of the handle, or NULL if the handle is stale.
+	T* find(handle h) { return contains(h) ? &objects_[slots[h.index()].row] : NULL; }
+	const T* find(handle h) const { return contains(h) ? &objects_[slots[h.index()].row] : NULL; }
+
+	/// Returns the value of the I-th metadata column of the handle's entry,
+	/// or NULL if the handle is stale.
+	template <size_t I> typename registry_columns<Metadata...>::template column<I>::type* metadata(handle h)
+	{
+		return contains(h) ? &column<I>()[slots[h.index()].row] : NULL;
+	}
+
+	size_t size() const { return objects_.size(); }
+	bool empty() const { return objects_.empty(); }
+
+	void reserve(size_t n)
+	{
+		objects_.reserve(n);
+		columns.reserve(n);
+		rows.reserve(n);
+	}
+
+	/// The objects, in an order that changes as entries are erased. Row i of
+	/// every column belongs to objects()[i], whose handle is handle_at(i).
+	std::vector<T>& objects() { return objects_; }
+	const std::vector<T>& objects() const { return objects_; }
+	template <size_t I> std::vector<typename registry_columns<Metadata...>::template column<I>::type>& column()
+	{
+		return registry_columns<Metadata...>::template column<I>::get(columns);
+	}
+	handle handle_at(size_t row) const { return handle(rows[row], slots[rows[row]].generation); }
+
+private:
+	static const size_t npos = size_t(-1);
+
+	struct slot_entry
+	{
+		size_t row;
+		uint32_t generation;
+
+		slot_entry(): row(npos), generation(1) {}
+	};
+
+	std::vector<T> objects_;
+	registry_columns<Metadata...> columns;
+	/// Slot of each row.
+	std::vector<uint32_t> rows;
+	std::vector<slot_entry> slots;
+	std::vector<uint32_t> unused;
+};
+
+} // namespace gladus
@@ -0,0 +1,281 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+#define GLADUS_HAS_RENDER_STATE
+
+namespace gladus {
+
+#ifdef GL_VERSION_2_0
+/// Description of the fixed-function pipeline state a draw call depends on:
+/// blending, depth testing, face culling, polygon offset, color mask, scissor
+/// and viewport. A default constructed state holds OpenGL's initial values,
+/// except for the scissor box and the viewport, which are left untouched
+/// unless set.
+///
+/// Descriptions are assembled with the setters and then interned, which
+/// returns a pointer to the one immutable copy of each distinct state. Two
+/// interned states are equal exactly if their pointers are. apply() issues the
+/// calls for the fields in which the state differs from the one last applied
+/// to the current context:
+///
+///     static const render_state* alpha = render_state().blend(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).intern();
+///     alpha->apply();
+struct render_state
+{
+	bool blending;
+	GLenum src_rgb, dst_rgb, src_alpha, dst_alpha;
+	GLenum equation_rgb, equation_alpha;
+	GLfloat constant[4];
+
+	bool depth_testing;
+	GLenum depth_function;
+	bool depth_writes;
+
+	bool culling;
+	GLenum culled_face;
+	GLenum front_face;
+
+	bool offsetting;
+	GLfloat offset_factor, offset_units;
+
+	bool color_writes[4];
+
+	bool scissoring;
+	/// x, y, width and height. A negative width leaves the box untouched.
+	GLint scissor_box[4];
+	GLint viewport_box[4];
+
+	render_state():
+		blending(false), src_rgb(GL_ONE), dst_rgb(GL_ZERO), src_alpha(GL_ONE), dst_alpha(GL_ZERO),
+		equation_rgb(GL_FUNC_ADD), equation_alpha(GL_FUNC_ADD),
+		depth_testing(false), depth_function(GL_LESS), depth_writes(true),
+		culling(false), culled_face(GL_BACK), front_face(GL_CCW),
+		offsetting(false), offset_factor(0), offset_units(0),
+		scissoring(false), interned(false)
+	{
+		constant[0] = constant[1] = constant[2] = constant[3] = 0;
+		color_writes[0] = color_writes[1] = color_writes[2] = color_writes[3] = true;
+		scissor_box[0] = scissor_box[1] = scissor_box[3] = 0; scissor_box[2] = -1;
+		viewport_box[0] = viewport_box[1] = viewport_box[3] = 0; viewport_box[2] = -1;
+	}
+
+	/// Enables blending with the given factors.
+	render_state& blend(GLenum src, GLenum dst) { return blend(src, dst, src, dst); }
+	render_state& blend(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+	{
+		blending = true;
+		this->src_rgb = src_rgb; this->dst_rgb = dst_rgb;
+		this->src_alpha = src_alpha; this->dst_alpha = dst_alpha;
+		return *this;
+	}
+	render_state& blend_equation(GLenum mode) { return blend_equation(mode, mode); }
+	render_state& blend_equation(GLenum rgb, GLenum alpha) { equation_rgb = rgb; equation_alpha = alpha; return *this; }
+	render_state& blend_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+	{
+		constant[0] = r; constant[1] = g; constant[2] = b; constant[3] = a;
+		return *this;
+	}
+
+	/// Enables depth testing with the given function.
+	render_state& depth(GLenum func, bool write = true) { depth_testing = true; depth_function = func; depth_writes = write; return *this; }
+	render_state& depth_mask(bool write) { depth_writes = write; return *this; }
+
+	/// Enables culling of the given faces.
+	render_state& cull(GLenum face = GL_BACK) { culling = true; culled_face = face; return *this; }
+	render_state& front(GLenum mode) { front_face = mode; return *this; }
+
+	/// Enables polygon offset for filled polygons.
+	render_state& polygon_offset(GLfloat factor, GLfloat units) { offsetting = true; offset_factor = factor; offset_units = units; return *this; }
+
+	render_state& color_mask(bool r, bool g, bool b, bool a)
+	{
+		color_writes[0] = r; color_writes[1] = g; color_writes[2] = b; color_writes[3] = a;
+		return *this;
+	}
+
+	/// Enables the scissor test with the given box.
+	render_state& scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		scissoring = true;
+		scissor_box[0] = x; scissor_box[1] = y; scissor_box[2] = width; scissor_box[3] = height;
+		return *this;
+	}
+	render_state& viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		viewport_box[0] = x; viewport_box[1] = y; viewport_box[2] = width; viewport_box[3] = height;
+		return *this;
+	}
+
+	bool operator==(const render_state& o) const
+	{
+		return blending == o.blending && (!blending || same_blend(o)) &&
+			depth_testing == o.depth_testing && depth_function == o.depth_function && depth_writes == o.depth_writes &&
+			culling == o.culling && culled_face == o.culled_face && front_face == o.front_face &&
+			offsetting == o.offsetting && offset_factor == o.offset_factor && offset_units == o.offset_units &&
+			std::memcmp(color_writes, o.color_writes, sizeof(color_writes)) == 0 &&
+			scissoring == o.scissoring && same_box(scissor_box, o.scissor_box) &&
+			same_box(viewport_box, o.viewport_box);
+	}
+	bool operator!=(const render_state& o) const { return !(*this == o); }
+
+	/// FNV-1a hash over the fields, consistent with operator==. Adding zero
+	/// folds -0 into 0 for the fields compared with ==.
+	size_t hash() const
+	{
+		unsigned long long h = 14695981039346656037ull;
+		h = mix(h, blending);
+		if (blending) {
+			h = mix(h, src_rgb); h = mix(h, dst_rgb); h = mix(h, src_alpha); h = mix(h, dst_alpha);
+			h = mix(h, equation_rgb); h = mix(h, equation_alpha);
+			for (int i = 0; i < 4; i++) h = mix(h, constant[i]);
+		}
+		h = mix(h, depth_testing); h = mix(h, depth_function); h = mix(h, depth_writes);
+		h = mix(h, culling); h = mix(h, culled_face); h = mix(h, front_face);
+		h = mix(h, offsetting); h = mix(h, offset_factor + 0.0f); h = mix(h, offset_units + 0.0f);
+		for (int i = 0; i < 4; i++) h = mix(h, color_writes[i]);
+		h = mix(h, scissoring);
+		h = mix_box(h, scissor_box);
+		h = mix_box(h, viewport_box);
+		return size_t(h);
+	}
+
+	/// Returns the immutable copy of this state shared by all equal states.
+	/// Interned states live until the program exits.
+	const render_state* intern() const
+	{
+		static std::mutex lock;
+		static std::unordered_set<render_state, hasher> states;
+		std::lock_guard<std::mutex> guard(lock);
+		const render_state* s = &*states.insert(*this).first;
+		s->interned = true;
+		return s;
+	}
+
+	/// Makes this state, which has to be interned, the current one of the
+	/// calling thread's context. Only fields that differ from the state
+	/// applied previously are sent to OpenGL. Capabilities go through the
+	/// context's capability cache, such that changes made by state scopes in
+	/// between are caught as well.
+	void apply() const
+	{
+		assert(interned && "render_state not interned");
+		context& ctx = context::current();
+		const render_state* prev = ctx.applied_render_state;
+		capability_cache& caps = ctx.capabilities;
+		clear_opengl_error();
+		caps.set(GL_BLEND, blending);
+		caps.set(GL_DEPTH_TEST, depth_testing);
+		caps.set(GL_CULL_FACE, culling);
+		caps.set(GL_POLYGON_OFFSET_FILL, offsetting);
+		caps.set(GL_SCISSOR_TEST, scissoring);
+		if (prev != this) {
+			// Unknown until the calls are known to have succeeded.
+			ctx.applied_render_state = NULL;
+			apply_fields(prev);
+		}
+		on_opengl_error(throw_on_apply_error);
+		ctx.applied_render_state = this;
+	}
+
+	static void throw_on_apply_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("render_state: failed to apply: a blend factor or equation, depth function or face is not an accepted value", err);
+			case GL_INVALID_VALUE: throw runtime_error("render_state: failed to apply: the scissor box or viewport has a negative size", err);
+			default: throw runtime_error("render_state: failed to apply", err);
+		}
+	}
+
+private:
+	/// Whether this is the copy returned by intern(). Copies of interned
+	/// states are not interned themselves, so the flag is not copied.
+	struct intern_mark
+	{
+		bool value;
+		intern_mark(bool value): value(value) {}
+		intern_mark(const intern_mark&): value(false) {}
+		intern_mark& operator=(const intern_mark&) { return *this; }
+		operator bool() const { return value; }
+		intern_mark& operator=(bool v) { value = v; return *this; }
+	};
+	mutable intern_mark interned;
+
+	/// Issues the calls for the fields other than capabilities that differ
+	/// from the given state, or all of them if it is NULL.
+	void apply_fields(const render_state* prev) const
+	{
+		if (blending) {
+			bool known = prev && prev->blending;
+			if (!known || src_rgb != prev->src_rgb || dst_rgb != prev->dst_rgb || src_alpha != prev->src_alpha || dst_alpha != prev->dst_alpha)
+				glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+			if (!known || equation_rgb != prev->equation_rgb || equation_alpha != prev->equation_alpha)
+				glBlendEquationSeparate(equation_rgb, equation_alpha);
+			if (!known || std::memcmp(constant, prev->constant, sizeof(constant)) != 0)
+				glBlendColor(constant[0], constant[1], constant[2], constant[3]);
+		}
+		if (!prev || depth_function != prev->depth_function) glDepthFunc(depth_function);
+		if (!prev || depth_writes != prev->depth_writes) glDepthMask(depth_writes);
+		if (!prev || culled_face != prev->culled_face) glCullFace(culled_face);
+		if (!prev || front_face != prev->front_face) glFrontFace(front_face);
+		if (!prev || offset_factor != prev->offset_factor || offset_units != prev->offset_units)
+			glPolygonOffset(offset_factor, offset_units);
+		if (!prev || std::memcmp(color_writes, prev->color_writes, sizeof(color_writes)) != 0)
+			glColorMask(color_writes[0], color_writes[1], color_writes[2], color_writes[3]);
+		if (scissor_box[2] >= 0 && (!prev || !same_box(scissor_box, prev->scissor_box)))
+			glScissor(scissor_box[0], scissor_box[1], scissor_box[2], scissor_box[3]);
+		if (viewport_box[2] >= 0 && (!prev || !same_box(viewport_box, prev->viewport_box)))
+			glViewport(viewport_box[0], viewport_box[1], viewport_box[2], viewport_box[3]);
+	}
+
+	struct hasher
+	{
+		size_t operator()(const render_state& s) const { return s.hash(); }
+	};
+
+	bool same_blend(const render_state& o) const
+	{
+		return src_rgb == o.src_rgb && dst_rgb == o.dst_rgb && src_alpha == o.src_alpha && dst_alpha == o.dst_alpha &&
+			equation_rgb == o.equation_rgb && equation_alpha == o.equation_alpha &&
+			std::memcmp(constant, o.constant, sizeof(constant)) == 0;
+	}
+
+	/// Boxes with a negative width are all equal, since they leave OpenGL's
+	/// box untouched.
+	static bool same_box(const GLint* a, const GLint* b)
+	{
+		if (a[2] < 0 || b[2] < 0) return a[2] < 0 && b[2] < 0;
+		return std::memcmp(a, b, 4 * sizeof(GLint)) == 0;
+	}
+
+	/// Mixes boxes with a negative width in as one value, since same_box()
+	/// treats them as equal.
+	static unsigned long long mix_box(unsigned long long h, const GLint* box)
+	{
+		if (box[2] < 0) return mix(h, GLint(-1));
+		for (int i = 0; i < 4; i++) h = mix(h, box[i]);
+		return h;
+	}
+
+	template <typename T> static unsigned long long mix(unsigned long long h, T value)
+	{
+		const unsigned char* p = (const unsigned char*)&value;
+		for (size_t i = 0; i < sizeof(T); i++)
+			h = (h ^ p[i]) * 1099511628211ull;
+		return h;
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_2_0
+	typedef gladus::render_state RenderState;
+	#endif
+}
@@ -0,0 +1,311 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/shader.hpp"
+#include "gladus/fence.hpp"
+// The loader requires EGL. GLADUS_HAS_EGL may be defined by the build, and is
+// otherwise defined if the EGL headers are found.
+#if !defined(GLADUS_HAS_EGL) && defined(__has_include)
+#	if __has_include(<EGL/egl.h>)
+#		define GLADUS_HAS_EGL
+#	endif
+#endif
+#ifdef GLADUS_HAS_EGL
+#	include <EGL/egl.h>
+#	include <EGL/eglext.h>
+#endif
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#define GLADUS_HAS_RESOURCE_LOADER
+
+namespace gladus {
+
+#if defined(GL_VERSION_3_2) && defined(GLADUS_HAS_EGL)
+struct resource_loader_statistics
+{
+	unsigned long submitted;
+	unsigned long delivered;
+	/// Jobs that threw on the worker thread.
+	unsigned long failed;
+	/// Largest number of jobs waiting for the worker at once.
+	size_t max_queue_depth;
+	/// Total time jobs spent waiting for the worker, running on it, and
+	/// between submission and delivery, in seconds.
+	double queue_seconds;
+	double work_seconds;
+	double latency_seconds;
+	double max_latency_seconds;
+
+	resource_loader_statistics(): submitted(0), delivered(0), failed(0), max_queue_depth(0), queue_seconds(0), work_seconds(0), latency_seconds(0), max_latency_seconds(0) {}
+};
+
+/// Creates OpenGL objects on a worker thread that owns an EGL context sharing
+/// its objects with the application's context, such that uploads and shader
+/// compilation do not stall the thread that renders. Jobs create an object on
+/// the worker; the worker then inserts a fence and flushes. poll(), called on
+/// the thread the application's context is current on, makes that context
+/// wait for the fence on the GPU and hands the object to the job's callback,
+/// so the object is complete before any command using it executes.
+///
+/// Only objects shared between contexts can be loaded, i.e. buffers,
+/// textures, shaders and programs, but not vertex arrays or framebuffers.
+/// Objects are handed over unbound; the shadow state of the application's
+/// context is not affected by the worker.
+///
+///     EGLint attribs[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5, EGL_NONE };
+///     resource_loader loader(display, main_context, attribs);
+///     loader.upload(GL_ARRAY_BUFFER, vertices, size, GL_STATIC_DRAW, [&](std::unique_ptr<buffer> b) { mesh.vbo = std::move(b); });
+///     // every frame
+///     loader.poll();
+struct resource_loader
+{
+	/// Creates the worker's context sharing objects with share, which is
+	/// typically the application's context, with the given attributes,
+	/// which should request the same version and profile as share. The
+	/// context is surfaceless, which requires EGL_KHR_surfaceless_context, and
+	/// created without a config unless one is given, which requires
+	/// EGL_KHR_no_config_context.
+	resource_loader(EGLDisplay display, EGLContext share, const EGLint* attribs, EGLConfig config = EGL_NO_CONFIG_KHR):
+		display(display), worker_context(EGL_NO_CONTEXT), running(true), started(false), start_failed(false), origin(std::chrono::steady_clock::now())
+	{
+		EGLenum api = eglQueryAPI();
+		eglBindAPI(EGL_OPENGL_API);
+		worker_context = eglCreateContext(display, config, share, attribs);
+		eglBindAPI(api);
+		if (worker_context == EGL_NO_CONTEXT)
+			throw runtime_error("resource_loader: failed to create context: the attributes or config are not supported, or share is not a context");
+		worker = std::thread(&resource_loader::run, this);
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, [this]{ return started; });
+		if (start_failed) {
+			guard.unlock();
+			worker.join();
+			eglDestroyContext(display, worker_context);
+			throw runtime_error("resource_loader: failed to make context current: surfaceless contexts are not supported");
+		}
+	}
+
+	/// Stops the worker. Jobs it has not run yet are dropped, objects of jobs
+	/// not delivered yet are deleted by the worker on its own context, so no
+	/// context has to be current on the calling thread.
+	~resource_loader()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			running = false;
+		}
+		wake.notify_one();
+		worker.join();
+		eglDestroyContext(display, worker_context);
+	}
+
+	resource_loader(const resource_loader&) = delete;
+	resource_loader& operator=(const resource_loader&) = delete;
+
+	/// Runs make on the worker thread and passes the object it returns to
+	/// done during a later poll(). May be called from any thread.
+	template <typename T> void load(std::function<std::unique_ptr<T>()> make, std::function<void(std::unique_ptr<T>)> done)
+	{
+		std::unique_ptr<job> j(new typed_job<T>(make, done));
+		j->submitted = now();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queued.push_back(std::move(j));
+			stats_.submitted++;
+			if (queued.size() > stats_.max_queue_depth) stats_.max_queue_depth = queued.size();
+		}
+		wake.notify_one();
+	}
+
+	/// Creates a buffer holding a copy of size bytes of data.
+	void upload(GLenum target, const GLvoid* data, GLsizeiptr size, GLenum usage, std::function<void(std::unique_ptr<buffer>)> done)
+	{
+		std::shared_ptr<std::vector<unsigned char> > copy(new std::vector<unsigned char>((const unsigned char*)data, (const unsigned char*)data + size));
+		load<buffer>([=]{
+			std::unique_ptr<buffer> b(new buffer(target));
+			b->data(size, copy->empty() ? NULL : &(*copy)[0], usage);
+			return b;
+		}, done);
+	}
+
+	/// Creates and compiles a shader. The callback should check
+	/// compile_result(), which no longer blocks by then.
+	void compile(GLenum type, const std::string& source, std::function<void(std::unique_ptr<shader>)> done)
+	{
+		load<shader>([=]{
+			std::unique_ptr<shader> s(new shader(type));
+			s->source(source.c_str(), source.size());
+			s->compile();
+			return s;
+		}, done);
+	}
+
+	/// Delivers the jobs the worker has finished to their callbacks, in
+	/// submission order. Has to be called on the thread the context shared
+	/// with is current on. If a job threw on the worker, its exception is
+	/// rethrown here; the remaining jobs are delivered by the next call.
+	/// Returns the number of jobs still pending.
+	size_t poll()
+	{
+		deliver(false);
+		return pending();
+	}
+
+	/// Blocks until all jobs submitted so far have been delivered.
+	void finish() { deliver(true); }
+
+	/// Jobs submitted but not delivered yet.
+	size_t pending() const
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return stats_.submitted - stats_.delivered;
+	}
+
+	/// Jobs waiting for the worker to pick them up.
+	size_t queue_depth() const
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return queued.size();
+	}
+
+	resource_loader_statistics stats() const
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return stats_;
+	}
+
+private:
+	struct job
+	{
+		double submitted;
+		fence done;
+		std::exception_ptr error;
+
+		virtual ~job() {}
+		virtual void make() = 0;
+		virtual void deliver() = 0;
+	};
+	template <typename T> struct typed_job : job
+	{
+		std::function<std::unique_ptr<T>()> maker;
+		std::function<void(std::unique_ptr<T>)> callback;
+		std::unique_ptr<T> object;
+
+		typed_job(std::function<std::unique_ptr<T>()> maker, std::function<void(std::unique_ptr<T>)> callback): maker(maker), callback(callback) {}
+
+		void make() { object = maker(); }
+		void deliver() { if (callback) callback(std::move(object)); }
+	};
+
+	EGLDisplay display;
+	EGLContext worker_context;
+	std::thread worker;
+	mutable std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable changed;
+	std::deque<std::unique_ptr<job> > queued;
+	std::deque<std::unique_ptr<job> > finished;
+	resource_loader_statistics stats_;
+	bool running;
+	bool started;
+	bool start_failed;
+	std::chrono::steady_clock::time_point origin;
+
+	double now() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count(); }
+
+	void run()
+	{
+		eglBindAPI(EGL_OPENGL_API);
+		bool current = eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, worker_context);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			started = true;
+			start_failed = !current;
+		}
+		changed.notify_all();
+		if (!current) return;
+
+		context ctx;
+		ctx.make_current();
+		ctx.set_proc_address_loader((context::proc_address_loader)eglGetProcAddress);
+
+		std::unique_lock<std::mutex> guard(lock);
+		for (;;) {
+			wake.wait(guard, [this]{ return !running || !queued.empty(); });
+			if (!running) break;
+			std::unique_ptr<job> j(std::move(queued.front()));
+			queued.pop_front();
+			guard.unlock();
+
+			double start = now();
+			try {
+				j->make();
+				j->done.insert();
+			} catch (...) {
+				j->error = std::current_exception();
+			}
+			// The fence only reaches the GPU, and other contexts can only wait
+			// for it without hanging, once the command stream is flushed.
+			glFlush();
+			double end = now();
+
+			guard.lock();
+			stats_.queue_seconds += start - j->submitted;
+			stats_.work_seconds += end - start;
+			if (j->error) stats_.failed++;
+			finished.push_back(std::move(j));
+			changed.notify_all();
+		}
+		// Undelivered objects and their fences are deleted while the worker's
+		// context is still current.
+		std::deque<std::unique_ptr<job> > dropped, undelivered;
+		dropped.swap(queued);
+		undelivered.swap(finished);
+		guard.unlock();
+		dropped.clear();
+		undelivered.clear();
+		context::release_current();
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+
+	void deliver(bool wait)
+	{
+		for (;;) {
+			std::unique_ptr<job> j;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				if (wait) changed.wait(guard, [this]{ return !finished.empty() || stats_.submitted == stats_.delivered + finished.size(); });
+				if (finished.empty()) return;
+				j = std::move(finished.front());
+				finished.pop_front();
+				double latency = now() - j->submitted;
+				stats_.delivered++;
+				stats_.latency_seconds += latency;
+				if (latency > stats_.max_latency_seconds) stats_.max_latency_seconds = latency;
+			}
+			if (j->error) std::rethrow_exception(j->error);
+			j->done.server_wait();
+			j->deliver();
+		}
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#if defined(GL_VERSION_3_2) && defined(GLADUS_HAS_EGL)
+	typedef gladus::resource_loader ResourceLoader;
+	#endif
+}
@@ -0,0 +1,365 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/texture.hpp"
+#include "gladus/fence.hpp"
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#define GLADUS_HAS_RESOURCE_POOL
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+struct resource_pool_statistics
+{
+	/// Objects handed out, and how many of them were recycled rather than
+	/// allocated anew.
+	unsigned long acquired;
+	unsigned long hits;
+	unsigned long released;
+	/// Names generated, and the glGen*/glCreate* calls that generated them.
+	unsigned long names_generated;
+	unsigned long generate_calls;
+	/// Names deleted, and the glDelete* calls that deleted them.
+	unsigned long names_deleted;
+	unsigned long delete_calls;
+
+	resource_pool_statistics(): acquired(0), hits(0), released(0), names_generated(0), generate_calls(0), names_deleted(0), delete_calls(0) {}
+
+	double hit_rate() const { return acquired ? double(hits) / acquired : 0; }
+	unsigned long misses() const { return acquired - hits; }
+};
+
+/// Names of buffers or textures generated block_size at a time, such that
+/// allocating a run of objects costs one glGen* or glCreate* call rather than
+/// one per object. Under direct state access the names are created as
+/// objects right away, which for textures fixes their target.
+struct name_reserve
+{
+	enum kind { buffers, textures };
+
+	kind type;
+	GLenum target;
+	GLsizei block_size;
+
+	name_reserve(kind type, GLenum target, GLsizei block_size): type(type), target(target), block_size(block_size) { assert(block_size > 0); }
+	~name_reserve() { if (!names.empty()) delete_names(type, names); }
+
+	name_reserve(const name_reserve&) = delete;
+	name_reserve& operator=(const name_reserve&) = delete;
+
+	GLuint take(resource_pool_statistics& stats)
+	{
+		if (names.empty()) {
+			names.resize(block_size);
+			bool dsa = context::current().supports_direct_state_access();
+			#ifdef GL_VERSION_4_5
+			if (dsa && type == buffers) glCreateBuffers(block_size, &names[0]);
+			else if (dsa) glCreateTextures(target, block_size, &names[0]);
+			else
+			#endif
+			if (type == buffers) glGenBuffers(block_size, &names[0]);
+			else glGenTextures(block_size, &names[0]);
+			(void)dsa;
+			throw_on_opengl_error();
+			stats.names_generated += block_size;
+			stats.generate_calls++;
+		}
+		GLuint name = names.back();
+		names.pop_back();
+		return name;
+	}
+
+	size_t available() const { return names.size(); }
+
+	/// Deletes the names with a single call and drops them from the binding
+	/// cache.
+	static void delete_names(kind type, const std::vector<GLuint>& names)
+	{
+		binding_cache& cache = context::current().bindings;
+		if (type == buffers) {
+			glDeleteBuffers(names.size(), &names[0]);
+			for (size_t i = 0; i < names.size(); i++) cache.forget_buffer(names[i]);
+		} else {
+			glDeleteTextures(names.size(), &names[0]);
+			for (size_t i = 0; i < names.size(); i++) cache.forget_texture(names[i]);
+		}
+	}
+
+private:
+	std::vector<GLuint> names;
+};
+
+/// Released objects waiting to be recycled or deleted, oldest first. An
+/// object is reused for an acquisition of the same key, or deleted, only once
+/// the fence inserted upon its release has signaled, i.e. the GPU no longer
+/// reads from it. Beyond high_water_mark idle objects the oldest ones are
+/// deleted. The bin also knows the key of every object of its pool that
+/// exists, such that released objects can be told apart from foreign ones.
+template <typename Key> struct recycle_bin
+{
+	size_t high_water_mark;
+
+	recycle_bin(name_reserve::kind type, size_t high_water_mark): high_water_mark(high_water_mark), type(type) {}
+	~recycle_bin()
+	{
+		std::vector<GLuint> names;
+		for (size_t i = 0; i < idle.size(); i++) names.push_back(idle[i].name);
+		for (size_t i = 0; i < doomed.size(); i++) names.push_back(doomed[i].name);
+		if (!names.empty()) name_reserve::delete_names(type, names);
+	}
+
+	recycle_bin(const recycle_bin&) = delete;
+	recycle_bin& operator=(const recycle_bin&) = delete;
+
+	/// Notes that an object of the given key was created under a name.
+	void adopt(const Key& key, GLuint name) { owned[name] = key; }
+
+	/// The key of an object of the pool, or NULL if the name is not one.
+	const Key* owner(GLuint name) const
+	{
+		typename std::unordered_map<GLuint, Key>::const_iterator it = owned.find(name);
+		return it != owned.end() ? &it->second : NULL;
+	}
+
+	/// Returns the name of an idle object of the given key the GPU is done
+	/// with, or 0.
+	GLuint take(const Key& key)
+	{
+		for (size_t i = 0; i < idle.size(); i++) {
+			if (!(idle[i].key == key) || !idle[i].done.signaled()) continue;
+			GLuint name = idle[i].name;
+			idle.erase(idle.begin() + i);
+			return name;
+		}
+		return 0;
+	}
+
+	void put(const Key& key, GLuint name, resource_pool_statistics& stats)
+	{
+		idle.push_back(entry());
+		idle.back().key = key;
+		idle.back().name = name;
+		idle.back().done.insert();
+		while (idle.size() > high_water_mark) {
+			doomed.push_back(std::move(idle.front()));
+			idle.pop_front();
+		}
+		collect(stats);
+	}
+
+	/// Deletes the objects beyond the high-water mark the GPU is done with.
+	void collect(resource_pool_statistics& stats)
+	{
+		std::vector<GLuint> names;
+		while (!doomed.empty() && doomed.front().done.signaled()) {
+			names.push_back(doomed.front().name);
+			owned.erase(doomed.front().name);
+			doomed.pop_front();
+		}
+		if (names.empty()) return;
+		name_reserve::delete_names(type, names);
+		stats.names_deleted += names.size();
+		stats.delete_calls++;
+	}
+
+	size_t size() const { return idle.size(); }
+
+private:
+	struct entry
+	{
+		Key key;
+		GLuint name;
+		fence done;
+	};
+
+	name_reserve::kind type;
+	std::deque<entry> idle;
+	std::deque<entry> doomed;
+	/// Key of every name handed out and not deleted yet. Names are erased
+	/// as they are deleted, since OpenGL may hand them out again to objects
+	/// outside the pool. Objects destroyed by their user rather than
+	/// released are not noticed, so acquired objects must be released.
+	std::unordered_map<GLuint, Key> owned;
+};
+
+/// Hands out buffers whose names are generated in blocks, and recycles
+/// released buffers for later acquisitions of the same size and usage
+/// instead of deleting them. Recycled buffers keep the contents their
+/// previous user left.
+///
+///     std::unique_ptr<buffer> b = pool.acquire(GL_ARRAY_BUFFER, 4096, GL_STREAM_DRAW);
+///     ...
+///     pool.release(std::move(b));
+struct buffer_pool
+{
+	resource_pool_statistics stats;
+
+	explicit buffer_pool(size_t high_water_mark = 64, GLsizei block_size = 32): names(name_reserve::buffers, 0, block_size), bin(name_reserve::buffers, high_water_mark) {}
+
+	buffer_pool(const buffer_pool&) = delete;
+	buffer_pool& operator=(const buffer_pool&) = delete;
+
+	std::unique_ptr<buffer> acquire(GLenum target, GLsizeiptr size, GLenum usage)
+	{
+		key k = { size, usage };
+		stats.acquired++;
+		GLuint name = bin.take(k);
+		if (name) {
+			stats.hits++;
+			return std::unique_ptr<buffer>(new buffer(target, name));
+		}
+		std::unique_ptr<buffer> b(new buffer(target, names.take(stats)));
+		b->data(size, NULL, usage);
+		bin.adopt(k, b->id);
+		return b;
+	}
+
+	/// Takes back a buffer acquired from this pool.
+	void release(std::unique_ptr<buffer> b)
+	{
+		if (!b) return;
+		const key* k = bin.owner(b->id);
+		assert(k && "buffer not acquired from this pool");
+		if (b->mapped_data) b->unmap();
+		GLuint name = b->id;
+		b->id = 0;
+		stats.released++;
+		bin.put(*k, name, stats);
+	}
+
+	/// Deletes buffers beyond the high-water mark the GPU is done with.
+	void collect() { bin.collect(stats); }
+
+	void set_high_water_mark(size_t n) { bin.high_water_mark = n; }
+	size_t idle() const { return bin.size(); }
+
+private:
+	struct key
+	{
+		GLsizeiptr size;
+		GLenum usage;
+		bool operator==(const key& o) const { return size == o.size && usage == o.usage; }
+	};
+
+	name_reserve names;
+	recycle_bin<key> bin;
+};
+#endif
+
+#ifdef GL_VERSION_4_2
+/// Hands out textures with immutable storage whose names are generated in
+/// blocks, and recycles released textures for later acquisitions of the same
+/// target, internal format, number of levels and size instead of deleting
+/// them. Recycled textures keep the contents and parameters their previous
+/// user left.
+struct texture_pool
+{
+	resource_pool_statistics stats;
+
+	explicit texture_pool(size_t high_water_mark = 32, GLsizei block_size = 16): block_size(block_size), bin(name_reserve::textures, high_water_mark) {}
+
+	texture_pool(const texture_pool&) = delete;
+	texture_pool& operator=(const texture_pool&) = delete;
+
+	/// Acquires a texture of the given target, e.g. GL_TEXTURE_2D, with the
+	/// given storage. height and depth are ignored for targets with fewer
+	/// dimensions.
+	std::unique_ptr<texture> acquire(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height = 1, GLsizei depth = 1)
+	{
+		int dims = dimensions(target);
+		key k = { target, internal_format, levels, width, dims > 1 ? height : 1, dims > 2 ? depth : 1 };
+		stats.acquired++;
+		GLuint name = bin.take(k);
+		if (name) {
+			stats.hits++;
+			return std::unique_ptr<texture>(new texture(target, name));
+		}
+		std::unique_ptr<texture> t(new texture(target, reserve(target).take(stats)));
+		extent size = { k.width, k.height, k.depth };
+		if (dims == 1) t->storage1d(levels, internal_format, width);
+		else if (dims == 2) t->storage2d(levels, internal_format, size);
+		else t->storage3d(levels, internal_format, size);
+		bin.adopt(k, t->id);
+		return t;
+	}
+
+	/// Takes back a texture acquired from this pool.
+	void release(std::unique_ptr<texture> t)
+	{
+		if (!t) return;
+		const key* k = bin.owner(t->id);
+		assert(k && "texture not acquired from this pool");
+		GLuint name = t->id;
+		t->id = 0;
+		stats.released++;
+		bin.put(*k, name, stats);
+	}
+
+	/// Deletes textures beyond the high-water mark the GPU is done with.
+	void collect() { bin.collect(stats); }
+
+	void set_high_water_mark(size_t n) { bin.high_water_mark = n; }
+	size_t idle() const { return bin.size(); }
+
+	/// Number of dimensions of the storage of textures of the given target.
+	static int dimensions(GLenum target)
+	{
+		switch (target) {
+			case GL_TEXTURE_1D: return 1;
+			case GL_TEXTURE_3D:
+			case GL_TEXTURE_2D_ARRAY:
+			case GL_TEXTURE_CUBE_MAP_ARRAY: return 3;
+			default: return 2;
+		}
+	}
+
+private:
+	struct key
+	{
+		GLenum target;
+		GLenum internal_format;
+		GLsizei levels;
+		GLsizei width, height, depth;
+		bool operator==(const key& o) const
+		{
+			return target == o.target && internal_format == o.internal_format && levels == o.levels &&
+				width == o.width && height == o.height && depth == o.depth;
+		}
+	};
+	struct extent
+	{
+		GLsizei x, y, z;
+	};
+
+	GLsizei block_size;
+	/// One reserve per target, since names created through direct state
+	/// access have a fixed target.
+	std::deque<name_reserve> reserves;
+	recycle_bin<key> bin;
+
+	name_reserve& reserve(GLenum target)
+	{
+		for (size_t i = 0; i < reserves.size(); i++)
+			if (reserves[i].target == target) return reserves[i];
+		reserves.emplace_back(name_reserve::textures, target, block_size);
+		return reserves.back();
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_2
+	typedef gladus::buffer_pool BufferPool;
+	#endif
+	#ifdef GL_VERSION_4_2
+	typedef gladus::texture_pool TexturePool;
+	#endif
+}
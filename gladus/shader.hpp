@@ -1,11 +1,17 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
 #include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include <cassert>
 #include <string>
 #include <vector>
 #include <istream>
 #define GLADUS_HAS_SHADER
 
+#ifndef GL_COMPLETION_STATUS_KHR
+#	define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace gladus {
 
 /// Result of a shader compilation. If success is false, the shader's info log
@@ -30,7 +36,21 @@ struct shader
 
 	shader(GLenum type): id(0), type(type) { id = glCreateShader(type); throw_on_opengl_error(); }
 	shader(GLenum type, GLuint id): id(id), type(type) {}
-	~shader() { if (id > 0) glDeleteShader(id); throw_on_opengl_error(); }
+	shader(shader&& other) noexcept: id(other.id), type(other.type) { other.id = 0; }
+	~shader() { if (id > 0) { glDeleteShader(id); throw_on_opengl_error(); } }
+
+	/// Deletes the shader and takes over the other shader's name.
+	shader& operator=(shader&& other) noexcept
+	{
+		if (this == &other) return *this;
+		if (id > 0) glDeleteShader(id);
+		id = other.id; type = other.type;
+		other.id = 0;
+		return *this;
+	}
+
+	shader(const shader&) = delete;
+	shader& operator=(const shader&) = delete;
 
 	operator GLuint() const { return id; }
 
@@ -39,12 +59,7 @@ struct shader
 		assert(id > 0);
 		clear_opengl_error();
 		glShaderSource(id, 1, &src, &length);
-		incase_opengl_error(err) {
-			case GL_INVALID_OPERATION: throw runtime_error("shader: failed to assign source: 'id' is not a shader", err);
-			case GL_INVALID_VALUE: throw runtime_error("shader: failed to assign source: 'id' is not a previously created shader", err);
-			case GL_INVALID_ENUM: throw runtime_error("shader: failed to assign source: 'type' is not one of the allowed values", err);
-			default: throw err;
-		}
+		on_opengl_error(throw_on_source_error);
 	}
 	void source(std::istream& is) const
 	{
@@ -53,27 +68,63 @@ struct shader
 	}
 
 	shader_compile_result compile() const
+	{
+		start_compile();
+		return compile_result();
+	}
+
+	/// Hands the shader to the compiler without waiting for the outcome. See
+	/// compile_ready() and compile_result().
+	void start_compile() const
 	{
 		assert(id > 0);
 		clear_opengl_error();
 		glCompileShader(id);
-		incase_opengl_error(err) {
-			case GL_INVALID_VALUE: throw runtime_error("shader: failed to compile: 'id' is not a previously created shader", err);
-			case GL_INVALID_OPERATION: throw runtime_error("shader: failed to compile: 'id' is not a shader", err);
-			default: throw err;
-		}
+		on_opengl_error(throw_on_compile_error);
+	}
 
+	/// Whether compile_result() can be called without blocking. Always true
+	/// unless the context supports parallel shader compilation.
+	bool compile_ready() const
+	{
+		if (!context::current().supports_parallel_shader_compile()) return true;
+		GLint done = GL_TRUE;
+		glGetShaderiv(id, GL_COMPLETION_STATUS_KHR, &done);
+		return done;
+	}
+
+	/// Waits for the compiler and returns its outcome.
+	shader_compile_result compile_result() const
+	{
 		GLint success;
 		glGetShaderiv(id, GL_COMPILE_STATUS, &success);
 		if (!success) {
 			GLint length;
 			glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-			std::vector<GLchar> info; info.resize(length);
+			std::vector<GLchar> info; info.resize(length > 0 ? length : 1);
 			glGetShaderInfoLog(id, info.size(), NULL, &info[0]);
 			return shader_compile_result(false, &info[0]);
 		}
 		return shader_compile_result(true);
 	}
+
+	static void throw_on_source_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_OPERATION: throw runtime_error("shader: failed to assign source: 'id' is not a shader", err);
+			case GL_INVALID_VALUE: throw runtime_error("shader: failed to assign source: 'id' is not a previously created shader", err);
+			case GL_INVALID_ENUM: throw runtime_error("shader: failed to assign source: 'type' is not one of the allowed values", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_compile_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("shader: failed to compile: 'id' is not a previously created shader", err);
+			case GL_INVALID_OPERATION: throw runtime_error("shader: failed to compile: 'id' is not a shader", err);
+			default: throw err;
+		}
+	}
 };
 
 } // namespace gladus
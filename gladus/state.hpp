@@ -1,55 +1,68 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
-#include <map>
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
 #define GLADUS_HAS_STATE
 
+#ifndef GLADUS_MAX_UNTRACKED_CAPABILITIES
+#	define GLADUS_MAX_UNTRACKED_CAPABILITIES 4
+#endif
+
 namespace gladus {
 
 /// This structure maintains changes to OpenGL's capabilities normally done via
 /// glEnable() and glDisable(). Upon destruction, this class reverts all changes
 /// that were made to the OpenGL capabilities. Hence this class provides an
 /// exception-safe way of configuring OpenGL for your needs.
+///
+/// Changes go through the capability cache of the current context, such that
+/// setting a capability to the value it already has reaches OpenGL neither as
+/// a glIsEnabled() query nor as a glEnable() or glDisable() call. Each scope
+/// saves the prior value of the capabilities it touches in a fixed-size
+/// bitset, so nested scopes form a stack without allocating memory, and
+/// reset() only issues calls for capabilities whose value actually differs.
+/// Up to GLADUS_MAX_UNTRACKED_CAPABILITIES capabilities unknown to the cache
+/// may be changed per scope.
 struct state
 {
-	struct capability
-	{
-		unsigned initial:1;
-		unsigned modified:1;
-	};
-	typedef std::map<GLenum, capability> capability_map;
-	capability_map changes;
-
+	state(): num_untracked(0) {}
 	~state() { reset(); }
 
+	state(const state&) = delete;
+	state& operator=(const state&) = delete;
+
 	inline state& enable(GLenum cap)  { set(cap, true);  return *this; }
 	inline state& disable(GLenum cap) { set(cap, false); return *this; }
 
 	state& set(GLenum cap, bool onoff)
 	{
-		capability_map::iterator it = changes.find(cap);
-		if (it == changes.end()) {
-			capability& c = changes[cap];
-			c.initial = glIsEnabled(cap);
-			c.modified = onoff;
-			if (onoff) glEnable(cap); else glDisable(cap);
-		} else if (it->second.modified != onoff) {
-			it->second.modified = onoff;
-			if (onoff) glEnable(cap); else glDisable(cap);
+		capability_cache& caps = context::current().capabilities;
+		int i = capability_cache::index(cap);
+		if (i >= 0) {
+			if (!touched[i]) {
+				initial[i] = caps.enabled(cap);
+				touched[i] = true;
+			}
+		} else {
+			save_untracked(cap, caps);
 		}
+		caps.set(cap, onoff);
 		return *this;
 	}
 
 	state& reset()
 	{
-		for (capability_map::iterator it = changes.begin(); it != changes.end(); it++) {
-			if (it->second.initial != it->second.modified) {
-				if (it->second.initial)
-					glEnable(it->first);
-				else
-					glDisable(it->first);
-			}
+		capability_cache& caps = context::current().capabilities;
+		static_assert(capability_cache::num_capabilities <= 64, "touched capabilities do not fit a 64-bit word");
+		for (unsigned long long bits = touched.to_ullong(); bits; ) {
+			int i = lowest_bit(bits);
+			caps.set(capability_cache::capability(i), initial[i]);
+			bits &= bits - 1;
 		}
-		changes.clear();
+		for (int i = 0; i < num_untracked; i++)
+			caps.set(untracked[i].cap, untracked[i].initial);
+		touched.reset();
+		num_untracked = 0;
 		return *this;
 	}
 
@@ -57,11 +70,49 @@ struct state
 	 * have performed so far. */
 	state& base()
 	{
-		for (capability_map::iterator it = changes.begin(); it != changes.end(); it++) {
-			it->second.initial = it->second.modified;
-		}
+		touched.reset();
+		num_untracked = 0;
 		return *this;
 	}
+
+private:
+	struct untracked_capability
+	{
+		GLenum cap;
+		bool initial;
+	};
+
+	std::bitset<capability_cache::num_capabilities> touched;
+	std::bitset<capability_cache::num_capabilities> initial;
+	untracked_capability untracked[GLADUS_MAX_UNTRACKED_CAPABILITIES];
+	int num_untracked;
+
+	void save_untracked(GLenum cap, capability_cache& caps)
+	{
+		for (int i = 0; i < num_untracked; i++)
+			if (untracked[i].cap == cap) return;
+		if (num_untracked == GLADUS_MAX_UNTRACKED_CAPABILITIES)
+			throw runtime_error("state: failed to set capability: too many capabilities unknown to the cache, raise GLADUS_MAX_UNTRACKED_CAPABILITIES");
+		untracked[num_untracked].cap = cap;
+		untracked[num_untracked].initial = caps.enabled(cap);
+		num_untracked++;
+	}
+
+	/// Index of the lowest set bit, which has to exist.
+	static int lowest_bit(unsigned long long bits)
+	{
+		#if defined(__GNUC__)
+		return __builtin_ctzll(bits);
+		#else
+		int i = 0;
+		while (!(bits & 1)) { bits >>= 1; i++; }
+		return i;
+		#endif
+	}
 };
 
 } // namespace gladus
+
+namespace gl {
+	typedef gladus::state State;
+}
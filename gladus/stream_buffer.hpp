@@ -0,0 +1,182 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/fence.hpp"
+#include <deque>
+#include <vector>
+#define GLADUS_HAS_STREAM_BUFFER
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+/// A region of a stream_buffer handed out by allocate(). The data written to
+/// pointer becomes available to OpenGL at offset within the buffer.
+struct stream_allocation
+{
+	GLintptr offset;
+	GLsizeiptr size;
+	void* pointer;
+
+	stream_allocation(): offset(0), size(0), pointer(NULL) {}
+	stream_allocation(GLintptr offset, GLsizeiptr size, void* pointer): offset(offset), size(size), pointer(pointer) {}
+};
+
+struct stream_statistics
+{
+	unsigned long allocations;
+	unsigned long long bytes;
+	unsigned long frames;
+	/// Number of allocations that had to wait for the GPU to release the
+	/// memory they overlap. Should stay at zero if the buffer is large enough
+	/// for the number of frames in flight.
+	unsigned long stalls;
+
+	stream_statistics(): allocations(0), bytes(0), frames(0), stalls(0) {}
+};
+
+/// A ring buffer for data that is rewritten every frame, such as dynamic
+/// vertices or uniform blocks. Allocations are carved out of one
+/// gladus::buffer in order. At the end of each frame a fence is placed behind
+/// the frame's allocations; an allocation that would overwrite memory of a
+/// frame the GPU has not finished yet waits for that frame's fence.
+///
+/// If the context supports ARB_buffer_storage the buffer is mapped once,
+/// persistently and coherently. Otherwise each allocation maps its range
+/// with GL_MAP_UNSYNCHRONIZED_BIT. In either case the pointer of an
+/// allocation is only valid until the next call to allocate(), commit() or
+/// end_frame(); call commit() before issuing commands that read the data.
+struct stream_buffer
+{
+	gladus::buffer storage;
+	GLsizeiptr size;
+	GLsizeiptr alignment;
+	bool persistent;
+	stream_statistics stats;
+
+	stream_buffer(GLenum target, GLsizeiptr size, GLsizeiptr alignment = 1): storage(target), size(size), alignment(alignment), persistent(false), base(NULL), head(0), piece_begin(0)
+	{
+		assert(size > 0);
+		assert(alignment > 0);
+		#ifdef GL_VERSION_4_4
+		const extensions& e = context::current().features();
+		if (e.version(4,4) || e.has("GL_ARB_buffer_storage")) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			storage.storage(size, NULL, flags);
+			base = (GLubyte*)storage.map_range(0, size, flags);
+			persistent = true;
+			return;
+		}
+		#endif
+		storage.data(size, NULL, GL_STREAM_DRAW);
+	}
+
+	stream_allocation allocate(GLsizeiptr n) { return allocate(n, alignment); }
+
+	/// Reserves n bytes whose offset is a multiple of align.
+	stream_allocation allocate(GLsizeiptr n, GLsizeiptr align)
+	{
+		assert(align > 0);
+		if (n > size)
+			throw runtime_error("stream_buffer: failed to allocate: 'n' exceeds the size of the buffer");
+		commit();
+
+		GLintptr offset = (head + align - 1) / align * align;
+		if (offset + n > size) {
+			close_piece();
+			piece_begin = 0;
+			offset = 0;
+		}
+		for (size_t i = 0; i < frame_pieces.size(); i++) {
+			if (frame_pieces[i].overlaps(offset, offset + n))
+				throw runtime_error("stream_buffer: failed to allocate: the current frame already occupies the entire buffer");
+		}
+		reclaim(offset, offset + n);
+		head = offset + n;
+
+		stats.allocations++;
+		stats.bytes += n;
+		if (persistent)
+			return stream_allocation(offset, n, base + offset);
+		void* p = storage.map_range(offset, n, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		return stream_allocation(offset, n, p);
+	}
+
+	/// Makes the data written to the last allocation available to OpenGL.
+	/// A no-op for persistently mapped buffers.
+	void commit()
+	{
+		if (!persistent && storage.mapped_data)
+			storage.unmap();
+	}
+
+	/// Fences the allocations made since the previous call, such that their
+	/// memory is not handed out again before the GPU is done with it.
+	void end_frame()
+	{
+		commit();
+		close_piece();
+		piece_begin = head;
+		stats.frames++;
+		if (frame_pieces.empty())
+			return;
+		in_flight.push_back(frame());
+		in_flight.back().pieces.swap(frame_pieces);
+		in_flight.back().done.insert();
+	}
+
+private:
+	struct piece
+	{
+		GLintptr begin, end;
+		piece(GLintptr begin, GLintptr end): begin(begin), end(end) {}
+		bool overlaps(GLintptr b, GLintptr e) const { return b < end && begin < e; }
+	};
+	struct frame
+	{
+		std::vector<piece> pieces;
+		fence done;
+		bool overlaps(GLintptr b, GLintptr e) const
+		{
+			for (size_t i = 0; i < pieces.size(); i++)
+				if (pieces[i].overlaps(b, e)) return true;
+			return false;
+		}
+	};
+
+	GLubyte* base;
+	GLintptr head;
+	GLintptr piece_begin;
+	std::vector<piece> frame_pieces;
+	std::deque<frame> in_flight;
+
+	void close_piece()
+	{
+		if (head > piece_begin)
+			frame_pieces.push_back(piece(piece_begin, head));
+	}
+
+	/// Waits for the newest in-flight frame that overlaps the given range and
+	/// retires it together with all older frames, since fences signal in
+	/// order.
+	void reclaim(GLintptr b, GLintptr e)
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < in_flight.size(); i++)
+			if (in_flight[i].overlaps(b, e)) n = i+1;
+		if (n == 0) return;
+		if (in_flight[n-1].done.wait())
+			stats.stalls++;
+		in_flight.erase(in_flight.begin(), in_flight.begin() + n);
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_2
+	typedef gladus::stream_buffer StreamBuffer;
+	#endif
+}
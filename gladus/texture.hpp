@@ -22,6 +22,81 @@ struct texture_data
 	template<typename T> texture_data(GLenum format, GLenum type, GLint alignment, const T& data): format(format), type(type), alignment(alignment), data(data) {}
 };
 
+/// Description of a memory region containing block-compressed texture data,
+/// e.g. BC1-7 (S3TC, RGTC, BPTC) or ETC2/EAC. size is the number of bytes of
+/// the region, which compressed_size() computes from the format and the
+/// extent of the image.
+struct compressed_texture_data
+{
+	GLenum format;
+	GLsizei size;
+	const GLvoid* data;
+
+	compressed_texture_data(): format(0), size(0), data(NULL) {}
+	template<typename T> compressed_texture_data(GLenum format, GLsizei size, const T& data): format(format), size(size), data(data) {}
+
+	/// Bytes of one 4x4 block of the given format, or 0 if the format is
+	/// not known.
+	static GLsizei block_size(GLenum format)
+	{
+		switch (format) {
+			#ifdef GL_EXT_texture_compression_s3tc
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+				return 8;
+			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				return 16;
+			#endif
+			#ifdef GL_EXT_texture_sRGB
+			case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+				return 8;
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+				return 16;
+			#endif
+			#ifdef GL_VERSION_3_0
+			case GL_COMPRESSED_RED_RGTC1:
+			case GL_COMPRESSED_SIGNED_RED_RGTC1:
+				return 8;
+			case GL_COMPRESSED_RG_RGTC2:
+			case GL_COMPRESSED_SIGNED_RG_RGTC2:
+				return 16;
+			#endif
+			#ifdef GL_VERSION_4_2
+			case GL_COMPRESSED_RGBA_BPTC_UNORM:
+			case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+			case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+				return 16;
+			#endif
+			#ifdef GL_VERSION_4_3
+			case GL_COMPRESSED_RGB8_ETC2:
+			case GL_COMPRESSED_SRGB8_ETC2:
+			case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_R11_EAC:
+			case GL_COMPRESSED_SIGNED_R11_EAC:
+				return 8;
+			case GL_COMPRESSED_RGBA8_ETC2_EAC:
+			case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+			case GL_COMPRESSED_RG11_EAC:
+			case GL_COMPRESSED_SIGNED_RG11_EAC:
+				return 16;
+			#endif
+			default: return 0;
+		}
+	}
+
+	/// Bytes of an image of the given extent in the given format. Partial
+	/// blocks at the edges count as whole ones.
+	static GLsizei compressed_size(GLenum format, GLsizei width, GLsizei height = 1, GLsizei depth = 1)
+	{
+		return ((width + 3) / 4) * ((height + 3) / 4) * depth * block_size(format);
+	}
+};
+
 /// Description of a texture image. This includes the MIP-level, internal
 /// representation, and the size of the image. Note that the size is of generic
 /// type to allow for different texture dimensions.
@@ -33,6 +108,20 @@ template<typename S> struct texture_image
 
 	texture_image(): level(0), internal_format(0), size() {}
 	texture_image(GLint level, GLint internal_format, const S& size): level(level), internal_format(internal_format), size(size) {}
+
+	/// Extent of the given MIP-level of an image that is extent texels wide
+	/// at level 0.
+	static GLsizei level_extent(GLsizei extent, GLint level) { extent >>= level; return extent > 0 ? extent : 1; }
+
+	/// Number of levels of a complete MIP chain down to 1x1x1.
+	static GLsizei max_levels(GLsizei width, GLsizei height = 1, GLsizei depth = 1)
+	{
+		GLsizei extent = width > height ? width : height;
+		if (depth > extent) extent = depth;
+		GLsizei levels = 1;
+		while (extent >>= 1) levels++;
+		return levels;
+	}
 };
 
 /// Description of a subregion of a texture image. This includes the MIP-level,
@@ -56,84 +145,245 @@ struct texture
 	GLuint id;
 
 	texture(): target(0) { glGenTextures(1, &id); }
-	explicit texture(GLenum target): target(target) { glGenTextures(1, &id); }
+	explicit texture(GLenum target): target(target) { generate(); }
 	explicit texture(GLenum target, GLuint id): target(target), id(id) {}
-	~texture() { if (id > 0) glDeleteTextures(1, &id); }
+	texture(texture&& other) noexcept: target(other.target), id(other.id) { other.id = 0; }
+	~texture() { if (id > 0) { glDeleteTextures(1, &id); context::current().bindings.forget_texture(id); } }
+
+	/// Deletes the texture's name and takes over the other texture's.
+	texture& operator=(texture&& other) noexcept
+	{
+		if (this == &other) return *this;
+		if (id > 0) { glDeleteTextures(1, &id); context::current().bindings.forget_texture(id); }
+		target = other.target; id = other.id;
+		other.id = 0;
+		return *this;
+	}
+
+	texture(const texture&) = delete;
+	texture& operator=(const texture&) = delete;
 
 	operator GLuint() const { return id; }
 
 	void bind() const
 	{
-		assert(target > 0);
 		assert(id > 0 && "texture has no name");
-		clear_opengl_error();
-		glBindTexture(target, id);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("texture: failed to bind: 'target' is not one of the allowed values", err);
-			case GL_INVALID_VALUE: throw runtime_error("texture: failed to bind: 'id' is not a previously allocated texture name", err);
-			case GL_INVALID_OPERATION: throw runtime_error("texture: failed to bind: texture was previously created with another target", err);
-			default: throw err;
-		}
-	}
-	void unbind() const
-	{
-		assert(target > 0);
-		clear_opengl_error();
-		glBindTexture(target, 0);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("texture: failed to unbind: 'target' is not one of the allowed values", err);
-			default: throw err;
-		}
+		bind_name(id, throw_on_bind_error);
 	}
+	void unbind() const { bind_name(0, throw_on_unbind_error); }
+
+	/// Binds the texture to the given texture unit, which also becomes the
+	/// active unit.
+	void bind(GLuint unit) const { active_texture(unit); bind(); }
+
+	GLuint current_binding() const { return context::current().bindings.texture(target); }
+	void restore_binding(GLuint name) const { bind_name(name, throw_on_bind_error); }
 
 	void set_wrap_params(GLenum wrap = GL_REPEAT) { set_wrap_params(wrap, wrap, wrap); }
 	void set_wrap_params(GLenum wrap_s, GLenum wrap_t, GLenum wrap_r)
 	{
-		state pipeline; pipeline.enable(target);
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			glTextureParameteri(id, GL_TEXTURE_WRAP_S, wrap_s);
+			glTextureParameteri(id, GL_TEXTURE_WRAP_T, wrap_t);
+			glTextureParameteri(id, GL_TEXTURE_WRAP_R, wrap_r);
+			on_opengl_error(throw_on_wrap_params_error);
+			return;
+		}
+		#endif
 		scoped_bind<texture> bound(*this);
+		clear_opengl_error();
 		glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap_s);
 		glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap_t);
 		glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap_r);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("texture: failed to set wrap params: 'target' or 'wrap_[str]' is not one of the allowed values", err);
-			default: throw err;
-		}
+		on_opengl_error(throw_on_wrap_params_error);
 	}
 
 	void set_filter_params(GLenum filter = GL_LINEAR) { set_filter_params(filter, filter); }
 	void set_filter_params(GLenum min_filter, GLenum mag_filter)
 	{
-		state pipeline; pipeline.enable(target);
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, min_filter);
+			glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, mag_filter);
+			on_opengl_error(throw_on_filter_params_error);
+			return;
+		}
+		#endif
 		scoped_bind<texture> bound(*this);
+		clear_opengl_error();
 		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, min_filter);
 		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, mag_filter);
-		incase_opengl_error(err) {
-			case GL_INVALID_ENUM: throw runtime_error("texture: failed to set filter params: 'target' or 'wrap_[str]' is not one of the allowed values", err);
-			default: throw err;
-		}
+		on_opengl_error(throw_on_filter_params_error);
 	}
 
 	void set_params(GLenum wrap = GL_REPEAT, GLenum filter = GL_LINEAR) { set_wrap_params(wrap); set_filter_params(filter); }
 
-	#define image_preamble state pipeline; pipeline.enable(target);	scoped_bind<texture> bound(*this); if (d.data) glPixelStorei(GL_UNPACK_ALIGNMENT, d.alignment);
-	template <typename T> void image1d(const texture_image<T>& i, const texture_data& d) { image_preamble; glTexImage1D(target, i.level, i.internal_format, i.size, 0, d.format, d.type, d.data); throw_on_image_gl_error(); }
-	template <typename T> void image2d(const texture_image<T>& i, const texture_data& d) { image_preamble; glTexImage2D(target, i.level, i.internal_format, i.size.x, i.size.y, 0, d.format, d.type, d.data); throw_on_image_gl_error(); }
-	template <typename T> void image3d(const texture_image<T>& i, const texture_data& d) { image_preamble; glTexImage3D(target, i.level, i.internal_format, i.size.x, i.size.y, i.size.z, 0, d.format, d.type, d.data); throw_on_image_gl_error(); }
+	#define image_preamble scoped_bind<texture> bound(*this); clear_opengl_error(); if (d.data) glPixelStorei(GL_UNPACK_ALIGNMENT, d.alignment);
+	template <typename T> void image1d(const texture_image<T>& i, const texture_data& d) { image_preamble; glTexImage1D(target, i.level, i.internal_format, i.size, 0, d.format, d.type, d.data); on_opengl_error(throw_on_image_error); }
+	template <typename T> void image2d(const texture_image<T>& i, const texture_data& d) { image_preamble; glTexImage2D(target, i.level, i.internal_format, i.size.x, i.size.y, 0, d.format, d.type, d.data); on_opengl_error(throw_on_image_error); }
+	template <typename T> void image3d(const texture_image<T>& i, const texture_data& d) { image_preamble; glTexImage3D(target, i.level, i.internal_format, i.size.x, i.size.y, i.size.z, 0, d.format, d.type, d.data); on_opengl_error(throw_on_image_error); }
+
+	// Subimages are uploaded through direct state access if the context
+	// supports it. There is no such alternative for glTexImage*.
+	#ifdef GL_VERSION_4_5
+	#define direct_image(call) if (context::current().direct_state_access()) { clear_opengl_error(); if (d.data) glPixelStorei(GL_UNPACK_ALIGNMENT, d.alignment); call; on_opengl_error(throw_on_image_error); return; }
+	#else
+	#define direct_image(call)
+	#endif
+	template <typename T> void image1d(const texture_subimage<T>& i, const texture_data& d) { direct_image(glTextureSubImage1D(id, i.level, i.offset, i.size, d.format, d.type, d.data)); image_preamble; glTexSubImage1D(target, i.level, i.offset, i.size, d.format, d.type, d.data); on_opengl_error(throw_on_image_error); }
+	template <typename T> void image2d(const texture_subimage<T>& i, const texture_data& d) { direct_image(glTextureSubImage2D(id, i.level, i.offset.x, i.offset.y, i.size.x, i.size.y, d.format, d.type, d.data)); image_preamble; glTexSubImage2D(target, i.level, i.offset.x, i.offset.y, i.size.x, i.size.y, d.format, d.type, d.data); on_opengl_error(throw_on_image_error); }
+	template <typename T> void image3d(const texture_subimage<T>& i, const texture_data& d) { direct_image(glTextureSubImage3D(id, i.level, i.offset.x, i.offset.y, i.offset.z, i.size.x, i.size.y, i.size.z, d.format, d.type, d.data)); image_preamble; glTexSubImage3D(target, i.level, i.offset.x, i.offset.y, i.offset.z, i.size.x, i.size.y, i.size.z, d.format, d.type, d.data); on_opengl_error(throw_on_image_error); }
+
+	#ifdef GL_VERSION_4_5
+	#define direct_compressed(call) if (context::current().direct_state_access()) { clear_opengl_error(); call; on_opengl_error(throw_on_compressed_image_error); return; }
+	#else
+	#define direct_compressed(call)
+	#endif
+	#define compressed_preamble scoped_bind<texture> bound(*this); clear_opengl_error();
+	template <typename T> void compressed_image1d(const texture_subimage<T>& i, const compressed_texture_data& d) { direct_compressed(glCompressedTextureSubImage1D(id, i.level, i.offset, i.size, d.format, d.size, d.data)); compressed_preamble; glCompressedTexSubImage1D(target, i.level, i.offset, i.size, d.format, d.size, d.data); on_opengl_error(throw_on_compressed_image_error); }
+	template <typename T> void compressed_image2d(const texture_subimage<T>& i, const compressed_texture_data& d) { direct_compressed(glCompressedTextureSubImage2D(id, i.level, i.offset.x, i.offset.y, i.size.x, i.size.y, d.format, d.size, d.data)); compressed_preamble; glCompressedTexSubImage2D(target, i.level, i.offset.x, i.offset.y, i.size.x, i.size.y, d.format, d.size, d.data); on_opengl_error(throw_on_compressed_image_error); }
+	template <typename T> void compressed_image3d(const texture_subimage<T>& i, const compressed_texture_data& d) { direct_compressed(glCompressedTextureSubImage3D(id, i.level, i.offset.x, i.offset.y, i.offset.z, i.size.x, i.size.y, i.size.z, d.format, d.size, d.data)); compressed_preamble; glCompressedTexSubImage3D(target, i.level, i.offset.x, i.offset.y, i.offset.z, i.size.x, i.size.y, i.size.z, d.format, d.size, d.data); on_opengl_error(throw_on_compressed_image_error); }
+	#undef compressed_preamble
+	#undef direct_compressed
 
-	template <typename T> void image1d(const texture_subimage<T>& i, const texture_data& d) { image_preamble; glTexSubImage1D(target, i.level, i.offset, i.size, d.format, d.type, d.data); throw_on_image_gl_error(); }
-	template <typename T> void image2d(const texture_subimage<T>& i, const texture_data& d) { image_preamble; glTexSubImage2D(target, i.level, i.offset.x, i.offset.y, i.size.x, i.size.y, d.format, d.type, d.data); throw_on_image_gl_error(); }
-	template <typename T> void image3d(const texture_subimage<T>& i, const texture_data& d) { image_preamble; glTexSubImage3D(target, i.level, i.offset.x, i.offset.y, i.offset.z, i.size.x, i.size.y, i.size.z, d.format, d.type, d.data); throw_on_image_gl_error(); }
+	#undef direct_image
+	#undef image_preamble
+
+	// Immutable storage allocates all levels at once, after which the
+	// texture's format and size are fixed and only subimages may be
+	// uploaded. The internal format has to be sized, e.g. GL_RGBA8.
+	#ifdef GL_VERSION_4_2
+	#ifdef GL_VERSION_4_5
+	#define direct_storage(call) if (context::current().direct_state_access()) { clear_opengl_error(); call; on_opengl_error(throw_on_storage_error); return; }
+	#else
+	#define direct_storage(call)
+	#endif
+	#define storage_preamble scoped_bind<texture> bound(*this); clear_opengl_error();
+	void storage1d(GLsizei levels, GLenum internal_format, GLsizei size) { direct_storage(glTextureStorage1D(id, levels, internal_format, size)); storage_preamble; glTexStorage1D(target, levels, internal_format, size); on_opengl_error(throw_on_storage_error); }
+	template <typename T> void storage2d(GLsizei levels, GLenum internal_format, const T& size) { direct_storage(glTextureStorage2D(id, levels, internal_format, size.x, size.y)); storage_preamble; glTexStorage2D(target, levels, internal_format, size.x, size.y); on_opengl_error(throw_on_storage_error); }
+	template <typename T> void storage3d(GLsizei levels, GLenum internal_format, const T& size) { direct_storage(glTextureStorage3D(id, levels, internal_format, size.x, size.y, size.z)); storage_preamble; glTexStorage3D(target, levels, internal_format, size.x, size.y, size.z); on_opengl_error(throw_on_storage_error); }
+	#undef storage_preamble
+	#undef direct_storage
+	#endif
 
-	inline void throw_on_image_gl_error()
+	#ifdef GL_VERSION_3_0
+	/// Computes all levels below the base level from the base level.
+	void generate_mipmap()
 	{
-		incase_opengl_error(err) {
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			glGenerateTextureMipmap(id);
+			on_opengl_error(throw_on_mipmap_error);
+			return;
+		}
+		#endif
+		scoped_bind<texture> bound(*this);
+		clear_opengl_error();
+		glGenerateMipmap(target);
+		on_opengl_error(throw_on_mipmap_error);
+	}
+	#endif
+
+	inline void throw_on_image_gl_error() { on_opengl_error(throw_on_image_error); }
+
+	static void throw_on_bind_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("texture: failed to bind: 'target' is not one of the allowed values", err);
+			case GL_INVALID_VALUE: throw runtime_error("texture: failed to bind: 'id' is not a previously allocated texture name", err);
+			case GL_INVALID_OPERATION: throw runtime_error("texture: failed to bind: texture was previously created with another target", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_unbind_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("texture: failed to unbind: 'target' is not one of the allowed values", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_wrap_params_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("texture: failed to set wrap params: 'target' or 'wrap_[str]' is not one of the allowed values", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_filter_params_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("texture: failed to set filter params: 'target' or 'wrap_[str]' is not one of the allowed values", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_image_error(const opengl_error& err)
+	{
+		switch (err.ec) {
 			case GL_INVALID_ENUM:  throw runtime_error("texture: failed to load image: 'target', 'data_format' or 'data_type' are not one of the allowed values", err);
 			case GL_INVALID_VALUE: throw runtime_error("texture: failed to load image: 'level', 'offset', 'size' or 'internal_format' is negative or too large", err);
 			case GL_INVALID_OPERATION: throw runtime_error("texture: failed to load image: 'data_type' and 'data_format' are incompatible; or 'data_format' or 'internal_format' are invalid", err);
 			default: throw err;
 		}
 	}
-	#undef image_preamble
+
+	static void throw_on_compressed_image_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM:  throw runtime_error("texture: failed to load compressed image: 'target' or 'format' is not one of the allowed values", err);
+			case GL_INVALID_VALUE: throw runtime_error("texture: failed to load compressed image: 'level', 'offset', 'size' or 'image_size' is negative or too large", err);
+			case GL_INVALID_OPERATION: throw runtime_error("texture: failed to load compressed image: 'format' does not match the texture, 'offset' or 'size' is not aligned to whole blocks, or 'image_size' does not match the region", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_storage_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM:  throw runtime_error("texture: failed to allocate storage: 'target' is not one of the allowed values, or 'internal_format' is not a sized format", err);
+			case GL_INVALID_VALUE: throw runtime_error("texture: failed to allocate storage: 'levels' or 'size' is less than 1", err);
+			case GL_INVALID_OPERATION: throw runtime_error("texture: failed to allocate storage: texture already has immutable storage, or 'levels' exceeds the levels of a complete MIP chain", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_mipmap_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("texture: failed to generate mipmap: 'target' is not one of the allowed values", err);
+			case GL_INVALID_OPERATION: throw runtime_error("texture: failed to generate mipmap: base level is compressed or not color-renderable, or the cube map is not cube complete", err);
+			default: throw err;
+		}
+	}
+
+private:
+	/// Allocates the texture's name. Contexts supporting direct state access
+	/// create the texture object right away, since DSA calls reject names
+	/// that have never been bound.
+	void generate()
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().supports_direct_state_access()) {
+			glCreateTextures(target, 1, &id);
+			return;
+		}
+		#endif
+		glGenTextures(1, &id);
+	}
+
+	/// Binds a name to the texture's target of the active texture unit,
+	/// unless the binding cache knows it is bound already.
+	void bind_name(GLuint name, opengl_error_handler handler) const
+	{
+		assert(target > 0);
+		binding_cache& cache = context::current().bindings;
+		if (cache.texture_bound(target, name)) return;
+		clear_opengl_error();
+		glBindTexture(target, name);
+		on_opengl_error(handler);
+		cache.bind_texture(target, name);
+	}
 };
 
 } // namespace gladus
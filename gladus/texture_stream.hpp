@@ -0,0 +1,224 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/context.hpp"
+#include "gladus/buffer.hpp"
+#include "gladus/fence.hpp"
+#include "gladus/pixel_format.hpp"
+#include "gladus/texture.hpp"
+#include <deque>
+#include <memory>
+#define GLADUS_HAS_TEXTURE_STREAM
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_2
+/// Staging memory handed out by texture_stream::acquire(). pointer may be
+/// written from any thread until the staging area is passed to upload().
+struct texture_staging
+{
+	size_t slot;
+	void* pointer;
+	GLsizeiptr size;
+
+	texture_staging(): slot(0), pointer(NULL), size(0) {}
+	texture_staging(size_t slot, void* pointer, GLsizeiptr size): slot(slot), pointer(pointer), size(size) {}
+};
+
+struct texture_stream_statistics
+{
+	unsigned long uploads;
+	unsigned long long bytes;
+	/// Number of acquisitions that had to wait for the GPU to finish an
+	/// upload, i.e. found no staging buffer free. Should stay at zero if the
+	/// pool has enough buffers for the uploads in flight.
+	unsigned long stalls;
+
+	texture_stream_statistics(): uploads(0), bytes(0), stalls(0) {}
+};
+
+/// A pool of pixel unpack buffers for streaming texture data, e.g. video
+/// frames or tiles. acquire() hands out the memory of a staging buffer, which
+/// producer threads may fill while the thread owning the OpenGL context
+/// carries on. upload() then issues the glTexSubImage* call that copies the
+/// buffer into the texture on the GPU and fences the buffer, which is reused
+/// once the fence has signaled.
+///
+/// If the context supports ARB_buffer_storage, the buffers are mapped once,
+/// persistently and coherently. Otherwise each acquisition maps its buffer
+/// and upload() unmaps it. Buffers grow to the largest size acquired from
+/// them. acquire(), upload() and discard() have to be called on the thread
+/// the context is current on. Uploads set GL_UNPACK_ALIGNMENT to the
+/// alignment passed to them.
+struct texture_stream
+{
+	bool persistent;
+	texture_stream_statistics stats;
+
+	explicit texture_stream(size_t count = 4): persistent(false), sequence(0)
+	{
+		assert(count > 0);
+		#ifdef GL_VERSION_4_4
+		const extensions& e = context::current().features();
+		persistent = e.version(4,4) || e.has("GL_ARB_buffer_storage");
+		#endif
+		slots.resize(count);
+	}
+
+	texture_stream(const texture_stream&) = delete;
+	texture_stream& operator=(const texture_stream&) = delete;
+
+	/// Hands out at least size bytes of staging memory, waiting for the
+	/// oldest upload in flight if no buffer is free.
+	texture_staging acquire(GLsizeiptr size)
+	{
+		assert(size > 0);
+		size_t i = free_slot();
+		slot& s = slots[i];
+		if (!s.storage || s.capacity < size)
+			grow(s, size);
+		if (!persistent)
+			s.base = s.storage->map_range(0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		s.acquired = true;
+		return texture_staging(i, s.base, size);
+	}
+
+	/// Gives back staging memory without uploading it.
+	void discard(const texture_staging& staging)
+	{
+		slot& s = slots[staging.slot];
+		assert(s.acquired && "staging area not acquired");
+		if (!persistent) s.storage->unmap();
+		s.acquired = false;
+	}
+
+	/// Copies the staging area, holding pixels of the given format and type
+	/// with rows aligned to alignment bytes, into a subimage of the texture.
+	/// The staging area has to hold the whole subimage.
+	template <typename T> void upload1d(texture& tex, const texture_subimage<T>& i, GLenum format, GLenum type, GLint alignment, const texture_staging& staging)
+	{
+		assert(image_size(i.size, 1, 1, format, type, alignment) <= staging.size && "subimage exceeds the staging area");
+		slot& s = begin_upload(staging, alignment);
+		scoped_bind<buffer> bound(*s.storage);
+		tex.image1d(i, texture_data(format, type));
+		end_upload(s, staging);
+	}
+	template <typename T> void upload2d(texture& tex, const texture_subimage<T>& i, GLenum format, GLenum type, GLint alignment, const texture_staging& staging)
+	{
+		assert(image_size(i.size.x, i.size.y, 1, format, type, alignment) <= staging.size && "subimage exceeds the staging area");
+		slot& s = begin_upload(staging, alignment);
+		scoped_bind<buffer> bound(*s.storage);
+		tex.image2d(i, texture_data(format, type));
+		end_upload(s, staging);
+	}
+	template <typename T> void upload3d(texture& tex, const texture_subimage<T>& i, GLenum format, GLenum type, GLint alignment, const texture_staging& staging)
+	{
+		assert(image_size(i.size.x, i.size.y, i.size.z, format, type, alignment) <= staging.size && "subimage exceeds the staging area");
+		slot& s = begin_upload(staging, alignment);
+		scoped_bind<buffer> bound(*s.storage);
+		tex.image3d(i, texture_data(format, type));
+		end_upload(s, staging);
+	}
+
+	size_t size() const { return slots.size(); }
+
+	/// Size in bytes of the pixel data of an image with rows aligned to
+	/// alignment bytes, as read by an upload. 0 if the format and type are
+	/// not known.
+	static GLsizeiptr image_size(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, GLint alignment)
+	{
+		GLsizeiptr pixel = pixel_size(format, type);
+		GLsizeiptr row = (width * pixel + alignment - 1) / alignment * alignment;
+		GLsizeiptr rows = GLsizeiptr(height) * depth;
+		return rows > 0 ? row * (rows - 1) + width * pixel : 0;
+	}
+
+private:
+	struct slot
+	{
+		std::unique_ptr<gladus::buffer> storage;
+		GLsizeiptr capacity;
+		void* base;
+		bool acquired;
+		bool in_flight;
+		unsigned long long submitted;
+		fence done;
+
+		slot(): capacity(0), base(NULL), acquired(false), in_flight(false), submitted(0) {}
+	};
+
+	std::deque<slot> slots;
+	unsigned long long sequence;
+
+	/// Returns a slot that is neither acquired nor in use by the GPU,
+	/// retiring uploads whose fence has signaled or waiting for the oldest.
+	size_t free_slot()
+	{
+		size_t oldest = slots.size();
+		for (size_t i = 0; i < slots.size(); i++) {
+			slot& s = slots[i];
+			if (s.acquired) continue;
+			if (!s.in_flight || s.done.signaled()) {
+				s.in_flight = false;
+				return i;
+			}
+			if (oldest == slots.size() || s.submitted < slots[oldest].submitted)
+				oldest = i;
+		}
+		if (oldest == slots.size())
+			throw runtime_error("texture_stream: failed to acquire: all staging buffers are acquired");
+		if (slots[oldest].done.wait())
+			stats.stalls++;
+		slots[oldest].in_flight = false;
+		return oldest;
+	}
+
+	void grow(slot& s, GLsizeiptr size)
+	{
+		#ifdef GL_VERSION_4_4
+		if (persistent) {
+			// Immutable storage cannot be resized, so a larger buffer
+			// replaces the old one.
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			s.storage.reset(new gladus::buffer(GL_PIXEL_UNPACK_BUFFER));
+			s.storage->storage(size, NULL, flags);
+			s.base = s.storage->map_range(0, size, flags);
+			s.capacity = size;
+			return;
+		}
+		#endif
+		if (!s.storage) s.storage.reset(new gladus::buffer(GL_PIXEL_UNPACK_BUFFER));
+		s.storage->data(size, NULL, GL_STREAM_DRAW);
+		s.capacity = size;
+	}
+
+	slot& begin_upload(const texture_staging& staging, GLint alignment)
+	{
+		slot& s = slots[staging.slot];
+		assert(s.acquired && "staging area not acquired");
+		if (!persistent) s.storage->unmap();
+		s.acquired = false;
+		// texture_data only sets the alignment for non-NULL data, but the
+		// data is at offset 0 of the bound unpack buffer.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+		return s;
+	}
+
+	void end_upload(slot& s, const texture_staging& staging)
+	{
+		s.done.insert();
+		s.in_flight = true;
+		s.submitted = ++sequence;
+		stats.uploads++;
+		stats.bytes += staging.size;
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_2
+	typedef gladus::texture_stream TextureStream;
+	#endif
+}
@@ -0,0 +1,731 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/opengl.hpp"
+#include "gladus/instrument.hpp"
+#include "gladus/error.hpp"
+#include "gladus/pixel_format.hpp"
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+#define GLADUS_HAS_TRACE
+
+namespace gladus {
+
+// Traces are written through mmap, so recording is only available on POSIX
+// systems.
+#if defined(GL_VERSION_3_2) && !defined(_WIN32)
+/// A trace file starts with this header, followed by the names of the traced
+/// functions, each as a 16-bit length and the characters, padded to a
+/// multiple of 8 bytes. The records of the calls follow. A record consists of
+/// a gl_trace_record, one 64-bit slot per argument, a slot holding the return
+/// value, and the payloads. Each payload is a gl_trace_payload followed by
+/// its data, padded to a multiple of 8 bytes. All values are stored in the
+/// byte order of the recording machine.
+struct gl_trace_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t functions;
+	uint64_t records;
+	/// Bytes of the file in use, including this header.
+	uint64_t size;
+	/// Calls not recorded because the file was full.
+	uint64_t dropped;
+
+	static const char* expected_magic() { return "GLDTRACE"; }
+	static const uint32_t current_version = 1;
+};
+
+struct gl_trace_record
+{
+	/// Index of the function in the table of the header.
+	uint16_t function;
+	uint8_t arguments;
+	uint8_t payloads;
+	/// Bytes of the record, including this header.
+	uint32_t size;
+};
+
+enum gl_trace_payload_kind
+{
+	/// Data the argument points to, which the call reads.
+	payload_input,
+	/// Data the call wrote to the memory the argument points to, e.g. the
+	/// names generated by glGenBuffers.
+	payload_output,
+	/// Size of the memory the argument points to, which the call writes to.
+	/// Carries no data.
+	payload_reserve,
+	/// Data written to a mapped buffer range, at the given offset from the
+	/// start of the mapping. Recorded by the call that unmaps or flushes it.
+	payload_mapped
+};
+
+struct gl_trace_payload
+{
+	/// Index of the argument, or no_argument.
+	uint8_t argument;
+	uint8_t kind;
+	uint16_t reserved;
+	uint32_t size;
+	uint64_t offset;
+
+	static const uint8_t no_argument = 0xff;
+};
+
+/// Conversion of arguments and return values to and from the 64-bit slots
+/// of a record. Pointers are stored as their address.
+template <typename T> struct gl_trace_slot
+{
+	static uint64_t encode(T v) { return uint64_t(int64_t(v)); }
+	static T decode(uint64_t s) { return T(s); }
+};
+template <> struct gl_trace_slot<GLfloat>
+{
+	static uint64_t encode(GLfloat v) { uint32_t bits; std::memcpy(&bits, &v, sizeof(v)); return bits; }
+	static GLfloat decode(uint64_t s) { uint32_t bits = uint32_t(s); GLfloat v; std::memcpy(&v, &bits, sizeof(v)); return v; }
+};
+template <> struct gl_trace_slot<GLdouble>
+{
+	static uint64_t encode(GLdouble v) { uint64_t bits; std::memcpy(&bits, &v, sizeof(v)); return bits; }
+	static GLdouble decode(uint64_t s) { GLdouble v; std::memcpy(&v, &s, sizeof(v)); return v; }
+};
+template <typename T> struct gl_trace_slot<T*>
+{
+	static uint64_t encode(T* v) { return uint64_t(uintptr_t(v)); }
+	static T* decode(uint64_t s) { return (T*)uintptr_t(s); }
+};
+template <typename R, typename... A> struct gl_trace_slot<R (*)(A...)>
+{
+	static uint64_t encode(R (*v)(A...)) { return uint64_t(reinterpret_cast<uintptr_t>(v)); }
+	static R (*decode(uint64_t))(A...) { return NULL; }
+};
+
+/// Records the OpenGL calls the wrappers issue on the thread that called
+/// start() to a memory-mapped file, together with the data they read through
+/// pointers, e.g. the contents of glBufferSubData or glTexSubImage2D, and the
+/// data written to mapped buffer ranges before they are unmapped or flushed.
+/// Requires GLADUS_TRACE_GL_CALLS to be defined before including
+/// gladus/opengl.hpp; otherwise nothing is recorded.
+///
+/// A trace can be replayed with the gladus_replay tool, which reports the
+/// time spent in each function and the calls that set state to the value it
+/// already had. A replay starts from a fresh context, so the trace has to
+/// cover the creation of all objects it uses; start recording right after
+/// creating the context. Writes to persistently mapped ranges that are never
+/// flushed or unmapped are not recorded.
+///
+///     gl_trace trace("frame.trace");
+///     trace.start();
+///     render();
+///     trace.stop();
+///
+/// The file's space is reserved up front, but only the part in use ends up
+/// in the file. Calls that do not fit are dropped and counted.
+struct gl_trace
+{
+	explicit gl_trace(const char* path, size_t capacity = size_t(1) << 30):
+		unpack_buffer(0), pack_buffer(0), unpack_alignment(4), pack_alignment(4),
+		fd(-1), data(NULL), capacity(capacity), used(0), record(0), record_payloads(0), overflow(false), full(false)
+	{
+		fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw runtime_error("trace: failed to open file: file cannot be created");
+		void* p = MAP_FAILED;
+		if (::ftruncate(fd, capacity) == 0)
+			p = ::mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			::close(fd);
+			throw runtime_error("trace: failed to open file: 'capacity' bytes cannot be mapped");
+		}
+		data = (char*)p;
+		write_header();
+	}
+
+	~gl_trace()
+	{
+		stop();
+		::munmap(data, capacity);
+		if (::ftruncate(fd, used) != 0) {}
+		::close(fd);
+	}
+
+	gl_trace(const gl_trace&) = delete;
+	gl_trace& operator=(const gl_trace&) = delete;
+
+	/// Records the calls of this thread from now on. Reads the pixel store
+	/// state, which determines the size of the pixel data of the calls.
+	void start()
+	{
+		GLint v;
+		::glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &v); unpack_buffer = v;
+		::glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &v); pack_buffer = v;
+		::glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+		::glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment);
+		active_gl_trace() = this;
+	}
+
+	void stop() { if (active_gl_trace() == this) active_gl_trace() = NULL; }
+
+	bool recording() const { return active_gl_trace() == this; }
+	uint64_t records() const { return header().records; }
+	uint64_t dropped() const { return header().dropped; }
+	/// Bytes of the file in use.
+	size_t size() const { return used; }
+
+	// The following is used by traced_gl_call() and the gl_call_recorder
+	// specializations while recording a call.
+
+	void begin(int function, int arguments)
+	{
+		overflow = full;
+		record = used;
+		record_payloads = 0;
+		if (!allocate(sizeof(gl_trace_record) + (arguments + 1) * sizeof(uint64_t))) return;
+		gl_trace_record r = { uint16_t(function), uint8_t(arguments), 0, 0 };
+		std::memcpy(data + record, &r, sizeof(r));
+	}
+
+	void arguments(int) {}
+	template <typename T, typename... Rest> void arguments(int i, T v, Rest... rest)
+	{
+		if (!overflow) slot(i) = gl_trace_slot<T>::encode(v);
+		arguments(i + 1, rest...);
+	}
+
+	void result(uint64_t v)
+	{
+		if (overflow) return;
+		gl_trace_record& r = *(gl_trace_record*)(data + record);
+		slot(r.arguments) = v;
+	}
+
+	void end()
+	{
+		gl_trace_header& h = header();
+		if (overflow) {
+			// A partial record is discarded, and so are all later ones, such
+			// that a replay does not miss calls in between.
+			used = record;
+			full = true;
+			h.dropped++;
+			return;
+		}
+		gl_trace_record& r = *(gl_trace_record*)(data + record);
+		r.payloads = record_payloads;
+		r.size = uint32_t(used - record);
+		h.records++;
+		h.size = used;
+	}
+
+	void input(int argument, const void* p, size_t size) { if (p) payload(argument, payload_input, p, size, 0); }
+	void output(int argument, const void* p, size_t size) { if (p) payload(argument, payload_output, p, size, 0); }
+	void reserve(int argument, const void* p, size_t size) { if (p) payload(argument, payload_reserve, NULL, size, 0); }
+
+	/// Records count strings as one payload, each followed by a null
+	/// character. If lengths is NULL, the strings are null-terminated.
+	void input_strings(int argument, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+	{
+		size_t size = 0;
+		for (GLsizei i = 0; i < count; i++) size += string_length(strings[i], lengths, i) + 1;
+		char* dst = begin_payload(argument, payload_input, size, 0);
+		if (!dst) return;
+		for (GLsizei i = 0; i < count; i++) {
+			size_t n = string_length(strings[i], lengths, i);
+			std::memcpy(dst, strings[i], n);
+			dst[n] = 0;
+			dst += n + 1;
+		}
+	}
+
+	/// Size of the pixel data of an image of the given size, as read with
+	/// the unpack or written with the pack alignment.
+	size_t image_size(bool pack, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) const
+	{
+		size_t pixel = pixel_size(format, type);
+		size_t alignment = pack ? pack_alignment : unpack_alignment;
+		size_t row = (width * pixel + alignment - 1) / alignment * alignment;
+		size_t rows = size_t(height) * depth;
+		return rows ? row * (rows - 1) + width * pixel : 0;
+	}
+
+	/// Key of a mapped range in mappings, from the target or, for the
+	/// glMapNamedBuffer* functions, the buffer name it was mapped through.
+	static uint64_t mapping_key(bool named, GLuint target) { return uint64_t(named) << 32 | target; }
+
+	void mapped(uint64_t key, void* pointer, GLsizeiptr length, bool write, bool explicit_flush)
+	{
+		if (!pointer) return;
+		mapping& m = mappings[key];
+		m.pointer = (const char*)pointer;
+		m.length = length;
+		m.write = write;
+		m.explicit_flush = explicit_flush;
+	}
+
+	/// Records the contents of a range about to be unmapped, unless they
+	/// are only written through flushes.
+	void unmapping(uint64_t key)
+	{
+		std::map<uint64_t, mapping>::iterator it = mappings.find(key);
+		if (it == mappings.end()) return;
+		const mapping& m = it->second;
+		if (m.write && !m.explicit_flush) payload(gl_trace_payload::no_argument, payload_mapped, m.pointer, m.length, 0);
+		mappings.erase(it);
+	}
+
+	/// Records the contents of a range about to be flushed. A range outside
+	/// the mapping is not flushed by OpenGL either, and not read.
+	void flushing(uint64_t key, GLintptr offset, GLsizeiptr length)
+	{
+		std::map<uint64_t, mapping>::iterator it = mappings.find(key);
+		if (it == mappings.end()) return;
+		const mapping& m = it->second;
+		if (offset < 0 || length < 0 || length > m.length - offset) return;
+		payload(gl_trace_payload::no_argument, payload_mapped, m.pointer + offset, length, offset);
+	}
+
+	/// Pixel store state the size of pixel data depends on, kept up to date
+	/// by the recorders of glBindBuffer, glDeleteBuffers and glPixelStorei.
+	GLuint unpack_buffer;
+	GLuint pack_buffer;
+	GLint unpack_alignment;
+	GLint pack_alignment;
+
+private:
+	struct mapping
+	{
+		const char* pointer;
+		GLsizeiptr length;
+		bool write;
+		bool explicit_flush;
+	};
+
+	int fd;
+	char* data;
+	size_t capacity;
+	size_t used;
+	size_t record;
+	uint8_t record_payloads;
+	/// Whether the current record does not fit, and whether one did not.
+	bool overflow;
+	bool full;
+	std::map<uint64_t, mapping> mappings;
+
+	gl_trace_header& header() const { return *(gl_trace_header*)data; }
+	uint64_t& slot(int i) { return *(uint64_t*)(data + record + sizeof(gl_trace_record) + i * sizeof(uint64_t)); }
+
+	void write_header()
+	{
+		gl_trace_header h;
+		std::memcpy(h.magic, gl_trace_header::expected_magic(), sizeof(h.magic));
+		h.version = gl_trace_header::current_version;
+		h.functions = num_gl_calls;
+		h.records = 0;
+		h.size = 0;
+		h.dropped = 0;
+		if (!allocate(sizeof(h))) throw runtime_error("trace: failed to open file: 'capacity' is too small");
+		std::memcpy(data, &h, sizeof(h));
+		for (int i = 0; i < num_gl_calls; i++) {
+			uint16_t n = std::strlen(gl_call_name(i));
+			char* dst = allocate(sizeof(n) + n);
+			if (!dst) throw runtime_error("trace: failed to open file: 'capacity' is too small");
+			std::memcpy(dst, &n, sizeof(n));
+			std::memcpy(dst + sizeof(n), gl_call_name(i), n);
+		}
+		if (!allocate((8 - used % 8) % 8)) throw runtime_error("trace: failed to open file: 'capacity' is too small");
+		header().size = used;
+	}
+
+	/// Returns n more bytes at the end of the file, or NULL if they do not
+	/// fit, in which case the current record is dropped.
+	char* allocate(size_t n)
+	{
+		if (overflow || used + n > capacity) {
+			overflow = true;
+			return NULL;
+		}
+		char* p = data + used;
+		used += n;
+		return p;
+	}
+
+	char* begin_payload(int argument, int kind, size_t size, uint64_t offset)
+	{
+		if (overflow) return NULL;
+		size_t stored = kind == payload_reserve ? 0 : (size + 7) / 8 * 8;
+		char* dst = allocate(sizeof(gl_trace_payload) + stored);
+		if (!dst) return NULL;
+		gl_trace_payload p = { uint8_t(argument), uint8_t(kind), 0, uint32_t(size), offset };
+		std::memcpy(dst, &p, sizeof(p));
+		record_payloads++;
+		return dst + sizeof(p);
+	}
+
+	void payload(int argument, int kind, const void* p, size_t size, uint64_t offset)
+	{
+		char* dst = begin_payload(argument, kind, size, offset);
+		if (dst && p) std::memcpy(dst, p, size);
+	}
+
+	static size_t string_length(const GLchar* s, const GLint* lengths, GLsizei i)
+	{
+		return lengths && lengths[i] >= 0 ? size_t(lengths[i]) : std::strlen(s);
+	}
+};
+
+/// Records what a traced call reads or writes through pointers, and keeps
+/// the trace's view of the state up to date. before() is called before the
+/// call, after() and returned() after it, with the call's arguments.
+struct gl_call_recorder_base
+{
+	template <typename... A> static void before(gl_trace&, A...) {}
+	template <typename... A> static void after(gl_trace&, A...) {}
+	template <typename R, typename... A> static void returned(gl_trace&, R, A...) {}
+};
+
+template <int Id> struct gl_call_recorder: gl_call_recorder_base {};
+
+/// Argument I of a call as an image extent, or 1 if I is negative.
+template <int I> struct gl_trace_extent
+{
+	template <typename... A> static GLsizei of(const std::tuple<A...>& a) { return GLsizei(std::get<I>(a)); }
+};
+template <> struct gl_trace_extent<-1>
+{
+	template <typename... A> static GLsizei of(const std::tuple<A...>&) { return 1; }
+};
+
+/// Records the Count * Unit bytes argument Data points to.
+template <int Data, int Count, size_t Unit> struct gl_call_array_input: gl_call_recorder_base
+{
+	template <typename... A> static void before(gl_trace& t, A... args)
+	{
+		std::tuple<A...> a(args...);
+		t.input(Data, std::get<Data>(a), size_t(std::get<Count>(a)) * Unit);
+	}
+};
+
+/// Records the Count * Unit bytes the call wrote to argument Data.
+template <int Data, int Count, size_t Unit> struct gl_call_array_output: gl_call_recorder_base
+{
+	template <typename... A> static void after(gl_trace& t, A... args)
+	{
+		std::tuple<A...> a(args...);
+		t.output(Data, std::get<Data>(a), size_t(std::get<Count>(a)) * Unit);
+	}
+};
+
+/// Records the size of the memory argument Data points to, which is given
+/// by argument Size.
+template <int Data, int Size> struct gl_call_reserve: gl_call_recorder_base
+{
+	template <typename... A> static void before(gl_trace& t, A... args)
+	{
+		std::tuple<A...> a(args...);
+		t.reserve(Data, std::get<Data>(a), size_t(std::get<Size>(a)));
+	}
+};
+
+/// Records the null-terminated string argument Data points to.
+template <int Data> struct gl_call_string_input: gl_call_recorder_base
+{
+	template <typename... A> static void before(gl_trace& t, A... args)
+	{
+		std::tuple<A...> a(args...);
+		const GLchar* s = std::get<Data>(a);
+		if (s) t.input(Data, s, std::strlen(s) + 1);
+	}
+};
+
+/// Records the pixel data of an image upload whose width, height and depth
+/// are given by the respective arguments, -1 for dimensions the image does
+/// not have. The format, type and data are the arguments from Format on.
+/// Nothing is recorded while a pixel unpack buffer is bound, since the data
+/// argument is an offset into the buffer then.
+template <int Width, int Height, int Depth, int Format> struct gl_call_pixels_input: gl_call_recorder_base
+{
+	template <typename... A> static void before(gl_trace& t, A... args)
+	{
+		if (t.unpack_buffer) return;
+		std::tuple<A...> a(args...);
+		size_t size = t.image_size(false, gl_trace_extent<Width>::of(a), gl_trace_extent<Height>::of(a), gl_trace_extent<Depth>::of(a), std::get<Format>(a), std::get<Format+1>(a));
+		t.input(Format+2, std::get<Format+2>(a), size);
+	}
+};
+
+/// Like gl_call_pixels_input, for compressed data whose size is given by
+/// argument Size.
+template <int Data, int Size> struct gl_call_compressed_input: gl_call_recorder_base
+{
+	template <typename... A> static void before(gl_trace& t, A... args)
+	{
+		if (t.unpack_buffer) return;
+		std::tuple<A...> a(args...);
+		t.input(Data, std::get<Data>(a), size_t(std::get<Size>(a)));
+	}
+};
+
+template <int Id, typename R> struct gl_trace_invoke
+{
+	template <typename... A> static R call(gl_trace& trace, R (*function)(A...), A... args)
+	{
+		R r = function(args...);
+		trace.result(gl_trace_slot<R>::encode(r));
+		gl_call_recorder<Id>::after(trace, args...);
+		gl_call_recorder<Id>::returned(trace, r, args...);
+		trace.end();
+		return r;
+	}
+};
+template <int Id> struct gl_trace_invoke<Id, void>
+{
+	template <typename... A> static void call(gl_trace& trace, void (*function)(A...), A... args)
+	{
+		function(args...);
+		trace.result(0);
+		gl_call_recorder<Id>::after(trace, args...);
+		trace.end();
+	}
+};
+
+template <int Id, typename R, typename... A> R traced_gl_call(gl_trace& trace, R (*function)(A...), A... args)
+{
+	trace.begin(Id, sizeof...(A));
+	trace.arguments(0, args...);
+	gl_call_recorder<Id>::before(trace, args...);
+	return gl_trace_invoke<Id, R>::call(trace, function, args...);
+}
+
+#define gladus_gl_call_recorder(name, ...) template <> struct gl_call_recorder<gl_call_##name>: __VA_ARGS__ {};
+
+gladus_gl_call_recorder(glDeleteTextures, gl_call_array_input<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glGenTextures, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glTexImage1D, gl_call_pixels_input<3, -1, -1, 5>)
+gladus_gl_call_recorder(glTexImage2D, gl_call_pixels_input<3, 4, -1, 6>)
+gladus_gl_call_recorder(glTexImage3D, gl_call_pixels_input<3, 4, 5, 7>)
+gladus_gl_call_recorder(glTexSubImage1D, gl_call_pixels_input<3, -1, -1, 4>)
+gladus_gl_call_recorder(glTexSubImage2D, gl_call_pixels_input<4, 5, -1, 6>)
+gladus_gl_call_recorder(glTexSubImage3D, gl_call_pixels_input<5, 6, 7, 8>)
+gladus_gl_call_recorder(glCompressedTexSubImage1D, gl_call_compressed_input<6, 5>)
+gladus_gl_call_recorder(glCompressedTexSubImage2D, gl_call_compressed_input<8, 7>)
+gladus_gl_call_recorder(glCompressedTexSubImage3D, gl_call_compressed_input<10, 9>)
+
+template <> struct gl_call_recorder<gl_call_glReadPixels>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* pixels)
+	{
+		if (!t.pack_buffer) t.reserve(6, pixels, t.image_size(true, width, height, 1, format, type));
+	}
+};
+
+template <> struct gl_call_recorder<gl_call_glPixelStorei>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLenum pname, GLint param)
+	{
+		if (pname == GL_UNPACK_ALIGNMENT) t.unpack_alignment = param;
+		if (pname == GL_PACK_ALIGNMENT) t.pack_alignment = param;
+	}
+};
+
+template <> struct gl_call_recorder<gl_call_glBindBuffer>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLenum target, GLuint buffer)
+	{
+		if (target == GL_PIXEL_UNPACK_BUFFER) t.unpack_buffer = buffer;
+		if (target == GL_PIXEL_PACK_BUFFER) t.pack_buffer = buffer;
+	}
+};
+
+template <> struct gl_call_recorder<gl_call_glDeleteBuffers>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLsizei n, const GLuint* buffers)
+	{
+		t.input(1, buffers, n * sizeof(GLuint));
+		for (GLsizei i = 0; i < n; i++) {
+			if (buffers[i] == t.unpack_buffer) t.unpack_buffer = 0;
+			if (buffers[i] == t.pack_buffer) t.pack_buffer = 0;
+		}
+	}
+};
+
+gladus_gl_call_recorder(glGenBuffers, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glDeleteQueries, gl_call_array_input<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glGenQueries, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glBufferData, gl_call_array_input<2, 1, 1>)
+gladus_gl_call_recorder(glBufferSubData, gl_call_array_input<3, 2, 1>)
+
+template <> struct gl_call_recorder<gl_call_glMapBuffer>: gl_call_recorder_base
+{
+	static void returned(gl_trace& t, void* pointer, GLenum target, GLenum access)
+	{
+		GLint64 size = 0;
+		if (pointer) ::glGetBufferParameteri64v(target, GL_BUFFER_SIZE, &size);
+		t.mapped(gl_trace::mapping_key(false, target), pointer, size, access != GL_READ_ONLY, false);
+	}
+};
+template <> struct gl_call_recorder<gl_call_glUnmapBuffer>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLenum target) { t.unmapping(gl_trace::mapping_key(false, target)); }
+};
+
+gladus_gl_call_recorder(glGetActiveUniform, gl_call_reserve<6, 2>)
+gladus_gl_call_recorder(glGetProgramInfoLog, gl_call_reserve<3, 1>)
+gladus_gl_call_recorder(glGetShaderInfoLog, gl_call_reserve<3, 1>)
+gladus_gl_call_recorder(glGetUniformLocation, gl_call_string_input<1>)
+
+template <> struct gl_call_recorder<gl_call_glShaderSource>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLuint, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+	{
+		// The lengths are recorded as well, since the strings are stored one
+		// after another.
+		std::vector<GLint> n(count);
+		for (GLsizei i = 0; i < count; i++) n[i] = lengths && lengths[i] >= 0 ? lengths[i] : GLint(std::strlen(strings[i]));
+		t.input_strings(2, count, strings, lengths);
+		if (count > 0) t.input(3, &n[0], count * sizeof(GLint));
+	}
+};
+
+gladus_gl_call_recorder(glUniform1fv, gl_call_array_input<2, 1, 1 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniform2fv, gl_call_array_input<2, 1, 2 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniform3fv, gl_call_array_input<2, 1, 3 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniform4fv, gl_call_array_input<2, 1, 4 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniform1iv, gl_call_array_input<2, 1, 1 * sizeof(GLint)>)
+gladus_gl_call_recorder(glUniform2iv, gl_call_array_input<2, 1, 2 * sizeof(GLint)>)
+gladus_gl_call_recorder(glUniform3iv, gl_call_array_input<2, 1, 3 * sizeof(GLint)>)
+gladus_gl_call_recorder(glUniform4iv, gl_call_array_input<2, 1, 4 * sizeof(GLint)>)
+gladus_gl_call_recorder(glUniformMatrix2fv, gl_call_array_input<3, 1, 4 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix3fv, gl_call_array_input<3, 1, 9 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix4fv, gl_call_array_input<3, 1, 16 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix2x3fv, gl_call_array_input<3, 1, 6 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix3x2fv, gl_call_array_input<3, 1, 6 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix2x4fv, gl_call_array_input<3, 1, 8 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix4x2fv, gl_call_array_input<3, 1, 8 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix3x4fv, gl_call_array_input<3, 1, 12 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glUniformMatrix4x3fv, gl_call_array_input<3, 1, 12 * sizeof(GLfloat)>)
+
+gladus_gl_call_recorder(glDeleteFramebuffers, gl_call_array_input<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glDeleteVertexArrays, gl_call_array_input<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glGenFramebuffers, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glGenVertexArrays, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glUniform1uiv, gl_call_array_input<2, 1, 1 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glUniform2uiv, gl_call_array_input<2, 1, 2 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glUniform3uiv, gl_call_array_input<2, 1, 3 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glUniform4uiv, gl_call_array_input<2, 1, 4 * sizeof(GLuint)>)
+
+template <> struct gl_call_recorder<gl_call_glMapBufferRange>: gl_call_recorder_base
+{
+	static void returned(gl_trace& t, void* pointer, GLenum target, GLintptr, GLsizeiptr length, GLbitfield access)
+	{
+		t.mapped(gl_trace::mapping_key(false, target), pointer, length, access & GL_MAP_WRITE_BIT, access & GL_MAP_FLUSH_EXPLICIT_BIT);
+	}
+};
+template <> struct gl_call_recorder<gl_call_glFlushMappedBufferRange>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLenum target, GLintptr offset, GLsizeiptr length) { t.flushing(gl_trace::mapping_key(false, target), offset, length); }
+};
+
+gladus_gl_call_recorder(glGetUniformBlockIndex, gl_call_string_input<1>)
+
+#ifdef GL_VERSION_4_1
+gladus_gl_call_recorder(glGetProgramBinary, gl_call_reserve<4, 1>)
+gladus_gl_call_recorder(glProgramBinary, gl_call_array_input<2, 3, 1>)
+gladus_gl_call_recorder(glProgramUniform1fv, gl_call_array_input<3, 2, 1 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniform2fv, gl_call_array_input<3, 2, 2 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniform3fv, gl_call_array_input<3, 2, 3 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniform4fv, gl_call_array_input<3, 2, 4 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniform1iv, gl_call_array_input<3, 2, 1 * sizeof(GLint)>)
+gladus_gl_call_recorder(glProgramUniform2iv, gl_call_array_input<3, 2, 2 * sizeof(GLint)>)
+gladus_gl_call_recorder(glProgramUniform3iv, gl_call_array_input<3, 2, 3 * sizeof(GLint)>)
+gladus_gl_call_recorder(glProgramUniform4iv, gl_call_array_input<3, 2, 4 * sizeof(GLint)>)
+gladus_gl_call_recorder(glProgramUniform1uiv, gl_call_array_input<3, 2, 1 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glProgramUniform2uiv, gl_call_array_input<3, 2, 2 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glProgramUniform3uiv, gl_call_array_input<3, 2, 3 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glProgramUniform4uiv, gl_call_array_input<3, 2, 4 * sizeof(GLuint)>)
+gladus_gl_call_recorder(glProgramUniformMatrix2fv, gl_call_array_input<4, 2, 4 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix3fv, gl_call_array_input<4, 2, 9 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix4fv, gl_call_array_input<4, 2, 16 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix2x3fv, gl_call_array_input<4, 2, 6 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix3x2fv, gl_call_array_input<4, 2, 6 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix2x4fv, gl_call_array_input<4, 2, 8 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix4x2fv, gl_call_array_input<4, 2, 8 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix3x4fv, gl_call_array_input<4, 2, 12 * sizeof(GLfloat)>)
+gladus_gl_call_recorder(glProgramUniformMatrix4x3fv, gl_call_array_input<4, 2, 12 * sizeof(GLfloat)>)
+#endif
+
+#ifdef GL_VERSION_4_3
+gladus_gl_call_recorder(glGetProgramResourceIndex, gl_call_string_input<2>)
+gladus_gl_call_recorder(glDebugMessageControl, gl_call_array_input<4, 3, sizeof(GLuint)>)
+
+template <> struct gl_call_recorder<gl_call_glPushDebugGroup>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLenum, GLuint, GLsizei length, const GLchar* message)
+	{
+		t.input(3, message, length < 0 ? std::strlen(message) + 1 : size_t(length));
+	}
+};
+#endif
+
+#ifdef GL_VERSION_4_4
+gladus_gl_call_recorder(glBufferStorage, gl_call_array_input<2, 1, 1>)
+#endif
+
+#ifdef GL_VERSION_4_5
+gladus_gl_call_recorder(glCreateBuffers, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glCreateFramebuffers, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glCreateTextures, gl_call_array_output<2, 1, sizeof(GLuint)>)
+gladus_gl_call_recorder(glCreateVertexArrays, gl_call_array_output<1, 0, sizeof(GLuint)>)
+gladus_gl_call_recorder(glNamedBufferData, gl_call_array_input<2, 1, 1>)
+gladus_gl_call_recorder(glNamedBufferStorage, gl_call_array_input<2, 1, 1>)
+gladus_gl_call_recorder(glNamedBufferSubData, gl_call_array_input<3, 2, 1>)
+gladus_gl_call_recorder(glTextureSubImage1D, gl_call_pixels_input<3, -1, -1, 4>)
+gladus_gl_call_recorder(glTextureSubImage2D, gl_call_pixels_input<4, 5, -1, 6>)
+gladus_gl_call_recorder(glTextureSubImage3D, gl_call_pixels_input<5, 6, 7, 8>)
+gladus_gl_call_recorder(glCompressedTextureSubImage1D, gl_call_compressed_input<6, 5>)
+gladus_gl_call_recorder(glCompressedTextureSubImage2D, gl_call_compressed_input<8, 7>)
+gladus_gl_call_recorder(glCompressedTextureSubImage3D, gl_call_compressed_input<10, 9>)
+
+template <> struct gl_call_recorder<gl_call_glMapNamedBuffer>: gl_call_recorder_base
+{
+	static void returned(gl_trace& t, void* pointer, GLuint buffer, GLenum access)
+	{
+		GLint64 size = 0;
+		if (pointer) ::glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
+		t.mapped(gl_trace::mapping_key(true, buffer), pointer, size, access != GL_READ_ONLY, false);
+	}
+};
+template <> struct gl_call_recorder<gl_call_glMapNamedBufferRange>: gl_call_recorder_base
+{
+	static void returned(gl_trace& t, void* pointer, GLuint buffer, GLintptr, GLsizeiptr length, GLbitfield access)
+	{
+		t.mapped(gl_trace::mapping_key(true, buffer), pointer, length, access & GL_MAP_WRITE_BIT, access & GL_MAP_FLUSH_EXPLICIT_BIT);
+	}
+};
+template <> struct gl_call_recorder<gl_call_glFlushMappedNamedBufferRange>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLuint buffer, GLintptr offset, GLsizeiptr length) { t.flushing(gl_trace::mapping_key(true, buffer), offset, length); }
+};
+template <> struct gl_call_recorder<gl_call_glUnmapNamedBuffer>: gl_call_recorder_base
+{
+	static void before(gl_trace& t, GLuint buffer) { t.unmapping(gl_trace::mapping_key(true, buffer)); }
+};
+#endif
+
+#undef gladus_gl_call_recorder
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#if defined(GL_VERSION_3_2) && !defined(_WIN32)
+	typedef gladus::gl_trace Trace;
+	#endif
+}
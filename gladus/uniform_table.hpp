@@ -0,0 +1,203 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#define GLADUS_HAS_UNIFORM_TABLE
+
+namespace gladus {
+
+/// Precomputed name of a uniform, i.e. the 64 bit FNV-1a hash of the name.
+/// Can be computed at compile time, either through the constructor or the
+/// _uniform literal, such that looking up a uniform by key neither allocates
+/// memory nor talks to OpenGL:
+///
+///     using namespace gladus::literals;
+///     prog.uniform("mvp"_uniform).matrix4(m);
+struct uniform_key
+{
+	unsigned long long hash;
+
+	constexpr explicit uniform_key(unsigned long long hash): hash(hash) {}
+	constexpr explicit uniform_key(const char* name): hash(hash_of(name, length(name))) {}
+	explicit uniform_key(const std::string& name): hash(hash_of(name.c_str(), name.size())) {}
+
+	bool operator==(const uniform_key& other) const { return hash == other.hash; }
+	bool operator!=(const uniform_key& other) const { return hash != other.hash; }
+
+	static constexpr unsigned long long hash_of(const char* s, std::size_t n, unsigned long long h = 14695981039346656037ull)
+	{
+		return n ? hash_of(s+1, n-1, (h ^ (unsigned char)*s) * 1099511628211ull) : h;
+	}
+	static constexpr std::size_t length(const char* s, std::size_t n = 0) { return *s ? length(s+1, n+1) : n; }
+};
+
+namespace literals {
+	constexpr uniform_key operator"" _uniform(const char* s, std::size_t n) { return uniform_key(uniform_key::hash_of(s, n)); }
+}
+
+/// An active uniform of a linked program, as reported by glGetActiveUniform.
+/// size is the number of array elements up to the last one the program
+/// actually uses, or 1 for uniforms that are not arrays.
+struct uniform_info
+{
+	unsigned long long hash;
+	GLint location;
+	GLenum type;
+	GLint size;
+	bool array;
+	std::string name;
+	/// Size in bytes of one element and position of the first element in the
+	/// table's shadow copy of the uniform values.
+	GLsizei stride;
+	size_t offset;
+	size_t first;
+
+	uniform_info(): hash(0), location(-1), type(0), size(0), array(false), stride(0), offset(0), first(0) {}
+};
+
+/// The active uniforms of a program, sorted by the hash of their name. Filled
+/// in once after linking, after which lookups are a binary search over a
+/// contiguous array. Arrays are listed under their name both with and without
+/// the trailing "[0]". Uniforms in uniform blocks have no location and are not
+/// listed.
+///
+/// The table also keeps a shadow copy of the values last assigned to each
+/// uniform, such that assigning the same value again can be skipped. Every
+/// element starts out unknown.
+struct uniform_table
+{
+	std::vector<uniform_info> entries;
+	std::vector<GLubyte> values;
+	std::vector<bool> known;
+
+	void clear()
+	{
+		entries.clear();
+		values.clear();
+		known.clear();
+	}
+
+	/// Marks all shadowed values unknown, e.g. after assigning uniforms
+	/// through raw OpenGL calls or program_uniform.
+	void forget_values() { known.assign(known.size(), false); }
+
+	void introspect(GLuint program)
+	{
+		clear();
+		GLint count = 0, max_length = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+		std::vector<GLchar> name(max_length + 1);
+		for (GLint i = 0; i < count; i++) {
+			uniform_info u;
+			GLsizei length = 0;
+			glGetActiveUniform(program, i, name.size(), &length, &u.size, &u.type, &name[0]);
+			u.location = glGetUniformLocation(program, &name[0]);
+			if (u.location < 0) continue;
+			u.stride = value_size(u.type);
+			u.offset = values.size();
+			u.first = known.size();
+			values.resize(values.size() + u.stride * u.size);
+			known.resize(known.size() + u.size, false);
+			u.name.assign(&name[0], length);
+			u.hash = uniform_key(u.name).hash;
+			entries.push_back(u);
+			if (length > 3 && u.name.compare(length-3, 3, "[0]") == 0) {
+				entries.back().array = true;
+				u.array = true;
+				u.name.resize(length-3);
+				u.hash = uniform_key(u.name).hash;
+				entries.push_back(u);
+			}
+		}
+		throw_on_opengl_error();
+		std::sort(entries.begin(), entries.end(), by_hash);
+		for (size_t i = 1; i < entries.size(); i++) {
+			if (entries[i-1].hash == entries[i].hash)
+				throw runtime_error(("program: failed to introspect uniforms: names '" + entries[i-1].name + "' and '" + entries[i].name + "' have the same hash").c_str());
+		}
+	}
+
+	/// Returns the uniform with the given key, or NULL if the program has no
+	/// such active uniform.
+	const uniform_info* find(uniform_key key) const
+	{
+		uniform_info probe;
+		probe.hash = key.hash;
+		std::vector<uniform_info>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), probe, by_hash);
+		if (it == entries.end() || it->hash != key.hash) return NULL;
+		return &*it;
+	}
+
+	/// Whether the first n elements of the uniform are known to hold the
+	/// given values of stride bytes each. Elements beyond the size of the
+	/// uniform are ignored, as OpenGL does.
+	bool holds(const uniform_info& u, GLsizei n, const void* v, GLsizei stride) const
+	{
+		if (stride != u.stride) return false;
+		if (n > u.size) n = u.size;
+		for (GLsizei i = 0; i < n; i++)
+			if (!known[u.first + i]) return false;
+		return std::memcmp(&values[u.offset], v, n * stride) == 0;
+	}
+
+	/// Records that the first n elements of the uniform were assigned the
+	/// given values.
+	void store(const uniform_info& u, GLsizei n, const void* v, GLsizei stride)
+	{
+		if (stride != u.stride) return;
+		if (n > u.size) n = u.size;
+		std::memcpy(&values[u.offset], v, n * stride);
+		for (GLsizei i = 0; i < n; i++)
+			known[u.first + i] = true;
+	}
+
+	/// Size in bytes of one value of the given uniform type. Samplers and
+	/// images hold a texture unit, i.e. one integer.
+	static GLsizei value_size(GLenum type)
+	{
+		switch (type) {
+			case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: return 8;
+			case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: return 12;
+			case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 16;
+			case GL_FLOAT_MAT3: return 36;
+			case GL_FLOAT_MAT4: return 64;
+			#ifdef GL_VERSION_2_1
+			case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 24;
+			case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 32;
+			case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 48;
+			#endif
+			#ifdef GL_VERSION_3_0
+			case GL_UNSIGNED_INT_VEC2: return 8;
+			case GL_UNSIGNED_INT_VEC3: return 12;
+			case GL_UNSIGNED_INT_VEC4: return 16;
+			#endif
+			#ifdef GL_VERSION_4_0
+			case GL_DOUBLE: return 8;
+			case GL_DOUBLE_VEC2: return 16;
+			case GL_DOUBLE_VEC3: return 24;
+			case GL_DOUBLE_VEC4: case GL_DOUBLE_MAT2: return 32;
+			case GL_DOUBLE_MAT3: return 72;
+			case GL_DOUBLE_MAT4: return 128;
+			case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT3x2: return 48;
+			case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT4x2: return 64;
+			case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x3: return 96;
+			#endif
+			default: return 4;
+		}
+	}
+
+private:
+	static bool by_hash(const uniform_info& a, const uniform_info& b) { return a.hash < b.hash; }
+};
+
+} // namespace gladus
+
+namespace gl {
+	typedef gladus::uniform_key UniformKey;
+	typedef gladus::uniform_table UniformTable;
+}
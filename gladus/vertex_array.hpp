@@ -0,0 +1,414 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gladus/error.hpp"
+#include "gladus/binding.hpp"
+#include "gladus/buffer.hpp"
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#define GLADUS_HAS_VERTEX_ARRAY
+
+namespace gladus {
+
+#ifdef GL_VERSION_3_0
+/// How the components of a vertex attribute reach the shader: converted to
+/// float, normalized to [0,1] or [-1,1], as integers, or as doubles.
+enum vertex_attribute_kind
+{
+	attribute_float,
+	attribute_normalized,
+	attribute_integer,
+	attribute_double
+};
+
+/// Runtime description of one attribute of a vertex format. offset is
+/// relative to the start of the vertex.
+struct vertex_attribute_description
+{
+	GLuint location;
+	GLint size;
+	GLenum type;
+	vertex_attribute_kind kind;
+	GLuint offset;
+};
+
+/// Maps the C++ type of a vertex struct member to its OpenGL component type
+/// and count. Scalars and arrays of the OpenGL types are supported;
+/// specialize the template for vector types of other libraries. Integer
+/// components are passed as integers by default, floating point ones as
+/// floats.
+template <typename T> struct vertex_attribute_traits;
+
+#define gladus_vertex_component(T, gltype, default_kind) template <> struct vertex_attribute_traits<T> {\
+	typedef T component;\
+	static const GLenum type = gltype;\
+	static const GLint size = 1;\
+	static const vertex_attribute_kind kind = default_kind; };
+gladus_vertex_component(GLfloat,  GL_FLOAT,          attribute_float)
+gladus_vertex_component(GLdouble, GL_DOUBLE,         attribute_float)
+gladus_vertex_component(GLbyte,   GL_BYTE,           attribute_integer)
+gladus_vertex_component(GLubyte,  GL_UNSIGNED_BYTE,  attribute_integer)
+gladus_vertex_component(GLshort,  GL_SHORT,          attribute_integer)
+gladus_vertex_component(GLushort, GL_UNSIGNED_SHORT, attribute_integer)
+gladus_vertex_component(GLint,    GL_INT,            attribute_integer)
+gladus_vertex_component(GLuint,   GL_UNSIGNED_INT,   attribute_integer)
+#undef gladus_vertex_component
+
+template <typename T, size_t N> struct vertex_attribute_traits<T[N]>
+{
+	typedef typename vertex_attribute_traits<T>::component component;
+	static const GLenum type = vertex_attribute_traits<T>::type;
+	static const GLint size = N;
+	static const vertex_attribute_kind kind = vertex_attribute_traits<T>::kind;
+	static_assert(vertex_attribute_traits<T>::size == 1 && N >= 1 && N <= 4, "vertex attributes have 1 to 4 scalar components");
+};
+
+/// An attribute at the given location, made of a member of type T at the
+/// given offset of the vertex. Usually declared with the
+/// gladus_vertex_attribute macros.
+template <GLuint Location, typename T, size_t Offset, vertex_attribute_kind Kind = vertex_attribute_traits<T>::kind> struct vertex_attribute
+{
+	static const GLuint location = Location;
+	static const size_t offset = Offset;
+	static const size_t end = Offset + sizeof(T);
+	static_assert(Kind != attribute_normalized || vertex_attribute_traits<T>::type != GL_FLOAT, "float attributes cannot be normalized");
+	static_assert(Kind != attribute_integer || (vertex_attribute_traits<T>::type != GL_FLOAT && vertex_attribute_traits<T>::type != GL_DOUBLE), "floating point attributes cannot be passed as integers");
+	static_assert(Kind != attribute_double || vertex_attribute_traits<T>::type == GL_DOUBLE, "only double attributes can be passed as doubles");
+
+	static vertex_attribute_description describe()
+	{
+		vertex_attribute_description d = { Location, vertex_attribute_traits<T>::size, vertex_attribute_traits<T>::type, Kind, GLuint(Offset) };
+		return d;
+	}
+};
+
+#define gladus_vertex_attribute(location, vertex, member) gladus::vertex_attribute<location, decltype(vertex::member), offsetof(vertex, member)>
+#define gladus_normalized_vertex_attribute(location, vertex, member) gladus::vertex_attribute<location, decltype(vertex::member), offsetof(vertex, member), gladus::attribute_normalized>
+
+/// Whether all attributes lie within a vertex of the given size.
+template <size_t Size, typename... Attributes> struct vertex_attributes_fit
+{
+	static const bool value = true;
+};
+template <size_t Size, typename A, typename... Rest> struct vertex_attributes_fit<Size, A, Rest...>
+{
+	static const bool value = A::end <= Size && vertex_attributes_fit<Size, Rest...>::value;
+};
+
+/// Describes the layout of a vertex struct as a list of vertex_attribute
+/// types, from which the attribute formats, offsets and the stride are
+/// derived at compile time:
+///
+///     struct vertex { GLfloat position[3]; GLfloat uv[2]; GLubyte color[4]; };
+///     typedef vertex_format<vertex,
+///         gladus_vertex_attribute(0, vertex, position),
+///         gladus_vertex_attribute(1, vertex, uv),
+///         gladus_normalized_vertex_attribute(2, vertex, color)> vertex_layout;
+template <typename Vertex, typename... Attributes> struct vertex_format
+{
+	typedef Vertex vertex_type;
+	static const GLsizei stride = sizeof(Vertex);
+	/// Number of instances drawn per vertex, or 0 for per-vertex data.
+	static const GLuint divisor = 0;
+	static const size_t size = sizeof...(Attributes);
+	static_assert(sizeof...(Attributes) > 0, "vertex formats need at least one attribute");
+	static_assert(vertex_attributes_fit<sizeof(Vertex), Attributes...>::value, "vertex attribute exceeds the vertex");
+
+	static const vertex_attribute_description* attributes()
+	{
+		static const vertex_attribute_description list[] = { Attributes::describe()... };
+		return list;
+	}
+};
+
+/// A vertex format whose vertices advance once per Divisor instances rather
+/// than once per vertex.
+template <typename Format, GLuint Divisor = 1> struct instanced_format : Format
+{
+	static const GLuint divisor = Divisor;
+};
+
+/// A vertex array object, which holds the attribute formats, the vertex
+/// buffers they are read from and the index buffer, such that switching
+/// between meshes takes a single bind.
+///
+/// Formats are given per buffer binding index. On contexts supporting
+/// ARB_vertex_attrib_binding the format and the buffer of a binding are
+/// specified separately, through direct state access where available.
+/// Elsewhere the attribute pointers are specified once both the format and
+/// the buffer of a binding are known.
+///
+///     vertex_array vao;
+///     vao.format<vertex_layout>(0);
+///     vao.vertex_buffer<vertex_layout>(0, vertices);
+///     vao.index_buffer(indices);
+///     vao.bind();
+struct vertex_array
+{
+	GLuint id;
+
+	vertex_array() { generate(); }
+	explicit vertex_array(GLuint id): id(id) {}
+	vertex_array(vertex_array&& other) noexcept: id(other.id), slots(std::move(other.slots)) { other.id = 0; }
+	~vertex_array()
+	{
+		if (id > 0) {
+			glDeleteVertexArrays(1, &id);
+			context::current().bindings.forget_vertex_array(id);
+		}
+	}
+
+	/// Deletes the vertex array's name and takes over the other's.
+	vertex_array& operator=(vertex_array&& other) noexcept
+	{
+		if (this == &other) return *this;
+		if (id > 0) {
+			glDeleteVertexArrays(1, &id);
+			context::current().bindings.forget_vertex_array(id);
+		}
+		id = other.id;
+		slots = std::move(other.slots);
+		other.id = 0;
+		return *this;
+	}
+
+	vertex_array(const vertex_array&) = delete;
+	vertex_array& operator=(const vertex_array&) = delete;
+
+	operator GLuint() const { return id; }
+
+	void bind() const
+	{
+		assert(id > 0 && "vertex array has no name");
+		bind_name(id);
+	}
+	void unbind() const { bind_name(0); }
+
+	GLuint current_binding() const { return context::current().bindings.current_vertex_array(); }
+	void restore_binding(GLuint name) const { bind_name(name); }
+
+	/// Declares the attributes read from the given buffer binding index.
+	template <typename Format> void format(GLuint binding = 0)
+	{
+		format(binding, Format::attributes(), Format::size, Format::divisor);
+	}
+	void format(GLuint binding, const vertex_attribute_description* attributes, size_t count, GLuint divisor)
+	{
+		context& ctx = context::current();
+		#ifdef GL_VERSION_4_5
+		if (ctx.direct_state_access()) {
+			clear_opengl_error();
+			for (size_t i = 0; i < count; i++) {
+				const vertex_attribute_description& a = attributes[i];
+				switch (a.kind) {
+					case attribute_integer: glVertexArrayAttribIFormat(id, a.location, a.size, a.type, a.offset); break;
+					case attribute_double:  glVertexArrayAttribLFormat(id, a.location, a.size, a.type, a.offset); break;
+					default: glVertexArrayAttribFormat(id, a.location, a.size, a.type, a.kind == attribute_normalized, a.offset); break;
+				}
+				glVertexArrayAttribBinding(id, a.location, binding);
+				glEnableVertexArrayAttrib(id, a.location);
+			}
+			glVertexArrayBindingDivisor(id, binding, divisor);
+			on_opengl_error(throw_on_format_error);
+			return;
+		}
+		#endif
+		#ifdef GL_VERSION_4_3
+		if (ctx.supports_vertex_attrib_binding()) {
+			scoped_bind<vertex_array> bound(*this);
+			clear_opengl_error();
+			for (size_t i = 0; i < count; i++) {
+				const vertex_attribute_description& a = attributes[i];
+				switch (a.kind) {
+					case attribute_integer: glVertexAttribIFormat(a.location, a.size, a.type, a.offset); break;
+					case attribute_double:  glVertexAttribLFormat(a.location, a.size, a.type, a.offset); break;
+					default: glVertexAttribFormat(a.location, a.size, a.type, a.kind == attribute_normalized, a.offset); break;
+				}
+				glVertexAttribBinding(a.location, binding);
+				glEnableVertexAttribArray(a.location);
+			}
+			glVertexBindingDivisor(binding, divisor);
+			on_opengl_error(throw_on_format_error);
+			return;
+		}
+		#endif
+		(void)ctx;
+		binding_slot& s = slot(binding);
+		s.attributes = attributes;
+		s.count = count;
+		s.divisor = divisor;
+		if (s.buffer) specify_pointers(s);
+	}
+
+	/// Reads the vertices of the given buffer binding index from the buffer,
+	/// starting at offset bytes.
+	template <typename Format> void vertex_buffer(GLuint binding, const buffer& b, GLintptr offset = 0)
+	{
+		vertex_buffer(binding, b, offset, Format::stride);
+	}
+	void vertex_buffer(GLuint binding, const buffer& b, GLintptr offset, GLsizei stride)
+	{
+		context& ctx = context::current();
+		#ifdef GL_VERSION_4_5
+		if (ctx.direct_state_access()) {
+			clear_opengl_error();
+			glVertexArrayVertexBuffer(id, binding, b.id, offset, stride);
+			on_opengl_error(throw_on_vertex_buffer_error);
+			return;
+		}
+		#endif
+		#ifdef GL_VERSION_4_3
+		if (ctx.supports_vertex_attrib_binding()) {
+			scoped_bind<vertex_array> bound(*this);
+			clear_opengl_error();
+			glBindVertexBuffer(binding, b.id, offset, stride);
+			on_opengl_error(throw_on_vertex_buffer_error);
+			return;
+		}
+		#endif
+		(void)ctx;
+		binding_slot& s = slot(binding);
+		s.buffer = b.id;
+		s.offset = offset;
+		s.stride = stride;
+		if (s.attributes) specify_pointers(s);
+	}
+
+	/// Reads the indices of indexed draws from the buffer.
+	void index_buffer(const buffer& b)
+	{
+		binding_cache& cache = context::current().bindings;
+		#ifdef GL_VERSION_4_5
+		if (context::current().direct_state_access()) {
+			clear_opengl_error();
+			glVertexArrayElementBuffer(id, b.id);
+			on_opengl_error(throw_on_index_buffer_error);
+			cache.set_element_buffer(id, b.id);
+			return;
+		}
+		#endif
+		scoped_bind<vertex_array> bound(*this);
+		if (cache.buffer_bound(GL_ELEMENT_ARRAY_BUFFER, b.id)) return;
+		clear_opengl_error();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, b.id);
+		on_opengl_error(throw_on_index_buffer_error);
+		cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, b.id);
+	}
+
+	static void throw_on_bind_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_OPERATION: throw runtime_error("vertex_array: failed to bind: 'id' is not a previously allocated vertex array name", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_format_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_ENUM: throw runtime_error("vertex_array: failed to set format: attribute type is not supported", err);
+			case GL_INVALID_VALUE: throw runtime_error("vertex_array: failed to set format: location or binding index exceeds the maximum, or offset is too large", err);
+			case GL_INVALID_OPERATION: throw runtime_error("vertex_array: failed to set format: attribute size and type do not match", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_vertex_buffer_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_VALUE: throw runtime_error("vertex_array: failed to set vertex buffer: binding index exceeds the maximum, or offset or stride is negative or too large", err);
+			case GL_INVALID_OPERATION: throw runtime_error("vertex_array: failed to set vertex buffer: 'buffer' is not a buffer name", err);
+			default: throw err;
+		}
+	}
+	static void throw_on_index_buffer_error(const opengl_error& err)
+	{
+		switch (err.ec) {
+			case GL_INVALID_OPERATION: throw runtime_error("vertex_array: failed to set index buffer: 'buffer' is not a buffer name", err);
+			default: throw err;
+		}
+	}
+
+private:
+	/// Format and buffer of a binding index, kept on contexts without
+	/// ARB_vertex_attrib_binding only.
+	struct binding_slot
+	{
+		const vertex_attribute_description* attributes;
+		size_t count;
+		GLuint divisor;
+		GLuint buffer;
+		GLintptr offset;
+		GLsizei stride;
+
+		binding_slot(): attributes(NULL), count(0), divisor(0), buffer(0), offset(0), stride(0) {}
+	};
+
+	std::vector<binding_slot> slots;
+
+	void generate()
+	{
+		#ifdef GL_VERSION_4_5
+		if (context::current().supports_direct_state_access()) {
+			glCreateVertexArrays(1, &id);
+			throw_on_opengl_error();
+			return;
+		}
+		#endif
+		glGenVertexArrays(1, &id);
+		throw_on_opengl_error();
+	}
+
+	void bind_name(GLuint name) const
+	{
+		binding_cache& cache = context::current().bindings;
+		if (cache.vertex_array_bound(name)) return;
+		clear_opengl_error();
+		glBindVertexArray(name);
+		on_opengl_error(throw_on_bind_error);
+		cache.bind_vertex_array(name);
+	}
+
+	binding_slot& slot(GLuint binding)
+	{
+		if (binding >= slots.size()) slots.resize(binding + 1);
+		return slots[binding];
+	}
+
+	/// Specifies the attribute pointers of a binding, which capture the
+	/// buffer bound to GL_ARRAY_BUFFER at the time.
+	void specify_pointers(const binding_slot& s)
+	{
+		scoped_bind<vertex_array> bound(*this);
+		binding_cache& cache = context::current().bindings;
+		if (!cache.buffer_bound(GL_ARRAY_BUFFER, s.buffer)) {
+			glBindBuffer(GL_ARRAY_BUFFER, s.buffer);
+			cache.bind_buffer(GL_ARRAY_BUFFER, s.buffer);
+		}
+		clear_opengl_error();
+		for (size_t i = 0; i < s.count; i++) {
+			const vertex_attribute_description& a = s.attributes[i];
+			const GLvoid* pointer = (const GLvoid*)(s.offset + a.offset);
+			switch (a.kind) {
+				case attribute_integer: glVertexAttribIPointer(a.location, a.size, a.type, s.stride, pointer); break;
+				#ifdef GL_VERSION_4_1
+				case attribute_double:  glVertexAttribLPointer(a.location, a.size, a.type, s.stride, pointer); break;
+				#endif
+				default: glVertexAttribPointer(a.location, a.size, a.type, a.kind == attribute_normalized, s.stride, pointer); break;
+			}
+			glEnableVertexAttribArray(a.location);
+			#ifdef GL_VERSION_3_3
+			glVertexAttribDivisor(a.location, s.divisor);
+			#endif
+		}
+		on_opengl_error(throw_on_format_error);
+	}
+};
+#endif
+
+} // namespace gladus
+
+namespace gl {
+	#ifdef GL_VERSION_3_0
+	typedef gladus::vertex_array VertexArray;
+	#endif
+}
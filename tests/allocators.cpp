@@ -0,0 +1,102 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+// Checks the bookkeeping of buffer_arena's free lists and of registry's
+// handles, neither of which needs an OpenGL context.
+#include <gladus/opengl.hpp>
+#include <gladus/buffer_arena.hpp>
+#include <gladus/registry.hpp>
+#include <cstdio>
+
+static int failures = 0;
+
+#define check(condition) do { if (!(condition)) { std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static void free_list_merges_neighbors()
+{
+	gladus::buffer_free_list f;
+	f.reset(100);
+	GLintptr a, b, c;
+	check(f.carve(10, 1, a) && a == 0);
+	check(f.carve(20, 1, b) && b == 10);
+	check(f.carve(30, 1, c) && c == 30);
+	check(f.ranges.size() == 1 && f.ranges[60] == 40);
+
+	// Releasing the middle range leaves a hole, releasing its neighbors
+	// merges all of them with the free tail.
+	f.release(b, 20);
+	check(f.ranges.size() == 2 && f.ranges[10] == 20);
+	f.release(a, 10);
+	check(f.ranges.size() == 2 && f.ranges[0] == 30);
+	f.release(c, 30);
+	check(f.ranges.size() == 1 && f.ranges[0] == 100);
+
+	GLintptr d;
+	check(f.carve(100, 1, d) && d == 0 && f.ranges.empty());
+	check(!f.carve(1, 1, d));
+}
+
+static void free_list_aligns_to_any_stride()
+{
+	gladus::buffer_free_list f;
+	f.reset(100);
+	GLintptr a, b, c;
+	check(f.carve(5, 1, a) && a == 0);
+	// A stride of 12 bytes, e.g. three floats, is not a power of two.
+	check(f.carve(24, 12, b) && b == 12);
+	// The gap in front of the aligned range stays free.
+	check(f.ranges.size() == 2 && f.ranges[5] == 7 && f.ranges[36] == 64);
+	check(f.carve(5, 7, c) && c == 7);
+	check(f.ranges.size() == 2 && f.ranges[5] == 2);
+	// Nothing left that holds 60 bytes at a multiple of 14.
+	check(!f.carve(60, 14, c));
+	check(f.carve(60, 12, c) && c == 36);
+}
+
+static void registry_detects_stale_handles()
+{
+	gladus::registry<int, float> r;
+	gladus::registry_handle a = r.insert(1, 0.5f);
+	gladus::registry_handle b = r.insert(2, 1.5f);
+	check(a && b && a != b);
+	check(r.erase(a));
+	check(!r.contains(a) && r.find(a) == NULL && r.metadata<0>(a) == NULL);
+	check(!r.erase(a));
+	check(r.find(b) && *r.find(b) == 2 && *r.metadata<0>(b) == 1.5f);
+	// A free slot holds no entry, even under the generation it is reused with.
+	check(!r.contains(gladus::registry_handle(a.index(), a.generation() + 1)));
+
+	// The freed slot is reused under a new generation.
+	gladus::registry_handle c = r.insert(3, 2.5f);
+	check(c.index() == a.index() && c != a);
+	check(!r.contains(a) && r.find(c) && *r.find(c) == 3);
+	check(r.handle_at(0) == b || r.handle_at(0) == c);
+	check(!r.contains(gladus::registry_handle()));
+}
+
+static void registry_generations_skip_zero()
+{
+	gladus::registry<int> r;
+	gladus::registry_handle first = r.insert(0);
+	check(first.index() == 0 && first.generation() == 1 && first.value != 0);
+	gladus::registry_handle h = first;
+	bool wrapped = false;
+	// Generations 1 to generation_mask, then 1 again.
+	for (uint32_t i = 0; i < gladus::registry_handle::generation_mask; i++) {
+		check(r.erase(h));
+		h = r.insert(0);
+		check(h.index() == 0 && h.generation() != 0 && h.value != 0);
+		if (h.generation() == 1) wrapped = true;
+	}
+	check(wrapped);
+	// After wrapping around, the first handle refers to the slot again.
+	check(h == first);
+}
+
+int main()
+{
+	free_list_merges_neighbors();
+	free_list_aligns_to_any_stride();
+	registry_detects_stale_handles();
+	registry_generations_skip_zero();
+	if (failures) std::fprintf(stderr, "%d checks failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -1,13 +1,37 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #include <gladus/opengl.hpp>
 #include <gladus/error.hpp>
+#include <gladus/extensions.hpp>
+#include <gladus/context.hpp>
 #include <gladus/buffer.hpp>
 #include <gladus/binding.hpp>
 #include <gladus/state.hpp>
+#include <gladus/render_state.hpp>
 #include <gladus/texture.hpp>
+#include <gladus/texture_stream.hpp>
 #include <gladus/shader.hpp>
+#include <gladus/uniform_table.hpp>
 #include <gladus/program.hpp>
+#include <gladus/block_buffer.hpp>
+#include <gladus/program_cache.hpp>
+#include <gladus/compile_queue.hpp>
+#include <gladus/command_list.hpp>
 #include <gladus/framebuffer.hpp>
+#include <gladus/fence.hpp>
+#include <gladus/frame_pacer.hpp>
+#include <gladus/gpu_profiler.hpp>
+#include <gladus/stream_buffer.hpp>
+#ifdef GLADUS_HAS_EGL
+#include <gladus/resource_loader.hpp>
+#endif
+#include <gladus/vertex_array.hpp>
+#include <gladus/draw_batch.hpp>
+#include <gladus/resource_pool.hpp>
+#include <gladus/buffer_arena.hpp>
+#include <gladus/registry.hpp>
+#include <gladus/instrument.hpp>
+#include <gladus/pixel_format.hpp>
+#include <gladus/trace.hpp>
 #include <iostream>
 
 int main()